@@ -0,0 +1,97 @@
+/* Directory jump benchmark.
+ *
+ * Fills a directory database in a temporary directory with synthetic
+ * paths (a deep project tree under a few roots, most visited once and a
+ * few hundred often, the way a long-used shell's history looks) and times
+ * visits and z lookups: ones that hit frequently visited directories, a
+ * rarely visited leaf and one that matches nothing and so goes through
+ * every entry. Lookups that hit should take microseconds even with 100k
+ * directories.
+ *
+ * Usage: dir_jump_bench [directories] [iterations]
+ */
+#include "dir_jump.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *roots[] = {"/home/user/src", "/home/user/work", "/srv/data", "/var/lib/builds"};
+static const char *parts[] = {"api", "web", "core", "tools", "docs", "tests", "infra", "lib", "cmd", "pkg"};
+#define COUNT(a) (sizeof(a) / sizeof(a[0]))
+
+static double now_usec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/* Path of directory number i */
+static void make_path(char *buf, size_t size, size_t i) {
+    snprintf(buf, size, "%s/project-%zu/%s/%s/module-%zu", roots[i % COUNT(roots)], i / 100 % 1000,
+             parts[i / 7 % COUNT(parts)], parts[i / 3 % COUNT(parts)], i);
+}
+
+int main(int argc, char *argv[]) {
+    size_t num_dirs = argc > 1 ? (size_t)atol(argv[1]) : 100000;
+    int iterations = argc > 2 ? atoi(argv[2]) : 1000;
+    if (num_dirs == 0) num_dirs = 100000;
+    if (iterations <= 0) iterations = 1000;
+
+    char dir[] = "/tmp/dir_jump_bench.XXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    setenv("XDG_DATA_HOME", dir, 1);
+    if (dir_jump_open() != 0) {
+        fprintf(stderr, "dir_jump_bench: cannot open the database\n");
+        return 1;
+    }
+
+    /* Every directory once, then a few hundred of them many times */
+    char path[256];
+    double start = now_usec();
+    for (size_t i = 0; i < num_dirs; i++) {
+        make_path(path, sizeof(path), i);
+        dir_jump_add(path);
+    }
+    double added = now_usec() - start;
+
+    unsigned long seed = 12345;
+    size_t num_visits = num_dirs / 2;
+    start = now_usec();
+    for (size_t i = 0; i < num_visits; i++) {
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        make_path(path, sizeof(path), (seed >> 33) % 300 * (num_dirs / 300));
+        dir_jump_add(path);
+    }
+    double visited = now_usec() - start;
+    printf("directories: %zu, added in %.0f ms (%.2f us each), %zu revisits at %.2f us each\n", num_dirs,
+           added / 1e3, added / num_dirs, num_visits, visited / num_visits);
+
+    const char *queries[][2] = {
+        {"module", NULL}, {"project-1", "api"}, {"work", "core"}, {"module-77777", NULL}, {"zzz", NULL},
+    };
+    for (size_t q = 0; q < COUNT(queries); q++) {
+        size_t num_fragments = queries[q][1] ? 2 : 1;
+        char *found[GHOST_DIR_JUMP_CANDIDATES];
+        size_t num_found = 0;
+        double worst = 0, total = 0;
+        for (int it = 0; it < iterations; it++) {
+            double t = now_usec();
+            num_found = dir_jump_search(queries[q], num_fragments, NULL, found, NULL, 1);
+            double elapsed = now_usec() - t;
+            total += elapsed;
+            if (elapsed > worst) worst = elapsed;
+            for (size_t i = 0; i < num_found; i++) free(found[i]);
+        }
+        printf("%-14s %-6s %s %9.2f us/query (worst %.1f us)\n", queries[q][0],
+               queries[q][1] ? queries[q][1] : "", num_found ? "found" : "none ", total / iterations, worst);
+    }
+
+    dir_jump_close();
+    char cmd[64];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+    return system(cmd) == 0 ? 0 : 1;
+}
@@ -0,0 +1,85 @@
+/* Fuzzy completion benchmark.
+ *
+ * Ranks a set of synthetic command names (shaped like a large PATH: words
+ * joined by '-', '_' and '.', some with version suffixes) against a few
+ * typical patterns, with a frecency bonus for part of the names, and
+ * reports the time per query. Completion should stay within about 1 ms.
+ *
+ * Usage: fuzzy_bench [names] [iterations]
+ */
+#include "fuzzy.h"
+#include "frecency.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *words[] = {
+    "git", "docker", "python", "config", "update", "remote", "lib", "gnome", "x86",
+    "perl", "compose", "build", "systemd", "analyze", "grep", "print", "info", "pkg",
+    "ssh", "keygen", "tar", "gz", "node", "npm", "rust", "cargo", "llvm", "objdump",
+};
+#define NUM_WORDS (sizeof(words) / sizeof(words[0]))
+
+static double now_usec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static double command_bonus(const char *name, void *arg) {
+    (void)arg;
+    double f = frecency_score(FRECENCY_COMMAND, name);
+    return GHOST_FUZZY_FRECENCY_WEIGHT * f / (f + 4);
+}
+
+int main(int argc, char *argv[]) {
+    size_t num_names = argc > 1 ? (size_t)atol(argv[1]) : 20000;
+    int iterations = argc > 2 ? atoi(argv[2]) : 200;
+    if (num_names == 0) num_names = 20000;
+    if (iterations <= 0) iterations = 200;
+
+    /* Deterministic names of one to three words */
+    const char seps[] = "-_.";
+    char **names = malloc(num_names * sizeof(char *));
+    unsigned long seed = 12345;
+    for (size_t i = 0; i < num_names; i++) {
+        char buf[128];
+        size_t len = 0;
+        int parts = 1 + (int)(i % 3);
+        for (int p = 0; p < parts; p++) {
+            seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+            if (p > 0) buf[len++] = seps[(seed >> 40) % 3];
+            len += (size_t)snprintf(buf + len, sizeof(buf) - len, "%s", words[(seed >> 33) % NUM_WORDS]);
+        }
+        snprintf(buf + len, sizeof(buf) - len, "%zu", i);
+        names[i] = strdup(buf);
+        if (i % 50 == 0) frecency_add(FRECENCY_COMMAND, names[i]);
+    }
+
+    const char *patterns[] = {"g", "gc", "dkcmp", "pyupd", "sysanl", "zzz", "gitremote"};
+    printf("names: %zu, iterations: %d\n", num_names, iterations);
+    for (size_t p = 0; p < sizeof(patterns) / sizeof(patterns[0]); p++) {
+        fuzzy_pattern pattern;
+        fuzzy_compile(&pattern, patterns[p]);
+
+        size_t found = 0;
+        double worst = 0, total = 0;
+        for (int it = 0; it < iterations; it++) {
+            fuzzy_match *matches;
+            double start = now_usec();
+            found = fuzzy_rank(&pattern, (const char *const *)names, num_names, command_bonus, NULL, &matches);
+            double elapsed = now_usec() - start;
+            free(matches);
+            total += elapsed;
+            if (elapsed > worst) worst = elapsed;
+        }
+        printf("%-10s %7zu matches %8.1f us/query (worst %.1f us)\n",
+               patterns[p], found, total / iterations, worst);
+    }
+
+    for (size_t i = 0; i < num_names; i++) free(names[i]);
+    free(names);
+    frecency_cleanup();
+    return 0;
+}
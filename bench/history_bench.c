@@ -0,0 +1,113 @@
+/* History store benchmark.
+ *
+ * Fills a history store in a temporary directory with synthetic commands
+ * (shaped like a long interactive history: a few hundred distinct tools
+ * with varied arguments, in a handful of directories), waits for the
+ * index and times substring and regex searches that stop at the first 20
+ * matches or go through everything. Searches should stay within a few
+ * milliseconds even with millions of entries.
+ *
+ * Usage: history_bench [entries] [iterations]
+ */
+#include "history_store.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char *tools[] = {
+    "git", "docker", "python3", "make", "ssh", "kubectl", "grep", "find", "tar", "cargo",
+    "npm", "curl", "vim", "ls", "cd", "rsync", "systemctl", "journalctl", "psql", "go",
+};
+static const char *args[] = {
+    "status", "commit -m", "push origin", "build", "run --rm", "-la", "logs -f", "apply -f",
+    "test", "install", "deploy.yaml", "-rn TODO src", "--since today", "config.json", "main.c",
+};
+static const char *dirs[] = {"/home/user", "/home/user/src/app", "/tmp", "/etc", "/var/log"};
+#define COUNT(a) (sizeof(a) / sizeof(a[0]))
+
+static double now_usec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int count_match(const history_entry *entry, void *arg) {
+    (void)entry;
+    size_t *count = arg;
+    return ++*count == 20;
+}
+
+static int count_all(const history_entry *entry, void *arg) {
+    (void)entry;
+    ++*(size_t *)arg;
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    size_t num_entries = argc > 1 ? (size_t)atol(argv[1]) : 1000000;
+    int iterations = argc > 2 ? atoi(argv[2]) : 20;
+    if (num_entries == 0) num_entries = 1000000;
+    if (iterations <= 0) iterations = 20;
+
+    char dir[] = "/tmp/history_bench.XXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    setenv("XDG_DATA_HOME", dir, 1);
+    if (history_store_open() < 0) {
+        fprintf(stderr, "history_bench: cannot open the store\n");
+        return 1;
+    }
+
+    /* Deterministic commands */
+    unsigned long seed = 12345;
+    double start = now_usec();
+    for (size_t i = 0; i < num_entries; i++) {
+        char command[256];
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        snprintf(command, sizeof(command), "%s %s %s%lu", tools[(seed >> 33) % COUNT(tools)],
+                 args[(seed >> 40) % COUNT(args)], (seed >> 50) % 3 ? "" : "item-", (seed >> 20) % 5000);
+        history_store_add(command, dirs[(seed >> 45) % COUNT(dirs)], (time_t)(1500000000 + i * 60),
+                          (seed >> 55) % 10 == 0);
+    }
+    double added = now_usec() - start;
+    history_store_wait();
+    printf("entries: %zu, added in %.0f ms (%.1f us each), indexed after %.0f ms\n", num_entries,
+           added / 1e3, added / num_entries, (now_usec() - start) / 1e3);
+
+    struct {
+        const char *pattern;
+        int regex;
+        int all;
+    } queries[] = {
+        {"git push", 0, 0}, {"kubectl apply", 0, 1}, {"item-4242", 0, 1}, {"TODO", 0, 0},
+        {"docker.*logs", 1, 1}, {"^ssh .*config", 1, 1}, {"zzz", 0, 1},
+    };
+    for (size_t q = 0; q < COUNT(queries); q++) {
+        history_query query;
+        memset(&query, 0, sizeof(query));
+        query.pattern = queries[q].pattern;
+        query.regex = queries[q].regex;
+        char error[256];
+        size_t found = 0;
+        double worst = 0, total = 0;
+        for (int it = 0; it < iterations; it++) {
+            found = 0;
+            double t = now_usec();
+            history_store_search(&query, queries[q].all ? count_all : count_match, &found, error, sizeof(error));
+            double elapsed = now_usec() - t;
+            total += elapsed;
+            if (elapsed > worst) worst = elapsed;
+        }
+        printf("%-16s %-5s %7zu found %9.1f us/query (worst %.1f us)\n", queries[q].pattern,
+               queries[q].all ? "all" : "first", found, total / iterations, worst);
+    }
+
+    history_store_close();
+    char cmd[64];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+    return system(cmd) == 0 ? 0 : 1;
+}
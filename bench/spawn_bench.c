@@ -0,0 +1,75 @@
+/* Spawn latency benchmark for execute_command.
+ *
+ * Runs the same command line repeatedly through parse_command/execute_command
+ * with the fork backend (the old launch path) and the posix_spawn backend,
+ * after growing the heap to mimic a long-running interactive session.
+ *
+ * Usage: spawn_bench [iterations] [ballast-MiB] [command line]
+ */
+#include "ghost_shell.h"
+#include "launcher.h"
+#include <time.h>
+
+static double now_usec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static double run_backend(const char *backend, const char *line, int iterations, shell_context *ctx) {
+    setenv("GHSH_SPAWN", backend, 1);
+
+    ghost_command *cmd = parse_command(line);
+    if (!cmd) {
+        fprintf(stderr, "spawn_bench: cannot parse '%s'\n", line);
+        exit(1);
+    }
+
+    /* Warm up caches and the dynamic loader */
+    for (int i = 0; i < 10; i++) {
+        execute_command(cmd, ctx);
+    }
+
+    double start = now_usec();
+    for (int i = 0; i < iterations; i++) {
+        execute_command(cmd, ctx);
+    }
+    double elapsed = now_usec() - start;
+
+    free_command(cmd);
+    return elapsed / iterations;
+}
+
+int main(int argc, char *argv[]) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 2000;
+    size_t ballast_mb = argc > 2 ? (size_t)atoi(argv[2]) : 256;
+    const char *line = argc > 3 ? argv[3] : "true";
+
+    if (iterations <= 0) iterations = 2000;
+
+    /* Touch every page so fork has a real page table to copy */
+    char *ballast = NULL;
+    if (ballast_mb > 0) {
+        ballast = malloc(ballast_mb << 20);
+        if (!ballast) {
+            perror("spawn_bench: malloc");
+            return 1;
+        }
+        memset(ballast, 0x5a, ballast_mb << 20);
+    }
+
+    shell_context ctx;
+    memset(&ctx, 0, sizeof(ctx));
+
+    double fork_us = run_backend("fork", line, iterations, &ctx);
+    double spawn_us = run_backend("spawn", line, iterations, &ctx);
+
+    printf("command:    %s\n", line);
+    printf("iterations: %d, heap ballast: %zu MiB\n", iterations, ballast_mb);
+    printf("fork+exec:  %8.1f us/launch\n", fork_us);
+    printf("posix_spawn:%8.1f us/launch\n", spawn_us);
+    printf("speedup:    %8.2fx\n", spawn_us > 0 ? fork_us / spawn_us : 0.0);
+
+    free(ballast);
+    return 0;
+}
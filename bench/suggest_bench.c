@@ -0,0 +1,85 @@
+/* Command-not-found suggestion benchmark.
+ *
+ * Builds a BK-tree over a set of synthetic command names (shaped like a
+ * large PATH, as in fuzzy_bench) and looks up a few misspellings, reporting
+ * the build time and the time per lookup. Lookups should stay well under
+ * 1 ms.
+ *
+ * Usage: suggest_bench [names] [iterations]
+ */
+#include "bk_tree.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *words[] = {
+    "git", "docker", "python", "config", "update", "remote", "lib", "gnome", "x86",
+    "perl", "compose", "build", "systemd", "analyze", "grep", "print", "info", "pkg",
+    "ssh", "keygen", "tar", "gz", "node", "npm", "rust", "cargo", "llvm", "objdump",
+};
+#define NUM_WORDS (sizeof(words) / sizeof(words[0]))
+
+static double now_usec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+int main(int argc, char *argv[]) {
+    size_t num_names = argc > 1 ? (size_t)atol(argv[1]) : 30000;
+    int iterations = argc > 2 ? atoi(argv[2]) : 200;
+    if (num_names == 0) num_names = 30000;
+    if (iterations <= 0) iterations = 200;
+
+    /* Deterministic names of one to three words, plus the plain words */
+    const char seps[] = "-_.";
+    char **names = malloc((num_names + NUM_WORDS) * sizeof(char *));
+    unsigned long seed = 12345;
+    for (size_t i = 0; i < num_names; i++) {
+        char buf[128];
+        size_t len = 0;
+        int parts = 1 + (int)(i % 3);
+        for (int p = 0; p < parts; p++) {
+            seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+            if (p > 0) buf[len++] = seps[(seed >> 40) % 3];
+            len += (size_t)snprintf(buf + len, sizeof(buf) - len, "%s", words[(seed >> 33) % NUM_WORDS]);
+        }
+        snprintf(buf + len, sizeof(buf) - len, "%zu", i);
+        names[i] = strdup(buf);
+    }
+    for (size_t i = 0; i < NUM_WORDS; i++) {
+        names[num_names + i] = strdup(words[i]);
+    }
+
+    bk_tree tree;
+    bk_tree_init(&tree);
+    double start = now_usec();
+    for (size_t i = 0; i < num_names + NUM_WORDS; i++) {
+        bk_tree_add(&tree, names[i]);
+    }
+    printf("names: %zu, built in %.1f ms, iterations: %d\n", tree.count, (now_usec() - start) / 1e3,
+           iterations);
+
+    const char *queries[] = {"gti", "dcoker", "pyhton", "grpe", "systemd-analyse", "cargo12", "zzzzzz"};
+    for (size_t q = 0; q < sizeof(queries) / sizeof(queries[0]); q++) {
+        unsigned radius = strlen(queries[q]) <= 2 ? 1 : strlen(queries[q]) <= 7 ? 2 : 3;
+        bk_match matches[16];
+        size_t found = 0;
+        double worst = 0, total = 0;
+        for (int it = 0; it < iterations; it++) {
+            double t = now_usec();
+            found = bk_tree_search(&tree, queries[q], radius, matches, 16);
+            double elapsed = now_usec() - t;
+            total += elapsed;
+            if (elapsed > worst) worst = elapsed;
+        }
+        printf("%-16s %3zu found (best: %-10s) %8.1f us/query (worst %.1f us)\n", queries[q], found,
+               found ? matches[0].word : "-", total / iterations, worst);
+    }
+
+    bk_tree_free(&tree);
+    for (size_t i = 0; i < num_names + NUM_WORDS; i++) free(names[i]);
+    free(names);
+    return 0;
+}
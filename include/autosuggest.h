@@ -0,0 +1,34 @@
+#ifndef AUTOSUGGEST_H
+#define AUTOSUGGEST_H
+
+#include <histedit.h>
+
+/* Colour of the suggested rest of the line */
+#define GHOST_SUGGEST_STYLE "\033[90m"
+
+/* With GHSH_AUTOSUGGEST=1, show the newest history line starting with what
+ * has been typed, dimmed after the cursor, while the cursor is at the end
+ * of the line. Ctrl-F or Right accepts it; elsewhere they move the cursor
+ * as usual. Installs its own character reader on el. Returns 1 if
+ * suggestions are enabled, in which case the caller keeps the history
+ * index up to date. */
+int autosuggest_init(EditLine *el);
+
+/* Record the prompt being shown, to know where the line ends on screen */
+void autosuggest_set_prompt(const char *prompt);
+
+/* Columns taken by the prompt last recorded */
+size_t autosuggest_prompt_width(void);
+
+/* Take the prompt (width columns) and the line off the screen before
+ * EL_REFRESH, which draws them anew from wherever the cursor is: back to
+ * where the prompt starts and clear from there */
+void autosuggest_clear_line(EditLine *el, size_t width);
+
+/* Have the character reader (installed on el if suggestions are off) call
+ * wait before reading a key. wait returns once a key is ready, 0, or once
+ * the prompt has changed, 1, in which case the prompt and line are drawn
+ * again and it is called anew. */
+void autosuggest_set_input_wait(EditLine *el, int (*wait)(void));
+
+#endif /* AUTOSUGGEST_H */
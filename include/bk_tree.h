@@ -0,0 +1,57 @@
+#ifndef BK_TREE_H
+#define BK_TREE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Longest word a BK-tree holds; edit distances fit in a byte */
+#define GHOST_BK_MAX_WORD 255
+
+/* Burkhard-Keller tree over words by Levenshtein distance. Each child
+ * hangs off its parent by its distance to it, so by the triangle
+ * inequality a search within radius r only visits children at distances
+ * d-r..d+r of a node d away. Words are not copied; the caller keeps them
+ * alive while the tree is used. */
+typedef struct bk_node {
+    const char *word;
+    uint32_t child;     /* First child, 0: none */
+    uint32_t sibling;   /* Next child of the same parent, 0: none */
+    uint8_t dist;       /* Distance to the parent */
+} bk_node;
+
+typedef struct bk_tree {
+    bk_node *nodes;     /* nodes[0] is the root */
+    size_t count;
+    size_t cap;
+} bk_tree;
+
+/* A word found by bk_tree_search */
+typedef struct bk_match {
+    const char *word;
+    unsigned dist;
+} bk_match;
+
+/* Prepare an empty tree */
+void bk_tree_init(bk_tree *tree);
+
+/* Release the tree (not the words) */
+void bk_tree_free(bk_tree *tree);
+
+/* Add a word; duplicates and words longer than GHOST_BK_MAX_WORD are
+ * skipped. Returns -1 on allocation failure. */
+int bk_tree_add(bk_tree *tree, const char *word);
+
+/* Find the words within max_dist of word, closest first, keeping at most
+ * max_matches. Returns how many were stored in matches. */
+size_t bk_tree_search(const bk_tree *tree, const char *word, unsigned max_dist,
+                      bk_match *matches, size_t max_matches);
+
+/* Levenshtein distance of two words of up to GHOST_BK_MAX_WORD bytes */
+unsigned edit_distance(const char *a, size_t len_a, const char *b, size_t len_b);
+
+/* Like edit_distance, but swapping two adjacent characters counts as one
+ * edit (optimal string alignment), as typos usually do. Not a metric, so
+ * it only ranks what the tree finds. */
+unsigned typo_distance(const char *a, size_t len_a, const char *b, size_t len_b);
+
+#endif /* BK_TREE_H */
@@ -0,0 +1,46 @@
+#ifndef COMMAND_INDEX_H
+#define COMMAND_INDEX_H
+
+#include <stddef.h>
+
+/* Size of the chunks names are interned into */
+#define GHOST_INDEX_CHUNK_SIZE (64 * 1024)
+
+/* Sorted, duplicate-free set of command names. Merged names are interned
+ * back to back in large chunks that never move, so pointers into the index
+ * stay valid until command_index_free. */
+typedef struct command_index {
+    const char **names;   /* Sorted by strcmp, no duplicates */
+    size_t count;         /* Number of names */
+    size_t cap;           /* Capacity of names */
+    char **chunks;        /* String pool */
+    size_t num_chunks;
+    size_t chunk_used;    /* Bytes used in the last chunk */
+    size_t chunk_cap;     /* Size of the last chunk */
+} command_index;
+
+/* Prepare an empty index */
+void command_index_init(command_index *idx);
+
+/* Release the index and every interned name */
+void command_index_free(command_index *idx);
+
+/* Sort an array of names with strcmp order, as command_index_merge wants */
+void command_index_sort(char **names, size_t count);
+
+/* Add sorted names, interning those not already present.
+ * Returns the number of names added, or -1 on allocation failure. */
+long command_index_merge(command_index *idx, char *const *sorted, size_t count);
+
+/* Add sorted names without copying them; the caller keeps the strings alive
+ * for as long as the index is used (e.g. names in a mapped cache file) */
+long command_index_merge_shared(command_index *idx, const char *const *sorted, size_t count);
+
+/* Find the names starting with prefix[0..len). Returns how many there are
+ * and stores the position of the first in *first; they are contiguous. */
+size_t command_index_prefix(const command_index *idx, const char *prefix, size_t len, size_t *first);
+
+/* Whether name is in the index */
+int command_index_contains(const command_index *idx, const char *name);
+
+#endif /* COMMAND_INDEX_H */
@@ -0,0 +1,65 @@
+#ifndef COMPLETION_CACHE_H
+#define COMPLETION_CACHE_H
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <time.h>
+#include "command_index.h"
+
+/* Cache file, under $XDG_CACHE_HOME (or ~/.cache) */
+#define GHOST_CACHE_DIR "ghsh"
+#define GHOST_COMMAND_CACHE_FILE "commands"
+
+/* Identity of a directory listing: a cached listing is reused only while
+ * the directory still has the same device, inode and mtime */
+typedef struct dir_stamp {
+    dev_t dev;
+    ino_t ino;
+    struct timespec mtime;
+} dir_stamp;
+
+/* Read-only mapping of the command cache */
+typedef struct completion_cache {
+    void *map;
+    size_t size;
+} completion_cache;
+
+/* A directory to write to the cache */
+typedef struct completion_cache_dir {
+    const char *path;
+    dir_stamp stamp;
+    const command_index *names;
+} completion_cache_dir;
+
+/* Build the path of a file in the cache directory, creating the directory
+ * if asked. Returns 0 on success. */
+int completion_cache_path(char *buf, size_t size, const char *name, int create);
+
+/* Replace a file in the cache directory atomically with size bytes of buf.
+ * Returns 0 on success. */
+int completion_cache_write(const char *name, const char *buf, size_t size);
+
+/* Modification time from stat data (st_mtim, or st_mtimespec on macOS) */
+struct timespec stat_mtime(const struct stat *st);
+
+/* Take the stamp of a directory from its stat data */
+void dir_stamp_from_stat(dir_stamp *stamp, const struct stat *st);
+
+/* Map the cache file. Returns 0 on success; on failure (no cache yet, or a
+ * file that is damaged or from another version) the cache is left empty. */
+int completion_cache_load(completion_cache *cache);
+
+/* Add the cached listing of dir to names if its stamp still matches.
+ * The names point into the mapping. Returns 0 on a hit, -1 otherwise. */
+int completion_cache_lookup(const completion_cache *cache, const char *dir,
+                            const dir_stamp *stamp, command_index *names);
+
+/* Write a new cache file with the given directories, replacing the old one
+ * atomically (an existing mapping stays valid). Returns 0 on success. */
+int completion_cache_save(const completion_cache_dir *dirs, size_t count);
+
+/* Unmap the cache; names taken from it are invalid afterwards */
+void completion_cache_close(completion_cache *cache);
+
+#endif /* COMPLETION_CACHE_H */
@@ -0,0 +1,63 @@
+#ifndef COMPLETION_SPEC_H
+#define COMPLETION_SPEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Completion specs describe the subcommands and flags of a command. They
+ * are written as text, one file per command (e.g. git.spec), and found in
+ * $GHSH_SPEC_PATH (directories separated by ':'), or else in
+ * ~/.config/ghsh/completions and GHOST_SPEC_DIR. A line lists the words
+ * that may follow a subcommand path:
+ *
+ *     # comment
+ *     : add commit remote --version
+ *     add: @files --all --patch
+ *     remote: add remove
+ *     remote remove: @remotes
+ *
+ * Words starting with '@' name a source of arguments instead: @files,
+ * @dirs, @branches, @tags or @remotes. On first use in a session a spec is
+ * compiled into a binary table under ~/.cache/ghsh and mapped; nothing is
+ * read before a command's arguments are completed. */
+#ifndef GHOST_SPEC_DIR
+#define GHOST_SPEC_DIR "/usr/local/share/ghost-shell/completions"
+#endif
+#define GHOST_SPEC_SUFFIX ".spec"
+
+/* Largest spec source read */
+#define GHOST_SPEC_MAX_SIZE (1024 * 1024)
+
+/* Argument sources of a spec node */
+#define SPEC_SOURCE_FILES    0x01
+#define SPEC_SOURCE_DIRS     0x02
+#define SPEC_SOURCE_BRANCHES 0x04
+#define SPEC_SOURCE_TAGS     0x08
+#define SPEC_SOURCE_REMOTES  0x10
+
+/* Compiled spec of one command */
+typedef struct completion_spec completion_spec;
+
+/* The spec for command (a plain name), loading it on first use: from its
+ * compiled form while that is newer than the source, compiling it
+ * otherwise. Returns NULL if the command has none. */
+const completion_spec *completion_spec_find(const char *command);
+
+/* Follow the words after the command name through the subcommand tree;
+ * flags and words that are not subcommands leave the position unchanged.
+ * Returns the node the next word is completed at. */
+uint32_t completion_spec_walk(const completion_spec *spec, const char *const *words, size_t count);
+
+/* Words listed at node that start with prefix, sorted, as views into the
+ * spec. Flags are only included when prefix starts with '-'. Returns how
+ * many there are; *words is malloc'd (NULL when there are none). */
+size_t completion_spec_words(const completion_spec *spec, uint32_t node, const char *prefix,
+                             const char ***words);
+
+/* The SPEC_SOURCE_* flags of node */
+unsigned completion_spec_sources(const completion_spec *spec, uint32_t node);
+
+/* Release all loaded specs */
+void completion_spec_cleanup(void);
+
+#endif /* COMPLETION_SPEC_H */
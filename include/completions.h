@@ -1,11 +1,34 @@
 #ifndef COMPLETIONS_H
 #define COMPLETIONS_H
 
+#include <stddef.h>
 #include <histedit.h>
 
+/* Above this many matches, ask before listing them */
+#define GHOST_COMPLETION_QUERY_ITEMS 100
+
+/* Close commands looked at when suggesting one for an unknown name */
+#define GHOST_SUGGEST_CANDIDATES 32
+
 /* Initialize completion system */
 void completions_init(void);
 
+/* Wait for the PATH index, at most the filesystem deadline, then apply
+ * changes seen since it was built (inotify). Returns 1 if it is complete,
+ * 0 if some directories have not answered yet. */
+int completions_wait_index(void);
+
+/* Progress of the PATH index; dirs_cached counts directories taken from the
+ * on-disk cache, and elapsed_ms is -1 until the index is complete */
+void completions_index_status(size_t *dirs_done, size_t *dirs_total, size_t *dirs_cached,
+                              size_t *commands_found, double *elapsed_ms);
+
+/* Known commands (builtins included) closest to a name that was not
+ * found, best first: fewest typos, where swapping two letters is one, then
+ * the most frecent. Stores up to max names, valid until the PATH index next
+ * changes, and returns how many there are. */
+size_t completions_suggest(const char *name, const char **suggestions, size_t max);
+
 /* Clean up completion system */
 void completions_cleanup(void);
 
@@ -0,0 +1,16 @@
+#ifndef CORRECTION_H
+#define CORRECTION_H
+
+/* Suggestions listed after "command not found" */
+#define GHOST_SUGGEST_SHOWN 3
+
+/* Print the known commands closest to name, if any, after it was not
+ * found: "ghost-shell: did you mean: git, gio?" */
+void correction_report(const char *name);
+
+/* With GHSH_CORRECT=1, when the first word of a line typed at the prompt
+ * is not a known command, offer to run the line with the closest one
+ * instead. Returns the corrected line (malloc'd) if accepted, else NULL. */
+char *correction_offer(const char *line);
+
+#endif /* CORRECTION_H */
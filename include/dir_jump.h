@@ -0,0 +1,56 @@
+#ifndef DIR_JUMP_H
+#define DIR_JUMP_H
+
+#include <stddef.h>
+
+/* File of the directory database, beside the history store */
+#define GHOST_DIR_JUMP_FILE "dirs"
+
+/* Directories and path bytes a new database has room for; it doubles
+ * whenever either runs out */
+#define GHOST_DIR_JUMP_MIN_ENTRIES 1024
+#define GHOST_DIR_JUMP_MIN_STRINGS (64 * 1024)
+
+/* Visits counted, at least GHOST_DIR_JUMP_AGE_MIN and on average
+ * GHOST_DIR_JUMP_AGE_AVERAGE per directory, before every count is halved,
+ * so directories no longer used fade out (those down to nothing are
+ * dropped) */
+#define GHOST_DIR_JUMP_AGE_MIN 10000
+#define GHOST_DIR_JUMP_AGE_AVERAGE 10
+
+/* Best matches z looks at for one that still exists, and cd completion
+ * offers when nothing in the directory matches */
+#define GHOST_DIR_JUMP_CANDIDATES 16
+
+/* Every directory the shell has been in, ranked by frecency: how often it
+ * was visited weighted by how long ago the last visit was. The database
+ * is one file mapped shared by all shells: a header, the entries kept in
+ * descending order of visit count, an open-addressing hash table over
+ * their paths and the path bytes. A visit updates its entry in place
+ * (moving it ahead of those it now outnumbers with a single swap), so a
+ * lookup runs from the most visited down and stops as soon as nothing
+ * further can outrank what it found. Only growing or ageing rewrites the
+ * file. */
+
+/* Open the database, creating it if needed. Returns -1 if it cannot be
+ * used. */
+int dir_jump_open(void);
+
+/* Record a visit to the absolute directory path */
+void dir_jump_add(const char *path);
+
+/* Frecency of path; 0 if it was never visited */
+double dir_jump_score(const char *path);
+
+/* Put up to max directories matching all fragments in paths, best first,
+ * each to be freed, and their frecency in scores if not NULL. A directory
+ * matches when the fragments occur in it in order, the last one in its
+ * final component; a fragment with a capital is case-sensitive. exclude
+ * (the current directory) is never returned. Returns the number found. */
+size_t dir_jump_search(const char *const *fragments, size_t num_fragments, const char *exclude,
+                       char **paths, double *scores, size_t max);
+
+/* Unmap the database */
+void dir_jump_close(void);
+
+#endif /* DIR_JUMP_H */
@@ -0,0 +1,47 @@
+#ifndef DIR_LISTING_H
+#define DIR_LISTING_H
+
+#include <stddef.h>
+
+/* Number of directory listings kept for file completion */
+#define GHOST_LISTING_CACHE_SIZE 8
+
+/* Bytes of directory entries read per getdents64 call */
+#define GHOST_DIRENT_BUFFER_SIZE (32 * 1024)
+
+/* Milliseconds a listing is used without checking the directory's mtime */
+#define GHOST_LISTING_TTL_MS 1000
+
+/* Entry of a cached directory listing */
+typedef struct dir_entry {
+    const char *name;     /* File name */
+    const char *display;  /* Name as completed: spaces escaped, '/' after directories */
+    int is_dir;           /* Directory, or a symlink to one */
+} dir_entry;
+
+/* Listing of path sorted by name, read from the cache while the directory's
+ * device, inode and mtime are unchanged. Within GHOST_LISTING_TTL_MS of the
+ * last check no system call is made at all. Checking and reading happen on
+ * a filesystem worker; if that takes longer than the deadline, *stale is
+ * set and the cached listing (or NULL if there is none) is returned.
+ * Returns NULL if the directory cannot be read. The entries stay valid
+ * until the next dir_listing_get. */
+const dir_entry *dir_listing_get(const char *path, size_t *count, int *stale);
+
+/* Find the entries whose name starts with prefix. Returns how many there
+ * are and stores the position of the first in *first; they are contiguous. */
+size_t dir_listing_prefix(const dir_entry *entries, size_t count, const char *prefix, size_t *first);
+
+/* Make the next lookup of every listing check its directory again; called
+ * before each prompt, since the last command may have changed files or the
+ * current directory */
+void dir_listing_expire(void);
+
+/* Forget listings of relative paths, and drop the result of one still
+ * being read; called when the current directory changes */
+void dir_listing_chdir(void);
+
+/* Release all cached listings */
+void dir_listing_cleanup(void);
+
+#endif /* DIR_LISTING_H */
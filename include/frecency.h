@@ -0,0 +1,36 @@
+#ifndef FRECENCY_H
+#define FRECENCY_H
+
+#include <time.h>
+
+/* File the command counts are kept in, beside the directory database */
+#define GHOST_FRECENCY_FILE "commands"
+
+/* What a frecency entry counts */
+typedef enum {
+    FRECENCY_COMMAND    /* Command names that were run (directories are
+                         * ranked by dir_jump.h) */
+} frecency_kind;
+
+/* Record one use of key */
+void frecency_add(frecency_kind kind, const char *key);
+
+/* Frecency of key: its use count weighted by how recently it was last
+ * used (x4 within the hour, x2 within the day, x0.5 within the week,
+ * x0.25 after that); 0 for keys never used */
+double frecency_score(frecency_kind kind, const char *key);
+
+/* Weight of a use made age seconds ago */
+double frecency_weight(time_t age);
+
+/* Read the counts saved by earlier sessions */
+void frecency_load(void);
+
+/* Save the counts, adding what this session counted to what other shells
+ * saved meanwhile. Does nothing unless frecency_load was called. */
+void frecency_save(void);
+
+/* Release all entries */
+void frecency_cleanup(void);
+
+#endif /* FRECENCY_H */
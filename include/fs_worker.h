@@ -0,0 +1,36 @@
+#ifndef FS_WORKER_H
+#define FS_WORKER_H
+
+/* Milliseconds the line editor waits for filesystem work (completion
+ * listings, the prompt's working directory) before going on with stale or
+ * partial results; GHSH_FS_DEADLINE_MS overrides it and 0 waits forever */
+#define GHOST_FS_DEADLINE_MS 200
+
+/* Worker threads; more are only started while the others are stuck */
+#define GHOST_FS_MAX_WORKERS 4
+
+/* Appended to the prompt's directory while it could not be resolved */
+#define GHOST_STALE_MARKER "?"
+
+/* Filesystem work running on a worker thread */
+typedef struct fs_task fs_task;
+
+typedef void (*fs_task_fn)(void *arg);
+
+/* Configured deadline in milliseconds (0: none) */
+long fs_deadline_ms(void);
+
+/* Queue fn(arg) for a worker; free_arg releases arg once the task is
+ * dropped. Returns NULL if no worker can be started, in which case the
+ * caller should do the work itself. */
+fs_task *fs_task_start(fs_task_fn fn, void *arg, void (*free_arg)(void *));
+
+/* Wait up to ms milliseconds (0: forever) for a task. Returns 1 once it has
+ * finished and its arg holds the result, 0 if it is still running. */
+int fs_task_wait(fs_task *task, long ms);
+
+/* Drop a task and its arg (take what is needed out of arg first). The arg
+ * of a task that is still running is freed by the worker when it is done. */
+void fs_task_release(fs_task *task);
+
+#endif /* FS_WORKER_H */
@@ -0,0 +1,56 @@
+#ifndef FUZZY_H
+#define FUZZY_H
+
+#include <stddef.h>
+
+/* Longest pattern accepted by the fuzzy matcher */
+#define GHOST_FUZZY_MAX_PATTERN 64
+
+/* Candidates longer than this still match but are not scored */
+#define GHOST_FUZZY_MAX_CANDIDATE 256
+
+/* Number of best matches fuzzy_rank keeps */
+#define GHOST_FUZZY_MAX_RESULTS 100
+
+/* Largest score a candidate's frecency can add (about one extra
+ * consecutive character) */
+#define GHOST_FUZZY_FRECENCY_WEIGHT 1.0
+
+/* Compiled fuzzy pattern. A pattern without capitals matches either case. */
+typedef struct fuzzy_pattern {
+    char text[GHOST_FUZZY_MAX_PATTERN + 1];
+    size_t len;
+    char accept[GHOST_FUZZY_MAX_PATTERN][3];  /* strpbrk sets: the character in each accepted case */
+    int ignore_case;
+} fuzzy_pattern;
+
+/* Ranked candidate */
+typedef struct fuzzy_match {
+    size_t index;           /* Position in the candidate array */
+    const char *candidate;  /* The candidate itself */
+    size_t length;          /* Its length */
+    double score;           /* Match quality plus bonus; higher is better */
+} fuzzy_match;
+
+/* Extra score for a candidate, e.g. its frecency */
+typedef double (*fuzzy_bonus_fn)(const char *candidate, void *arg);
+
+/* Compile pattern. Returns 0 on success, -1 if it is empty or too long. */
+int fuzzy_compile(fuzzy_pattern *pattern, const char *text);
+
+/* Whether the pattern is a subsequence of candidate */
+int fuzzy_has_match(const fuzzy_pattern *pattern, const char *candidate);
+
+/* Match quality of a candidate known to match: consecutive characters and
+ * characters at word starts (after '/', '-', '_', '.', ' ' or a lower to
+ * upper case change) score high, gaps cost a little */
+double fuzzy_score(const fuzzy_pattern *pattern, const char *candidate);
+
+/* Find the candidates matching pattern and rank them, best first, keeping
+ * at most GHOST_FUZZY_MAX_RESULTS; bonus may be NULL. Returns the number
+ * kept and stores a malloc'd array of them in *matches (NULL when there
+ * are none or on allocation failure). */
+size_t fuzzy_rank(const fuzzy_pattern *pattern, const char *const *candidates, size_t count,
+                  fuzzy_bonus_fn bonus, void *arg, fuzzy_match **matches);
+
+#endif /* FUZZY_H */
@@ -64,6 +64,7 @@ void ghost_ai_clear_history(ghost_ai_context *ai_ctx);
 /* Helper functions */
 void ghost_ai_display_command(const char *command, char *modified_command, size_t modified_size);
 void ghost_ai_execute_commands(char **commands, size_t cmd_count, struct shell_context *shell_ctx);
-char *ghost_ai_capture_command_output(const char *command, ghost_ai_context *ai_ctx);
+char *ghost_ai_capture_command_output(const char *command, ghost_ai_context *ai_ctx,
+                                      struct shell_context *shell_ctx);
 
 #endif /* GHOST_AI_H */
@@ -22,17 +22,32 @@
 extern History *hist;
 extern HistEvent ev;
 
+/* How the next pipeline of a command list runs */
+typedef enum {
+    LIST_SEQ = 0,   /* ; or & (always) */
+    LIST_AND,       /* && (if the previous pipeline succeeded) */
+    LIST_OR         /* || (if the previous pipeline failed) */
+} ghost_list_op;
+
 /* Command structure */
 typedef struct ghost_command {
     char *name;           /* Command name */
     char **args;         /* Command arguments */
     size_t arg_count;    /* Number of arguments */
+    char *arg_pool;      /* Glob matches stored back to back; args point into it */
+    size_t arg_pool_size;
+    size_t glob_start;   /* args[glob_start..glob_end) spans the glob matches; */
+    size_t glob_end;     /* literal words in between are not (command_arg_globbed) */
     char *input_file;    /* Input redirection file */
     char *output_file;   /* Output redirection file */
     int append_output;   /* Whether to append to output file */
-    char *here_doc;      /* Here document content */
+    int here_doc_fd;     /* Here-document/here-string body (-1: none) */
     int background;      /* Run in background flag */
+    int timed;           /* Pipeline heads: prefixed with the time keyword */
     struct ghost_command *next;  /* Next command in pipeline */
+    ghost_list_op list_op;       /* Pipeline heads: when next_list runs */
+    struct ghost_command *next_list;  /* Pipeline heads: next pipeline in list */
+    char *deferred;      /* Pipeline heads after the first: source text, parsed when reached */
 } ghost_command;
 
 /* Forward declaration for ghost_ai_context */
@@ -53,11 +68,30 @@ void shell_init(shell_context *ctx);
 void shell_loop(shell_context *ctx);
 void shell_cleanup(shell_context *ctx);
 
+/* Minimal setup for -c and script mode: no line editor, history,
+ * completion index or job control */
+void shell_init_noninteractive(shell_context *ctx);
+
+/* Run every line of a script file (or of text when file is NULL) through
+ * parse_command/execute_command. name is used in error messages. Returns
+ * the status of the last command. With sourced set (the source builtin),
+ * each failing line is reported as "source: error in NAME line N" and the
+ * last non-zero status is returned instead. */
+int shell_run_script(FILE *file, const char *text, const char *name, int sourced, shell_context *ctx);
+
+/* Whether a script is being run, and its next line (malloc'd, NULL at the
+ * end) for constructs such as here-documents that read ahead */
+int shell_script_active(void);
+char *shell_script_line(void);
+
 /* Command handling */
 ghost_command *parse_command(const char *input);
 int execute_command(ghost_command *cmd, shell_context *ctx);
 void free_command(ghost_command *cmd);
 
+/* Whether an argument of cmd came from glob expansion */
+int command_arg_globbed(const ghost_command *cmd, const char *arg);
+
 /* Built-in commands */
 int builtin_cd(ghost_command *cmd, shell_context *ctx);
 int builtin_exit(ghost_command *cmd, shell_context *ctx);
@@ -66,6 +100,8 @@ int builtin_history(ghost_command *cmd, shell_context *ctx);
 int builtin_call(ghost_command *cmd, shell_context *ctx);
 int builtin_export(ghost_command *cmd, shell_context *ctx);
 int builtin_source(ghost_command *cmd, shell_context *ctx);
+int builtin_hash(ghost_command *cmd, shell_context *ctx);
+int builtin_z(ghost_command *cmd, shell_context *ctx);
 
 /* Utility functions */
 char *read_line(void);
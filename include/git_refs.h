@@ -0,0 +1,29 @@
+#ifndef GIT_REFS_H
+#define GIT_REFS_H
+
+#include "command_index.h"
+
+/* Number of repositories whose refs are kept for completion */
+#define GHOST_GIT_REPO_CACHE_SIZE 8
+
+/* Kinds of names completion can take from a repository */
+typedef enum git_ref_kind {
+    GIT_REF_BRANCHES,   /* refs/heads */
+    GIT_REF_TAGS,       /* refs/tags */
+    GIT_REF_REMOTES,    /* [remote "..."] sections of the config */
+    GIT_REF_KINDS
+} git_ref_kind;
+
+/* Names of the given kind in the repository containing the working
+ * directory, sorted. They are read from the repository's files (no git
+ * process is run) and cached per repository; a later call only stats the
+ * files and directories they came from. Finding the repository and
+ * reading happen on a filesystem worker; if that takes longer than the
+ * deadline, *stale is set and NULL is returned. Returns NULL outside a
+ * repository. The index stays valid until the next git_refs_get. */
+const command_index *git_refs_get(git_ref_kind kind, int *stale);
+
+/* Release all cached refs */
+void git_refs_cleanup(void);
+
+#endif /* GIT_REFS_H */
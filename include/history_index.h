@@ -0,0 +1,28 @@
+#ifndef HISTORY_INDEX_H
+#define HISTORY_INDEX_H
+
+#include <stddef.h>
+
+/* Distinct lines kept before the index is rebuilt from the history list */
+#define GHOST_HISTORY_INDEX_MAX_LINES 4096
+
+/* Prefix index over history lines for autosuggestions: a trie over the
+ * bytes of each line in which every node remembers the newest line that
+ * passes through it, so a lookup only walks the prefix. Lines are stored
+ * once; entering a line again makes it the newest. */
+
+/* Add a line as the newest */
+void history_index_add(const char *line);
+
+/* Newest line that starts with prefix[0..len), or NULL if there is none
+ * or it is the prefix itself. The line stays valid until the index is
+ * cleared. */
+const char *history_index_suggest(const char *prefix, size_t len);
+
+/* Number of distinct lines */
+size_t history_index_count(void);
+
+/* Drop every line */
+void history_index_clear(void);
+
+#endif /* HISTORY_INDEX_H */
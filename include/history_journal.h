@@ -0,0 +1,43 @@
+#ifndef HISTORY_JOURNAL_H
+#define HISTORY_JOURNAL_H
+
+/* Entries appended before the journal is flushed to disk */
+#define GHOST_JOURNAL_SYNC_BATCH 16
+
+/* Seconds an appended entry may wait for the flush */
+#define GHOST_JOURNAL_SYNC_SECONDS 5
+
+/* Entries of this shell remembered until they are read back when sharing */
+#define GHOST_JOURNAL_OWN_MAX 256
+
+/* The history file as an append-only journal. It keeps libedit's format
+ * (a "_HiStOrY_V2_" header, then one encoded line per entry, oldest first)
+ * so H_LOAD reads it as before, but each entry costs one O_APPEND write
+ * instead of H_SAVE rewriting the whole file. A background thread flushes
+ * the writes in batches and, once the file holds twice as many lines as the
+ * history keeps, compacts it: duplicates are dropped (the newest copy
+ * stays) and it is trimmed to the newest keep lines. Only compaction
+ * rewrites the file. Appends take no lock: a shell whose write raced with
+ * a compaction sees that the file was replaced and writes the entry again.
+ *
+ * Shells sharing the journal (GHSH_SHARE_HISTORY=1) also read what the
+ * others append: each remembers how far into the file it has read and
+ * picks up only what was added after that. */
+
+/* Start journaling to path, keeping up to keep entries; with share set,
+ * entries appended by other shells can be pulled in. Returns -1 if the
+ * background thread cannot be started; entries are then still appended
+ * and flushed when the journal is closed. */
+int history_journal_open(const char *path, int keep, int share);
+
+/* Append an entry */
+void history_journal_append(const char *line);
+
+/* When sharing, call add for each entry other shells appended since the
+ * last call (or since the journal was opened), oldest first */
+void history_journal_pull(void (*add)(const char *line, void *arg), void *arg);
+
+/* Flush what is pending and stop the background thread */
+void history_journal_close(void);
+
+#endif /* HISTORY_JOURNAL_H */
@@ -0,0 +1,21 @@
+#ifndef HISTORY_SEARCH_H
+#define HISTORY_SEARCH_H
+
+#include "ghost_shell.h"
+
+/* Entries history search lists without -n */
+#define GHOST_HISTORY_SEARCH_ROWS 50
+
+/* Bind Ctrl-R to an incremental search of the history store: typing
+ * narrows it to the newest command containing what was typed, Ctrl-R
+ * again goes to the next older one, Enter runs it, Ctrl-G gives up and
+ * any other key keeps it on the line for editing */
+void history_search_init(EditLine *el);
+
+/* history search [-e] [-l] [-n N] [--cwd DIR] [--status N | --failed]
+ * [--since WHEN] [--until WHEN] [pattern...], with the arguments from
+ * args[first] on. WHEN is a time ago (30m, 2h, 3d, 1w) or a date
+ * (YYYY-MM-DD). */
+int history_search_builtin(ghost_command *cmd, size_t first);
+
+#endif /* HISTORY_SEARCH_H */
@@ -0,0 +1,74 @@
+#ifndef HISTORY_STORE_H
+#define HISTORY_STORE_H
+
+#include <time.h>
+
+/* Files of the store under $XDG_DATA_HOME/ghsh (~/.local/share/ghsh) */
+#define GHOST_STORE_ENTRIES_FILE "history"
+#define GHOST_STORE_INDEX_FILE "history.idx"
+
+/* Unindexed bytes at the end of the entry file before the index is
+ * rebuilt: at least GHOST_STORE_MIN_TAIL and 1/GHOST_STORE_TAIL_SHARE of
+ * what is indexed, so that rebuilding, which rewrites the whole index,
+ * gets rarer as it grows while the part scanned directly stays small */
+#define GHOST_STORE_MIN_TAIL (64 * 1024)
+#define GHOST_STORE_TAIL_SHARE 16
+
+/* Every command run at the prompt, kept for good: an entry file that is
+ * only ever appended to (command, directory, time and exit status per
+ * entry) and a trigram index over it, both read through mmap. The index
+ * maps each three-byte sequence of a command (ASCII case folded) to the
+ * entries containing it, so a substring search only looks at entries
+ * holding all of the pattern's trigrams. Entries appended since the index
+ * was built are scanned directly; once there are enough of them a
+ * background thread merges them into a new index. */
+
+/* What to look for; zero fields match everything */
+typedef struct history_query {
+    const char *pattern;    /* Substring, or regex with regex set; a
+                             * capital makes it case-sensitive */
+    int regex;              /* pattern is a POSIX extended regex */
+    const char *cwd;        /* Only entries run in this directory */
+    int status_filter;      /* 1: exit status is status, 2: non-zero */
+    int status;
+    time_t since;           /* Only entries run at or after this time */
+    time_t until;           /* Only entries run before this time */
+} history_query;
+
+/* An entry found by history_store_search; its strings stay valid until
+ * the next call into the store */
+typedef struct history_entry {
+    const char *command;
+    const char *cwd;        /* "" if unknown */
+    time_t time;            /* 0 if unknown */
+    int status;             /* -1 if unknown */
+} history_entry;
+
+/* Called for each match, newest first; return non-zero to stop */
+typedef int (*history_visit_fn)(const history_entry *entry, void *arg);
+
+/* Put the path of the file name in the store's directory in buf,
+ * creating the directories on the way if create is set. Returns -1 if
+ * there is no HOME or it does not fit. */
+int history_store_path(char *buf, size_t size, const char *name, int create);
+
+/* Open the store, creating it if needed. Returns 1 if it was just created
+ * (and is empty), 0 if it was opened, -1 if it cannot be used. */
+int history_store_open(void);
+
+/* Append an entry */
+void history_store_add(const char *command, const char *cwd, time_t when, int status);
+
+/* Visit the entries matching query, newest first. Returns -1 with an
+ * error message in error if the store is not open or the regex is
+ * invalid, else 0. */
+int history_store_search(const history_query *query, history_visit_fn visit, void *arg,
+                         char *error, size_t error_size);
+
+/* Wait for a running index build to finish */
+void history_store_wait(void);
+
+/* Stop a running index build and unmap everything */
+void history_store_close(void);
+
+#endif /* HISTORY_STORE_H */
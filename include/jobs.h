@@ -0,0 +1,123 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <signal.h>
+#include <time.h>
+#include "ghost_shell.h"
+
+/* Number of reaped child statuses buffered between SIGCHLD and the shell */
+#define GHOST_REAP_RING_SIZE 256
+
+/* Process states within a job */
+typedef enum {
+    PROC_RUNNING,
+    PROC_STOPPED,
+    PROC_DONE
+} proc_state;
+
+/* Single process of a pipeline */
+typedef struct job_process {
+    pid_t pid;            /* Process ID */
+    int status;           /* Wait status once stopped or done */
+    proc_state state;     /* Current state */
+    struct timespec started;   /* CLOCK_MONOTONIC when launched */
+    struct timespec finished;  /* CLOCK_MONOTONIC when reaped (PROC_DONE) */
+    struct rusage usage;       /* Resource usage from wait4 (PROC_DONE) */
+} job_process;
+
+/* Pipeline tracked by the job table */
+typedef struct job {
+    int id;                  /* Job number shown as %n */
+    pid_t pgid;              /* Process group, 0 until the first stage starts */
+    char *command;           /* Command line for display */
+    job_process *procs;      /* Processes in pipeline order */
+    size_t num_procs;        /* Number of processes */
+    int background;          /* Started with & or continued with bg */
+    int notified;            /* Completion/stop already reported */
+    int keep;                /* Left in the table when it finishes in the
+                              * foreground, for the caller to read and discard */
+    unsigned long seq;       /* Recency, used to pick the current job */
+    struct job *next;        /* Next job in the table */
+} job;
+
+/* Set up the SIGCHLD reaper and, for interactive shells, job control */
+void jobs_init(int interactive);
+
+/* Free the job table */
+void jobs_cleanup(void);
+
+/* Whether pipelines get their own process group and the terminal */
+int jobs_control_enabled(void);
+
+/* Signals children must see with default disposition */
+void jobs_child_signals(sigset_t *set);
+
+/* Reset signal state in a forked child and join process group pgid
+ * (0 starts a new group, -1 leaves the group alone) */
+void jobs_child_setup(pid_t pgid);
+
+/* Hold back the reaper while a pipeline is being started, so an early
+ * process group leader stays around (as a zombie) for later stages to join */
+void jobs_hold_reaper(sigset_t *old);
+void jobs_release_reaper(const sigset_t *old);
+
+/* Create a job for the pipeline starting at cmd */
+job *job_create(ghost_command *cmd);
+
+/* Record a started process; the first one defines the process group */
+void job_add_process(job *j, pid_t pid);
+
+/* Process group new stages should join (-1 without job control) */
+pid_t job_pgid(job *j);
+
+/* Hand the terminal to a job's process group without waiting */
+void job_give_terminal(job *j);
+
+/* Hand the terminal to a job and wait until it finishes or stops.
+ * Returns the shell status of the last process. */
+int job_wait_foreground(job *j, int cont);
+
+/* Leave a job running in the background and announce it */
+void job_put_background(job *j, int cont);
+
+/* Whether every process of a job has exited */
+int job_finished(job *j);
+
+/* Remove a job from the table (one that never started a process, or a
+ * finished job kept with keep) */
+void job_discard(job *j);
+
+/* Start every stage of a pipeline without waiting for it (command.c); a
+ * command list is handed, as its source text, to a new ghost-shell. The
+ * first stage reads in_fd and the last writes out_fd (-1: inherit).
+ * Returns a job with keep set, or NULL if nothing started (*status says why). */
+job *launch_pipeline(ghost_command *cmd, const char *text, int in_fd, int out_fd, int *status);
+
+/* Wait until one of the jobs in set finishes and return it, or NULL once
+ * *stop becomes non-zero */
+job *jobs_wait_any(job *const *set, size_t n, volatile sig_atomic_t *stop);
+
+/* Shell status of a finished job */
+int job_exit_status(job *j);
+
+/* Send a signal to every process of a job */
+void job_signal(job *j, int sig);
+
+/* Report finished and stopped background jobs (called before each prompt) */
+void jobs_notify(void);
+
+/* Silently drop finished background jobs (called after each command list
+ * when there is no prompt to report them at) */
+void jobs_prune(void);
+
+/* Built-in commands */
+int builtin_jobs(ghost_command *cmd, shell_context *ctx);
+int builtin_fg(ghost_command *cmd, shell_context *ctx);
+int builtin_bg(ghost_command *cmd, shell_context *ctx);
+int builtin_wait(ghost_command *cmd, shell_context *ctx);
+int builtin_kill(ghost_command *cmd, shell_context *ctx);
+
+#endif /* JOBS_H */
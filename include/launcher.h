@@ -0,0 +1,52 @@
+#ifndef LAUNCHER_H
+#define LAUNCHER_H
+
+#include <sys/types.h>
+#include "ghost_shell.h"
+
+/* ARG_MAX to assume when sysconf cannot tell */
+#define GHOST_ARG_MAX_FALLBACK (128 * 1024)
+
+/* Space left free below ARG_MAX, as POSIX asks of xargs */
+#define GHOST_ARG_HEADROOM 2048
+
+/* Launch backends for external commands */
+typedef enum {
+    LAUNCH_SPAWN,    /* posix_spawn (vfork-style, no page table copy) */
+    LAUNCH_FORK      /* classic fork + execvp */
+} launch_backend;
+
+/* Create an anonymous close-on-exec file (memfd, or an unlinked temporary
+ * file where memfd is unavailable). Returns the fd or -1. */
+int anon_file_create(const char *name);
+
+/* Write a whole buffer, retrying short writes. Returns 0 or -1. */
+int anon_file_write(int fd, const char *buf, size_t len);
+
+/* Backend selected by $GHSH_SPAWN ("fork" forces the fork path) */
+launch_backend launcher_backend(void);
+
+/* Bytes available for argv in a new process: ARG_MAX minus the current
+ * environment and some headroom */
+size_t launcher_arg_limit(void);
+
+/* Start one pipeline stage with in_fd/out_fd as stdin/stdout (-1 inherits).
+ * The stage's own redirections take precedence over the pipe fds. The child
+ * joins process group pgid (0 starts a new one, -1 keeps the shell's).
+ * An argument list over launcher_arg_limit() is refused, or with
+ * GHSH_AUTOBATCH=1 run in batches of its glob-expanded arguments.
+ * Returns the child pid, or -1 with *status set to the exit status the
+ * stage should report (127 for an unknown command). */
+pid_t launch_command(ghost_command *cmd, int in_fd, int out_fd, pid_t pgid, int *status);
+
+/* Start a new ghost-shell running line (as with -c), wired up like
+ * launch_command with the redirections of cmd (NULL: none). Builtin stages
+ * and command lists that run beside the shell start this way: forking the
+ * shell itself is unsafe once it has threads. */
+pid_t launch_shell(ghost_command *cmd, const char *line, int in_fd, int out_fd, pid_t pgid, int *status);
+
+/* Join words into a line, each single-quoted so the parser reads it back as
+ * the same word. Returns a malloc'd string, or NULL. */
+char *launcher_quote_words(char *const *words, size_t count);
+
+#endif /* LAUNCHER_H */
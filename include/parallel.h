@@ -0,0 +1,19 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "ghost_shell.h"
+
+/* Separates the command template from its items on the command line */
+#define GHOST_PARALLEL_ITEMS ":::"
+
+/* Most jobs run at once, whatever -j asks for */
+#define GHOST_PARALLEL_MAX_JOBS 1024
+
+/* Exit status is the number of failed jobs, capped here */
+#define GHOST_PARALLEL_MAX_FAILED 101
+
+/* Run a command template for every item with bounded concurrency:
+ * parallel [-j N] [-s] command [args...] [::: item...] */
+int builtin_parallel(ghost_command *cmd, shell_context *ctx);
+
+#endif /* PARALLEL_H */
@@ -0,0 +1,29 @@
+#ifndef PATH_CACHE_H
+#define PATH_CACHE_H
+
+#include <stddef.h>
+
+/* Seconds a "not found" entry is trusted before PATH is searched again */
+#define GHOST_PATH_NEGATIVE_TTL 5
+
+/* Resolve a command name to an executable path via the cache.
+ * Names containing '/' are returned unchanged. Returns NULL if the command
+ * cannot be found. The returned string is owned by the cache. */
+const char *path_cache_lookup(const char *name);
+
+/* Search PATH for name and (re)insert the result, ignoring cached entries */
+const char *path_cache_add(const char *name);
+
+/* Drop a single entry (e.g. after its binary disappeared) */
+void path_cache_forget(const char *name);
+
+/* Drop all entries; called whenever PATH changes */
+void path_cache_reset(void);
+
+/* Print the remembered locations in `hash` format */
+void path_cache_print(void);
+
+/* Release all memory held by the cache */
+void path_cache_cleanup(void);
+
+#endif /* PATH_CACHE_H */
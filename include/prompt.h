@@ -10,4 +10,20 @@ void format_shell_prompt(char *buffer, size_t size, const char *username, const
 /* Helper function to get current directory with ~ for home */
 char *get_formatted_path(void);
 
+/* Helper function to shorten a directory for the prompt: ~ for home, the
+ * full path directly under /, otherwise the last component */
+char *format_prompt_path(const char *cwd);
+
+/* The prompt is rendered once and shown again as it is until something in
+ * it may have changed: the directory (cd, z), a variable (export), the
+ * last command's status or a prompt segment. Each of those marks it out of
+ * date. */
+void prompt_invalidate(void);
+
+/* Whether the prompt rendered last can be shown again */
+int prompt_is_current(void);
+
+/* Record that the prompt was just rendered */
+void prompt_mark_current(void);
+
 #endif /* PROMPT_H */
@@ -0,0 +1,42 @@
+#ifndef PROMPT_SEGMENTS_H
+#define PROMPT_SEGMENTS_H
+
+#include <histedit.h>
+#include <stddef.h>
+
+/* Milliseconds a new prompt waits for its segments before it is drawn
+ * without the ones still being worked out */
+#define GHOST_PROMPT_SEGMENT_WAIT_MS 30
+
+/* Milliseconds a segment may take in all; past it the segment is left out
+ * of the prompt (and git is stopped) */
+#define GHOST_PROMPT_SEGMENT_TIMEOUT_MS 2000
+
+/* Shortest run time of the last command the prompt shows */
+#define GHOST_PROMPT_DURATION_MIN_MS 2000
+
+/* Longest text of one segment */
+#define GHOST_PROMPT_SEGMENT_MAX 128
+
+/* With GHSH_PROMPT_SEGMENTS=1 the prompt shows, after the directory, the
+ * git branch (with * when the work tree has changes), the current
+ * Kubernetes context and how long the last command took if that was a
+ * while. The git and Kubernetes segments run on filesystem workers, so
+ * neither a large repository nor a slow home directory holds up the
+ * prompt: it is drawn with what is known once GHOST_PROMPT_SEGMENT_WAIT_MS
+ * is up and drawn again as the rest come in, while waiting for a key. Sets
+ * up el's character reader to watch for them. Returns 1 if segments are
+ * enabled. */
+int prompt_segments_init(EditLine *el);
+
+/* Start on the segments of the prompt about to be shown in cwd, after a
+ * command that took duration_ms (-1: none ran) */
+void prompt_segments_start(const char *cwd, long duration_ms);
+
+/* Put the segments known so far in buf, each after a space */
+void prompt_segments_format(char *buf, size_t size);
+
+/* Drop segments still being worked out */
+void prompt_segments_cleanup(void);
+
+#endif /* PROMPT_SEGMENTS_H */
@@ -0,0 +1,18 @@
+# Completion spec for docker. See include/completion_spec.h for the format.
+: attach build commit compose container cp create exec image images inspect kill login logout logs network ps pull push restart rm rmi run start stats stop system tag top volume --help --version --context
+
+build: @dirs --tag --file --build-arg --no-cache --pull --target --platform --progress= --quiet
+compose: build config down exec logs ps pull push restart rm run start stop up --file --project-name --profile
+compose up: --detach --build --force-recreate --no-deps --remove-orphans --wait
+compose down: --volumes --remove-orphans --rmi
+compose logs: --follow --tail --timestamps
+container: ls inspect logs prune rm start stop restart
+cp: @files --archive --follow-link
+exec: --interactive --tty --detach --env --user --workdir
+image: build history inspect ls prune pull push rm tag
+logs: --follow --tail --timestamps --since --until
+network: connect create disconnect inspect ls prune rm
+ps: --all --quiet --filter --format --size --latest
+run: --interactive --tty --detach --rm --name --env --env-file --volume --publish --network --entrypoint --workdir --user --platform --restart
+system: df events info prune
+volume: create inspect ls prune rm
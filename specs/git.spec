@@ -0,0 +1,42 @@
+# Completion spec for git. See include/completion_spec.h for the format.
+: add bisect blame branch checkout cherry-pick clean clone commit config diff fetch grep init log merge mv pull push rebase reflog remote reset restore revert rm show stash status switch tag worktree --version --help -C
+
+add: @files --all --patch --update --force --intent-to-add --dry-run --verbose --
+bisect: start bad good skip reset log run
+blame: @files -L -w -C -M --
+branch: @branches --list --all --remotes --delete -d -D --move -m --copy --force --merged --no-merged --contains --set-upstream-to= --unset-upstream --show-current --verbose
+checkout: @branches @tags @files -b -B --track --detach --force --orphan --patch --
+cherry-pick: @branches @tags --continue --abort --skip --edit --no-commit -x
+clean: @files --dry-run --force -d -x -X --interactive
+clone: @dirs --depth --branch --recurse-submodules --bare --mirror --single-branch --filter=
+commit: @files --all --amend --message= --fixup= --squash= --no-edit --signoff --verbose --patch --allow-empty --
+config: --global --local --system --list --get --unset --edit
+diff: @branches @tags @files --cached --staged --stat --name-only --name-status --word-diff --check --
+fetch: @remotes --all --prune --tags --depth --unshallow --dry-run
+grep: -i -n -w -l -e --cached --untracked
+init: @dirs --bare --initial-branch=
+log: @branches @tags @files --oneline --graph --all --decorate --stat --patch --follow --author= --since= --until= --grep= --format= -n --
+merge: @branches @tags --no-ff --ff-only --squash --abort --continue --no-commit --message=
+mv: @files --force --dry-run
+pull: @remotes --rebase --no-rebase --ff-only --all --tags
+push: @remotes @branches --force --force-with-lease --set-upstream --tags --delete --dry-run --all
+rebase: @branches @tags --interactive --continue --abort --skip --onto --autosquash --autostash
+reflog: show expire delete
+remote: add remove rename set-url get-url show prune --verbose
+remote remove: @remotes
+remote rename: @remotes
+remote set-url: @remotes
+remote get-url: @remotes
+remote show: @remotes
+remote prune: @remotes
+reset: @branches @tags @files --soft --mixed --hard --keep --
+restore: @files --staged --worktree --source= --patch --
+revert: @branches @tags --continue --abort --no-commit --no-edit
+rm: @files --cached --force -r --dry-run
+show: @branches @tags @files --stat --name-only --format=
+stash: push pop apply drop list show clear branch
+stash push: @files --message= --keep-index --include-untracked --patch
+switch: @branches --create --force-create --detach --discard-changes -c -C
+tag: @tags --list --delete --annotate --message= --force --sign
+worktree: add list lock move prune remove repair unlock
+worktree add: @dirs @branches -b -B --detach --force
@@ -0,0 +1,15 @@
+# Completion spec for kubectl. See include/completion_spec.h for the format.
+: annotate api-resources apply attach auth config cordon cp create delete describe diff drain edit exec explain expose get label logs patch port-forward rollout run scale set top uncordon version --namespace --context --kubeconfig --help
+
+apply: --filename --kustomize --recursive --dry-run= --server-side --prune --selector
+config: current-context delete-context get-contexts rename-context set-context use-context view
+cp: @files --container
+create: configmap deployment job namespace secret service serviceaccount --filename --dry-run=
+delete: --filename --selector --all --force --grace-period= --wait
+describe: --selector --all-namespaces
+diff: --filename --kustomize
+exec: --stdin --tty --container --
+get: --output= --selector --all-namespaces --watch --show-labels --field-selector
+logs: --follow --container --previous --tail= --since= --timestamps --all-containers
+rollout: history pause restart resume status undo
+top: node pod
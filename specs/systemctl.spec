@@ -0,0 +1,2 @@
+# Completion spec for systemctl. See include/completion_spec.h for the format.
+: cat daemon-reload disable edit enable is-active is-enabled is-failed isolate kill list-dependencies list-timers list-unit-files list-units mask reload reload-or-restart reset-failed restart show start status stop unmask --user --system --now --no-pager --all --type= --state= --quiet --full
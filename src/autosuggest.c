@@ -0,0 +1,171 @@
+#include "autosuggest.h"
+#include "history_index.h"
+#include <sys/ioctl.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <wchar.h>
+
+static size_t prompt_width = 0;
+static int suggestions = 0;  /* GHSH_AUTOSUGGEST=1 */
+static int shown = 0;        /* A suggestion is on screen */
+static int (*input_wait)(void) = NULL;
+
+/* Bytes read past an invalid multibyte sequence, returned next */
+static char pending[MB_LEN_MAX];
+static size_t num_pending = 0;
+
+/* Helper function to count the columns of UTF-8 text, one per character */
+static size_t text_width(const char *s, size_t len) {
+    size_t width = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (((unsigned char)s[i] & 0xC0) != 0x80) width++;
+    }
+    return width;
+}
+
+void autosuggest_set_prompt(const char *prompt) {
+    prompt_width = text_width(prompt, strlen(prompt));
+}
+
+size_t autosuggest_prompt_width(void) {
+    return prompt_width;
+}
+
+void autosuggest_clear_line(EditLine *el, size_t width) {
+    struct winsize ws;
+    size_t cols = 80;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0) {
+        cols = ws.ws_col;
+    }
+    const LineInfo *li = el_line(el);
+    size_t rows = (width + text_width(li->buffer, (size_t)(li->cursor - li->buffer))) / cols;
+    printf("\r");
+    if (rows > 0) printf("\033[%zuA", rows);
+    printf("\033[J");
+    fflush(stdout);
+}
+
+/* Helper function to draw the suggested rest of the line after the cursor.
+ * It is clipped to the screen line, so moving back over it returns the
+ * cursor to where libedit left it. */
+static void draw_suggestion(EditLine *el) {
+    const LineInfo *li = el_line(el);
+    size_t len = (size_t)(li->lastchar - li->buffer);
+    if (li->cursor != li->lastchar) return;
+
+    const char *line = history_index_suggest(li->buffer, len);
+    if (!line) return;
+
+    struct winsize ws;
+    size_t cols = 80;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0) {
+        cols = ws.ws_col;
+    }
+    size_t col = (prompt_width + text_width(li->buffer, len)) % cols;
+    if (col + 1 >= cols) return;
+    size_t room = cols - col - 1;
+
+    /* Whole characters up to the room left, stopping at control characters */
+    const char *rest = line + len;
+    size_t n = 0, width = 0;
+    while (rest[n] && (unsigned char)rest[n] >= 0x20 && width < room) {
+        n++;
+        while (((unsigned char)rest[n] & 0xC0) == 0x80) n++;
+        width++;
+    }
+    if (width == 0) return;
+
+    printf(GHOST_SUGGEST_STYLE "%.*s\033[0m\033[%zuD", (int)n, rest, width);
+    fflush(stdout);
+    shown = 1;
+}
+
+/* Helper function to read one character from the terminal, as libedit's
+ * own reader does. Bytes that do not decode are returned as they are. */
+static int read_char(wchar_t *wc) {
+    char buf[MB_LEN_MAX];
+    size_t len = 0;
+
+    for (;;) {
+        if (num_pending > 0) {
+            buf[len++] = pending[0];
+            memmove(pending, pending + 1, --num_pending);
+        } else {
+            ssize_t n = read(STDIN_FILENO, buf + len, 1);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return (int)n;
+            len++;
+        }
+
+        mbstate_t state;
+        memset(&state, 0, sizeof(state));
+        size_t r = mbrtowc(wc, buf, len, &state);
+        if (r == (size_t)-2 && len < sizeof(buf)) continue;
+        if (r == (size_t)-1 || r == (size_t)-2) {
+            /* Return the first byte; the rest is read again */
+            *wc = (wchar_t)(unsigned char)buf[0];
+            memmove(pending + len - 1, pending, num_pending);
+            memcpy(pending, buf + 1, len - 1);
+            num_pending += len - 1;
+        }
+        return 1;
+    }
+}
+
+/* Character reader for libedit: shows the suggestion while waiting for a
+ * key and takes it off the screen before the key is handled. While it
+ * waits, input_wait may ask for the prompt and line to be drawn again. */
+static int suggest_getc(EditLine *el, wchar_t *wc) {
+    while (num_pending == 0) {
+        if (suggestions) draw_suggestion(el);
+        if (!input_wait || !input_wait()) break;
+        autosuggest_clear_line(el, prompt_width);
+        shown = 0;
+        el_set(el, EL_REFRESH);
+    }
+    int result = read_char(wc);
+    if (shown) {
+        fputs("\033[K", stdout);
+        fflush(stdout);
+        shown = 0;
+    }
+    return result;
+}
+
+/* Insert the suggestion at the end of the line; elsewhere move right */
+static unsigned char accept_suggestion(EditLine *el, int ch) {
+    (void)ch;
+    const LineInfo *li = el_line(el);
+    if (li->cursor < li->lastchar) {
+        el_cursor(el, 1);
+        return CC_CURSOR;
+    }
+
+    size_t len = (size_t)(li->lastchar - li->buffer);
+    const char *line = history_index_suggest(li->buffer, len);
+    if (!line) return CC_ERROR;
+    el_insertstr(el, line + len);
+    return CC_REFRESH;
+}
+
+int autosuggest_init(EditLine *el) {
+    const char *enabled = getenv("GHSH_AUTOSUGGEST");
+    if (!el || !enabled || strcmp(enabled, "1") != 0) return 0;
+
+    suggestions = 1;
+    el_set(el, EL_GETCFN, suggest_getc);
+    el_set(el, EL_ADDFN, "accept-suggestion", "Accept the history suggestion", accept_suggestion);
+    el_set(el, EL_BIND, "^F", "accept-suggestion", NULL);
+    el_set(el, EL_BIND, "\\e[C", "accept-suggestion", NULL);
+    el_set(el, EL_BIND, "\\eOC", "accept-suggestion", NULL);
+    return 1;
+}
+
+void autosuggest_set_input_wait(EditLine *el, int (*wait)(void)) {
+    input_wait = wait;
+    el_set(el, EL_GETCFN, suggest_getc);
+}
@@ -0,0 +1,180 @@
+#include "bk_tree.h"
+#include <stdlib.h>
+#include <string.h>
+
+void bk_tree_init(bk_tree *tree) {
+    memset(tree, 0, sizeof(*tree));
+}
+
+void bk_tree_free(bk_tree *tree) {
+    free(tree->nodes);
+    memset(tree, 0, sizeof(*tree));
+}
+
+unsigned edit_distance(const char *a, size_t len_a, const char *b, size_t len_b) {
+    /* One row of the table at a time */
+    unsigned row[GHOST_BK_MAX_WORD + 1];
+    for (size_t j = 0; j <= len_b; j++) row[j] = (unsigned)j;
+
+    for (size_t i = 1; i <= len_a; i++) {
+        unsigned diag = row[0];
+        row[0] = (unsigned)i;
+        for (size_t j = 1; j <= len_b; j++) {
+            unsigned up = row[j];
+            unsigned best = diag + (a[i - 1] != b[j - 1]);
+            if (up + 1 < best) best = up + 1;
+            if (row[j - 1] + 1 < best) best = row[j - 1] + 1;
+            row[j] = best;
+            diag = up;
+        }
+    }
+    return row[len_b];
+}
+
+unsigned typo_distance(const char *a, size_t len_a, const char *b, size_t len_b) {
+    /* Needs the row before the previous one for transpositions */
+    unsigned rows[3][GHOST_BK_MAX_WORD + 1];
+    unsigned *prev2 = rows[0], *prev = rows[1], *cur = rows[2];
+    for (size_t j = 0; j <= len_b; j++) prev[j] = (unsigned)j;
+
+    for (size_t i = 1; i <= len_a; i++) {
+        cur[0] = (unsigned)i;
+        for (size_t j = 1; j <= len_b; j++) {
+            unsigned best = prev[j - 1] + (a[i - 1] != b[j - 1]);
+            if (prev[j] + 1 < best) best = prev[j] + 1;
+            if (cur[j - 1] + 1 < best) best = cur[j - 1] + 1;
+            if (i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1] && prev2[j - 2] + 1 < best) {
+                best = prev2[j - 2] + 1;
+            }
+            cur[j] = best;
+        }
+        unsigned *t = prev2;
+        prev2 = prev;
+        prev = cur;
+        cur = t;
+    }
+    return prev[len_b];
+}
+
+/* A word prepared for bit-parallel distance computation (Myers, as
+ * formulated by Hyyrö): one bit per character of the word, so a comparison
+ * costs a few operations per character of the other word instead of a row
+ * of the table. Words longer than 64 fall back to edit_distance. */
+typedef struct bit_pattern {
+    const char *word;
+    size_t len;
+    uint64_t peq[256];   /* Positions of each byte in the word */
+} bit_pattern;
+
+static void pattern_init(bit_pattern *p, const char *word, size_t len) {
+    p->word = word;
+    p->len = len;
+    if (len > 64) return;
+    memset(p->peq, 0, sizeof(p->peq));
+    for (size_t i = 0; i < len; i++) p->peq[(unsigned char)word[i]] |= (uint64_t)1 << i;
+}
+
+static unsigned pattern_distance(const bit_pattern *p, const char *text) {
+    size_t m = p->len;
+    if (m > 64) return edit_distance(p->word, m, text, strlen(text));
+    if (m == 0) return (unsigned)strlen(text);
+
+    uint64_t pv = ~(uint64_t)0, mv = 0;
+    uint64_t high = (uint64_t)1 << (m - 1);
+    unsigned score = (unsigned)m;
+    for (const unsigned char *t = (const unsigned char *)text; *t; t++) {
+        uint64_t eq = p->peq[*t];
+        uint64_t xv = eq | mv;
+        uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+        if (ph & high) {
+            score++;
+        } else if (mh & high) {
+            score--;
+        }
+        ph = (ph << 1) | 1;
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+    }
+    return score;
+}
+
+int bk_tree_add(bk_tree *tree, const char *word) {
+    size_t len = strlen(word);
+    if (len > GHOST_BK_MAX_WORD) return 0;
+
+    if (tree->count == tree->cap) {
+        size_t new_cap = tree->cap ? tree->cap * 2 : 1024;
+        bk_node *new_nodes = realloc(tree->nodes, new_cap * sizeof(bk_node));
+        if (!new_nodes) return -1;
+        tree->nodes = new_nodes;
+        tree->cap = new_cap;
+    }
+
+    bk_node *added = &tree->nodes[tree->count];
+    added->word = word;
+    added->child = added->sibling = 0;
+    added->dist = 0;
+    if (tree->count == 0) {
+        tree->count = 1;
+        return 0;
+    }
+
+    /* Walk down along the child at each node's distance */
+    bit_pattern pattern;
+    pattern_init(&pattern, word, len);
+    uint32_t node = 0;
+    for (;;) {
+        unsigned d = pattern_distance(&pattern, tree->nodes[node].word);
+        if (d == 0) return 0;
+
+        uint32_t c = tree->nodes[node].child;
+        while (c && tree->nodes[c].dist != d) c = tree->nodes[c].sibling;
+        if (!c) {
+            added->dist = (uint8_t)d;
+            added->sibling = tree->nodes[node].child;
+            tree->nodes[node].child = (uint32_t)tree->count++;
+            return 0;
+        }
+        node = c;
+    }
+}
+
+size_t bk_tree_search(const bk_tree *tree, const char *word, unsigned max_dist,
+                      bk_match *matches, size_t max_matches) {
+    size_t len = strlen(word);
+    if (tree->count == 0 || len > GHOST_BK_MAX_WORD || max_matches == 0) return 0;
+
+    uint32_t *stack = malloc(tree->count * sizeof(uint32_t));
+    if (!stack) return 0;
+    bit_pattern pattern;
+    pattern_init(&pattern, word, len);
+    size_t depth = 0, found = 0;
+    stack[depth++] = 0;
+
+    while (depth > 0) {
+        const bk_node *n = &tree->nodes[stack[--depth]];
+        unsigned d = pattern_distance(&pattern, n->word);
+
+        /* Keep the closest max_matches, in order */
+        if (d <= max_dist && (found < max_matches || d < matches[found - 1].dist)) {
+            size_t pos = found < max_matches ? found++ : found - 1;
+            while (pos > 0 && matches[pos - 1].dist > d) {
+                matches[pos] = matches[pos - 1];
+                pos--;
+            }
+            matches[pos].word = n->word;
+            matches[pos].dist = d;
+        }
+
+        /* Only children at d-max_dist..d+max_dist can be close enough */
+        for (uint32_t c = n->child; c; c = tree->nodes[c].sibling) {
+            unsigned cd = tree->nodes[c].dist;
+            if (cd + max_dist >= d && cd <= d + max_dist) stack[depth++] = c;
+        }
+    }
+    free(stack);
+    return found;
+}
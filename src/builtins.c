@@ -1,5 +1,9 @@
 #include "ghost_shell.h"
 #include "ghost_ai.h"
+#include "path_cache.h"
+#include "dir_jump.h"
+#include "dir_listing.h"
+#include "history_search.h"
 #include <sys/stat.h>
 #include <errno.h>
 #include <string.h>
@@ -11,30 +15,76 @@
 extern History *hist;
 extern HistEvent ev;
 
-int builtin_cd(ghost_command *cmd, shell_context *ctx) {
-    const char *dir = cmd->arg_count > 1 ? cmd->args[1] : getenv("HOME");
-    if (!dir) {
-        print_error("HOME environment variable not set");
-        return 1;
-    }
-    
+/* Helper function to change to dir for cd or z, and count the visit */
+static int change_directory(const char *name, const char *dir, shell_context *ctx) {
     if (chdir(dir) != 0) {
         char error_msg[256];
-        snprintf(error_msg, sizeof(error_msg), "cd: %s: %s", dir, strerror(errno));
+        snprintf(error_msg, sizeof(error_msg), "%s: %s: %s", name, dir, strerror(errno));
         print_error(error_msg);
         return 1;
     }
     
+    /* Listings of relative paths were of the old directory */
+    dir_listing_chdir();
+    
     /* Update current directory */
     char *new_dir = getcwd(NULL, 0);
     if (new_dir) {
+        dir_jump_add(new_dir);
         free(ctx->current_dir);
         ctx->current_dir = new_dir;
     }
+    prompt_invalidate();
     
     return 0;
 }
 
+int builtin_cd(ghost_command *cmd, shell_context *ctx) {
+    const char *dir = cmd->arg_count > 1 ? cmd->args[1] : getenv("HOME");
+    if (!dir) {
+        print_error("HOME environment variable not set");
+        return 1;
+    }
+    
+    return change_directory("cd", dir, ctx);
+}
+
+int builtin_z(ghost_command *cmd, shell_context *ctx) {
+    int list = cmd->arg_count > 1 && strcmp(cmd->args[1], "-l") == 0;
+    size_t first = list ? 2 : 1;
+    size_t num_fragments = cmd->arg_count - first;
+    
+    /* No fragments goes home and a directory that exists is entered, as
+     * with cd */
+    struct stat st;
+    if (!list && (num_fragments == 0 || (num_fragments == 1 && stat(cmd->args[1], &st) == 0 && S_ISDIR(st.st_mode)))) {
+        return builtin_cd(cmd, ctx);
+    }
+    
+    char *paths[GHOST_DIR_JUMP_CANDIDATES];
+    double scores[GHOST_DIR_JUMP_CANDIDATES];
+    size_t found = dir_jump_search((const char *const *)cmd->args + first, num_fragments, ctx->current_dir,
+                                   paths, scores, GHOST_DIR_JUMP_CANDIDATES);
+    
+    /* The best match that is still a directory */
+    int status = 1, tried = 0;
+    for (size_t i = 0; i < found; i++) {
+        if (list) {
+            printf("%10.1f  %s\n", scores[i], paths[i]);
+            status = 0;
+        } else if (!tried && stat(paths[i], &st) == 0 && S_ISDIR(st.st_mode)) {
+            status = change_directory("z", paths[i], ctx);
+            tried = 1;
+        }
+    }
+    for (size_t i = 0; i < found; i++) free(paths[i]);
+    
+    if (!list && !tried) {
+        print_error("z: no matching directory");
+    }
+    return status;
+}
+
 int builtin_exit(ghost_command *cmd, shell_context *ctx) {
     int exit_status = 0;
     
@@ -59,12 +109,23 @@ int builtin_help(ghost_command *cmd, shell_context *ctx) {
     printf("cd [dir]     Change the current directory (default: HOME)\n");
     printf("exit [n]     Exit the shell with status n (default: 0)\n");
     printf("help         Display this help message\n");
+    printf("z [-l] fragment...  Change to the most frecent directory matching the fragments (-l: list them)\n");
     printf("history      Display command history\n");
+    printf("history search [-e] [-l] [-n N] [--cwd DIR] [--status N|--failed] [--since|--until WHEN] [pattern]\n"
+           "             Search every command run (-e: pattern is a regex)\n");
     printf("call <prompt> Process a prompt using AI\n");
-    printf("export [NAME=VALUE]  Set environment variable (no args: list all)\n\n");
+    printf("export [NAME=VALUE]  Set environment variable (no args: list all)\n");
+    printf("hash [-r] [-d] [name...]  List, add (-d: forget) or reset (-r) remembered command paths\n");
+    printf("jobs [-l]    List background and stopped jobs\n");
+    printf("fg [%%n]      Resume a job in the foreground\n");
+    printf("bg [%%n]      Resume a stopped job in the background\n");
+    printf("wait [%%n|pid] Wait for jobs to finish (no args: all jobs)\n");
+    printf("kill [-sig] %%n|pid  Send a signal to a job or process\n");
+    printf("parallel [-j N] [-s] cmd [{}] [::: items]  Run cmd for each item (or stdin line) concurrently\n");
+    printf("time pipeline  Run a pipeline and report per-stage CPU, memory and timing\n\n");
     printf("Features:\n");
     printf("- Input/output redirection using < and >\n");
-    printf("- Background execution using &\n");
+    printf("- Background execution using & with job control (Ctrl-Z, jobs, fg, bg)\n");
     printf("- Command history (use arrow keys)\n");
     printf("- Tab completion for commands and files\n");
     printf("- AI assistance with the 'call' command\n\n");
@@ -73,9 +134,12 @@ int builtin_help(ghost_command *cmd, shell_context *ctx) {
 }
 
 int builtin_history(ghost_command *cmd, shell_context *ctx) {
-    (void)cmd;  /* Unused parameter */
     (void)ctx;  /* Unused parameter */
     
+    if (cmd->arg_count > 1 && strcmp(cmd->args[1], "search") == 0) {
+        return history_search_builtin(cmd, 2);
+    }
+    
 #ifdef USE_GNU_READLINE
     /* GNU readline implementation */
     HIST_ENTRY **history = history_list();
@@ -153,9 +217,13 @@ int builtin_call(ghost_command *cmd, shell_context *ctx) {
 int builtin_export(ghost_command *cmd, shell_context *ctx) {
     (void)ctx;  /* Unused parameter */
     
+    /* No arguments: list the environment */
     if (cmd->arg_count < 2) {
-        print_error("export: missing argument");
-        return 1;
+        extern char **environ;
+        for (char **env = environ; env && *env; env++) {
+            printf("export %s\n", *env);
+        }
+        return 0;
     }
     
     for (size_t i = 1; i < cmd->arg_count; i++) {
@@ -163,11 +231,52 @@ int builtin_export(ghost_command *cmd, shell_context *ctx) {
             print_error("export: failed to set environment variable");
             return 1;
         }
+        
+        /* The prompt may show it (USER, HOME) */
+        prompt_invalidate();
+        
+        /* Remembered command locations are only valid for the old PATH */
+        if (strncmp(cmd->args[i], "PATH=", 5) == 0) {
+            path_cache_reset();
+        }
     }
     
     return 0;
 }
 
+int builtin_hash(ghost_command *cmd, shell_context *ctx) {
+    (void)ctx;  /* Unused parameter */
+    
+    if (cmd->arg_count < 2) {
+        path_cache_print();
+        return 0;
+    }
+    
+    size_t first = 1;
+    int forget = 0;
+    if (strcmp(cmd->args[1], "-r") == 0) {
+        path_cache_reset();
+        first = 2;
+    } else if (strcmp(cmd->args[1], "-d") == 0) {
+        forget = 1;
+        first = 2;
+    }
+    
+    int status = 0;
+    for (size_t i = first; i < cmd->arg_count; i++) {
+        if (forget) {
+            path_cache_forget(cmd->args[i]);
+        } else if (!path_cache_add(cmd->args[i])) {
+            char error_msg[256];
+            snprintf(error_msg, sizeof(error_msg), "hash: %s: not found", cmd->args[i]);
+            print_error(error_msg);
+            status = 1;
+        }
+    }
+    
+    return status;
+}
+
 int builtin_source(ghost_command *cmd, shell_context *ctx) {
     if (cmd->arg_count < 2) {
         print_error("source: missing file argument");
@@ -200,38 +309,7 @@ int builtin_source(ghost_command *cmd, shell_context *ctx) {
         return 1;
     }
 
-    char line[GHOST_MAX_INPUT_SIZE];
-    int status = 0;
-    int line_num = 0;
-
-    while (fgets(line, sizeof(line), file)) {
-        line_num++;
-        
-        /* Remove trailing newline */
-        size_t len = strlen(line);
-        if (len > 0 && line[len-1] == '\n') {
-            line[len-1] = '\0';
-        }
-        
-        /* Skip empty lines and comments */
-        if (line[0] == '\0' || line[0] == '#') {
-            continue;
-        }
-
-        /* Parse and execute the command */
-        ghost_command *source_cmd = parse_command(line);
-        if (source_cmd) {
-            int cmd_status = execute_command(source_cmd, ctx);
-            if (cmd_status != 0) {
-                char error_msg[256];
-                snprintf(error_msg, sizeof(error_msg), "source: error in %s line %d", filename, line_num);
-                print_error(error_msg);
-                status = cmd_status;
-            }
-            free_command(source_cmd);
-        }
-    }
-
+    int status = shell_run_script(file, NULL, filename, 1, ctx);
     fclose(file);
     return status;
 }
@@ -11,9 +11,15 @@
 #include <fcntl.h>
 #include <histedit.h>
 #include <glob.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "launcher.h"
+#include "jobs.h"
+#include "parallel.h"
+#include "frecency.h"
 
 /* Forward declarations of static functions */
-static ghost_command *parse_single_command(char *input, char **next_cmd);
+static ghost_command *parse_single_command(char *input);
 static int is_builtin(const char *cmd);
 static int handle_builtin(ghost_command *cmd, shell_context *ctx);
 
@@ -27,7 +33,23 @@ static char *expand_env_vars(const char *str) {
         return NULL;
     }
     
+    int in_single = 0, in_double = 0;
+    
     while (str[i] && j < GHOST_MAX_INPUT_SIZE - 1) {
+        /* No expansion inside single quotes or after a backslash */
+        if (str[i] == '\'' && !in_double) {
+            in_single = !in_single;
+        } else if (str[i] == '"' && !in_single) {
+            in_double = !in_double;
+        }
+        if (in_single || (str[i] == '\\' && str[i + 1])) {
+            result[j++] = str[i++];
+            if (!in_single && str[i] && j < GHOST_MAX_INPUT_SIZE - 1) {
+                result[j++] = str[i++];
+            }
+            continue;
+        }
+        
         if (str[i] == '$' && str[i + 1]) {
             /* Found a potential environment variable */
             char var_name[256] = {0};
@@ -65,172 +87,528 @@ static char *expand_env_vars(const char *str) {
     return result;
 }
 
-/* Helper function to read here-document content */
-static char *read_here_doc(const char *delimiter) {
-    char *content = malloc(GHOST_MAX_INPUT_SIZE);
-    char *line = NULL;
-    size_t total_len = 0;
+/* Here-document bodies are staged in a growable buffer and flushed to an
+ * anonymous file whenever this much has accumulated */
+#define GHOST_HEREDOC_CHUNK 65536
+
+typedef struct here_doc_buffer {
+    char *data;     /* Staged bytes not yet written */
+    size_t len;     /* Bytes staged */
+    size_t cap;     /* Buffer capacity */
+    int fd;         /* Anonymous file backing the here-document */
+} here_doc_buffer;
+
+static int here_doc_flush(here_doc_buffer *buf) {
+    if (buf->len == 0) return 0;
+    if (anon_file_write(buf->fd, buf->data, buf->len) < 0) return -1;
+    buf->len = 0;
+    return 0;
+}
+
+static int here_doc_append(here_doc_buffer *buf, const char *text, size_t len) {
+    if (buf->len + len > buf->cap) {
+        size_t new_cap = buf->cap ? buf->cap : 4096;
+        while (new_cap < buf->len + len) new_cap *= 2;
+        char *new_data = realloc(buf->data, new_cap);
+        if (!new_data) return -1;
+        buf->data = new_data;
+        buf->cap = new_cap;
+    }
+    memcpy(buf->data + buf->len, text, len);
+    buf->len += len;
+    return buf->len >= GHOST_HEREDOC_CHUNK ? here_doc_flush(buf) : 0;
+}
+
+/* Helper function to finish a here-document: returns the fd rewound to the
+ * start, or -1 (closing the file) on failure */
+static int here_doc_finish(here_doc_buffer *buf, int ok) {
+    if (ok && here_doc_flush(buf) == 0 && lseek(buf->fd, 0, SEEK_SET) == 0) {
+        free(buf->data);
+        return buf->fd;
+    }
+    fprintf(stderr, "ghost-shell: cannot write here-document: %s\n", strerror(errno));
+    free(buf->data);
+    close(buf->fd);
+    return -1;
+}
+
+/* Helper function to read here-document content into an anonymous file */
+static int read_here_doc(const char *delimiter) {
+    here_doc_buffer buf = {NULL, 0, 0, anon_file_create("ghsh-heredoc")};
+    const char *line = NULL;
+    
+    /* In a script the body is made of the script's following lines */
+    if (shell_script_active()) {
+        if (buf.fd < 0) {
+            print_error("cannot create here-document");
+            return -1;
+        }
+        char *script_line;
+        int ok = 1;
+        while ((script_line = shell_script_line()) != NULL) {
+            int done = strcmp(script_line, delimiter) == 0;
+            if (!done && (here_doc_append(&buf, script_line, strlen(script_line)) < 0 ||
+                          here_doc_append(&buf, "\n", 1) < 0)) {
+                ok = 0;
+                done = 1;
+            }
+            free(script_line);
+            if (done) break;
+        }
+        return here_doc_finish(&buf, ok);
+    }
+    
     EditLine *edit_line = el_init("ghost-shell", stdin, stdout, stderr);
     
-    if (!content || !edit_line) {
-        free(content);
+    if (buf.fd < 0 || !edit_line) {
+        if (buf.fd >= 0) close(buf.fd);
         if (edit_line) el_end(edit_line);
-        return NULL;
+        print_error("cannot create here-document");
+        return -1;
     }
-    content[0] = '\0';
+    
+    size_t delim_len = strlen(delimiter);
+    int ok = 1;
     
     printf("heredoc> ");
     int count;
-    while ((line = (char *)el_gets(edit_line, &count)) != NULL) {
-        /* Remove trailing newline */
-        if (count > 0) {
-            line[count-1] = '\0';
-        }
+    while ((line = el_gets(edit_line, &count)) != NULL) {
+        /* Compare without the trailing newline */
+        size_t line_len = (size_t)count;
+        if (line_len > 0 && line[line_len - 1] == '\n') line_len--;
         
-        if (strcmp(line, delimiter) == 0) {
+        if (line_len == delim_len && strncmp(line, delimiter, delim_len) == 0) {
             break;
         }
         
-        size_t line_len = strlen(line);
-        if (total_len + line_len + 2 >= GHOST_MAX_INPUT_SIZE) {
-            fprintf(stderr, "ghost-shell: here-document too large\n");
-            el_end(edit_line);
-            free(content);
-            return NULL;
+        if (here_doc_append(&buf, line, line_len) < 0 ||
+            here_doc_append(&buf, "\n", 1) < 0) {
+            ok = 0;
+            break;
         }
-        
-        strcat(content, line);
-        strcat(content, "\n");
-        total_len += line_len + 1;
         printf("heredoc> ");
     }
     
     el_end(edit_line);
-    return content;
+    return here_doc_finish(&buf, ok);
+}
+
+/* Helper function to materialize a <<< here-string (word plus newline) */
+static int here_string(const char *word) {
+    here_doc_buffer buf = {NULL, 0, 0, anon_file_create("ghsh-herestring")};
+    if (buf.fd < 0) {
+        print_error("cannot create here-string");
+        return -1;
+    }
+    int ok = here_doc_append(&buf, word, strlen(word)) == 0 &&
+             here_doc_append(&buf, "\n", 1) == 0;
+    return here_doc_finish(&buf, ok);
+}
+
+/* Control operators that end a simple command */
+typedef enum {
+    OP_NONE,        /* End of input */
+    OP_PIPE,        /* | */
+    OP_AND,         /* && */
+    OP_OR,          /* || */
+    OP_SEQ,         /* ; */
+    OP_BACKGROUND   /* & */
+} control_op;
+
+/* Helper function to find the next control operator outside quotes.
+ * Returns a pointer to it (or to the terminating NUL) and sets *op. */
+static char *find_operator(const char *s, control_op *op) {
+    const char *start = s;
+    int in_double = 0, in_single = 0;
+    
+    for (; *s; s++) {
+        if (in_single) {
+            if (*s == '\'') in_single = 0;
+            continue;
+        }
+        if (*s == '\\' && s[1]) {
+            s++;
+            continue;
+        }
+        if (*s == '"') {
+            in_double = !in_double;
+            continue;
+        }
+        if (in_double) continue;
+        if (*s == '\'') {
+            in_single = 1;
+            continue;
+        }
+        
+        if (*s == '|') {
+            *op = s[1] == '|' ? OP_OR : OP_PIPE;
+            return (char *)s;
+        }
+        /* In >& and <& the & belongs to the redirection */
+        if (*s == '&' && (s == start || (s[-1] != '>' && s[-1] != '<'))) {
+            *op = s[1] == '&' ? OP_AND : OP_BACKGROUND;
+            return (char *)s;
+        }
+        if (*s == ';') {
+            *op = OP_SEQ;
+            return (char *)s;
+        }
+    }
+    *op = OP_NONE;
+    return (char *)s;
+}
+
+/* Helper function to step over the operator at op_pos */
+static char *skip_operator(char *op_pos, control_op op) {
+    if (op == OP_AND || op == OP_OR) return op_pos + 2;
+    return op == OP_NONE ? op_pos : op_pos + 1;
+}
+
+/* Helper function to find where the pipeline at s ends: at the first
+ * control operator other than | */
+static const char *pipeline_end(const char *s) {
+    control_op op;
+    const char *end = find_operator(s, &op);
+    while (op == OP_PIPE) end = find_operator(end + 1, &op);
+    return end;
+}
+
+/* The redirection words the parser handles itself */
+static int is_redirection_word(const char *s, size_t len) {
+    return (len == 1) ||
+           (len == 2 && (strncmp(s, ">>", 2) == 0 || strncmp(s, "<<", 2) == 0)) ||
+           (len == 3 && strncmp(s, "<<<", 3) == 0);
+}
+
+/* Helper function to tell whether the pipeline text s[0..len) needs syntax
+ * this parser does not have: command substitution, redirections other than
+ * a lone <, >, >>, << or <<< word (2>&1, 2>/dev/null, >file) and VAR=value
+ * before a command */
+static int needs_posix_shell(const char *s, size_t len) {
+    int in_single = 0, in_double = 0;
+    int word_start = 1;     /* Next character starts a word */
+    int command_start = 1;  /* ...and that word is a command name */
+    
+    for (size_t i = 0; i < len; i++) {
+        char c = s[i];
+        if (in_single) {
+            if (c == '\'') in_single = 0;
+            continue;
+        }
+        if (c == '`' || (c == '$' && i + 1 < len && s[i + 1] == '(')) return 1;
+        if (c == '\\' && i + 1 < len) {
+            i++;
+        } else if (c == '"') {
+            in_double = !in_double;
+        } else if (in_double) {
+            continue;
+        } else if (c == '\'') {
+            in_single = 1;
+        } else if (isspace((unsigned char)c)) {
+            word_start = 1;
+            continue;
+        } else if (c == '|') {
+            word_start = command_start = 1;
+            continue;
+        } else if (c == '<' || c == '>') {
+            size_t run = 1;
+            while (i + run < len && (s[i + run] == '<' || s[i + run] == '>')) run++;
+            if (!word_start || (i + run < len && !isspace((unsigned char)s[i + run])) ||
+                !is_redirection_word(s + i, run)) return 1;
+            i += run - 1;
+        } else if (word_start && command_start && (isalpha((unsigned char)c) || c == '_')) {
+            size_t j = i;
+            while (j < len && (isalnum((unsigned char)s[j]) || s[j] == '_')) j++;
+            if (j < len && s[j] == '=') return 1;
+        }
+        word_start = command_start = 0;
+    }
+    return 0;
+}
+
+/* Helper function to tell whether the first word of s names a builtin */
+static int starts_with_builtin(const char *s) {
+    char name[32];
+    size_t len = 0;
+    while (isspace((unsigned char)*s)) s++;
+    while (s[len] && !isspace((unsigned char)s[len]) && len < sizeof(name) - 1) {
+        name[len] = s[len];
+        len++;
+    }
+    name[len] = '\0';
+    return is_builtin(name);
+}
+
+/* Helper function to build a command that hands text to /bin/sh -c */
+static ghost_command *posix_shell_command(const char *text, size_t len) {
+    ghost_command *cmd = calloc(1, sizeof(ghost_command));
+    if (!cmd) return NULL;
+    cmd->here_doc_fd = -1;
+    cmd->name = strdup("/bin/sh");
+    cmd->args = calloc(4, sizeof(char *));
+    if (cmd->args) {
+        cmd->args[0] = strdup("/bin/sh");
+        cmd->args[1] = strdup("-c");
+        cmd->args[2] = strndup(text, len);
+        cmd->arg_count = 3;
+    }
+    if (!cmd->name || !cmd->args || !cmd->args[0] || !cmd->args[1] || !cmd->args[2]) {
+        print_error("Memory allocation failed");
+        free_command(cmd);
+        return NULL;
+    }
+    return cmd;
+}
+
+static int is_blank(const char *s) {
+    while (*s && isspace((unsigned char)*s)) s++;
+    return *s == '\0';
+}
+
+static void syntax_error(control_op op) {
+    static const char *names[] = {"newline", "|", "&&", "||", ";", "&"};
+    fprintf(stderr, "ghost-shell: syntax error near unexpected token `%s'\n", names[op]);
 }
 
+/* Parse a command line into pipelines joined by ;, &&, || and &. Stages of a
+ * pipeline are linked through next; each pipeline head links to the following
+ * pipeline through next_list, with list_op saying when that one runs.
+ * Only the first pipeline is parsed right away. The others keep their source
+ * text in deferred and are expanded when they are reached, so that they see
+ * the effects (export, cd, new files) of the commands before them. */
 ghost_command *parse_command(const char *input) {
     char *input_copy = strdup(input);
-    char *next_cmd = NULL;
-    ghost_command *first_cmd = NULL;
-    ghost_command *current_cmd = NULL;
+    ghost_command *first_list = NULL;     /* Head of the first pipeline */
+    ghost_command *last_pipeline = NULL;  /* Head of the last finished pipeline */
+    ghost_command *pipeline = NULL;       /* Head of the pipeline being built */
+    ghost_command *current_cmd = NULL;    /* Last stage of that pipeline */
+    char *pipeline_start = NULL;          /* Source text of that pipeline */
     char *cmd_str = input_copy;
     
-    while (cmd_str && *cmd_str) {
-        ghost_command *cmd = parse_single_command(cmd_str, &next_cmd);
-        if (!cmd) {
-            if (first_cmd) free_command(first_cmd);
-            free(input_copy);
-            return NULL;
+    if (!input_copy) return NULL;
+    
+    while (1) {
+        control_op op;
+        char *op_pos = find_operator(cmd_str, &op);
+        char *next_str = skip_operator(op_pos, op);
+        *op_pos = '\0';
+        
+        if (is_blank(cmd_str)) {
+            /* Only a trailing ; or & may follow a complete command */
+            if (op == OP_NONE && !pipeline_start &&
+                (!last_pipeline || last_pipeline->list_op == LIST_SEQ)) break;
+            if (pipeline_start || op == OP_NONE || !last_pipeline ||
+                (op != OP_SEQ && op != OP_BACKGROUND) || !is_blank(next_str)) {
+                syntax_error(op);
+                goto fail;
+            }
+            break;
         }
         
-        if (!first_cmd) {
-            first_cmd = cmd;
-            current_cmd = cmd;
+        if (!pipeline_start) pipeline_start = cmd_str;
+        
+        if (first_list) {
+            /* Later pipelines are parsed when execute_command reaches them */
+            if (op == OP_PIPE) {
+                cmd_str = next_str;
+                continue;
+            }
+            pipeline = calloc(1, sizeof(ghost_command));
+            if (!pipeline) goto fail;
+            pipeline->here_doc_fd = -1;
+            pipeline->deferred = strndup(input + (pipeline_start - input_copy),
+                                         (size_t)(op_pos - pipeline_start));
+            if (!pipeline->deferred) goto fail;
         } else {
-            current_cmd->next = cmd;
+            /* A pipeline may be prefixed with the time keyword */
+            int timed = 0;
+            if (!pipeline) {
+                char *word = cmd_str;
+                while (isspace((unsigned char)*word)) word++;
+                if (strncmp(word, "time", 4) == 0 && isspace((unsigned char)word[4]) &&
+                    !is_blank(word + 4)) {
+                    cmd_str = word + 4;
+                    timed = 1;
+                }
+            }
+            
+            /* A pipeline in syntax this parser lacks runs whole in /bin/sh,
+             * unless it starts with a builtin, which has to run here */
+            ghost_command *cmd = NULL;
+            if (!pipeline) {
+                const char *text = input + (cmd_str - input_copy);
+                const char *end = pipeline_end(text);
+                if (!starts_with_builtin(text) && needs_posix_shell(text, (size_t)(end - text))) {
+                    cmd = posix_shell_command(text, (size_t)(end - text));
+                    if (!cmd) goto fail;
+                    /* Go on after its last stage */
+                    char *copy_end = input_copy + (end - input);
+                    if (copy_end != op_pos) {
+                        op_pos = find_operator(copy_end, &op);
+                        next_str = skip_operator(op_pos, op);
+                        *op_pos = '\0';
+                    }
+                }
+            }
+            if (!cmd) cmd = parse_single_command(cmd_str);
+            if (!cmd) goto fail;
+            cmd->timed = timed;
+            
+            if (!pipeline) {
+                pipeline = cmd;
+            } else {
+                current_cmd->next = cmd;
+            }
             current_cmd = cmd;
+            
+            if (op == OP_PIPE) {
+                cmd_str = next_str;
+                continue;
+            }
         }
         
-        cmd_str = next_cmd;
+        /* Pipeline complete: attach it to the list */
+        if (op == OP_BACKGROUND) pipeline->background = 1;
+        if (!first_list) {
+            first_list = pipeline;
+        } else {
+            last_pipeline->next_list = pipeline;
+        }
+        last_pipeline = pipeline;
+        pipeline = NULL;
+        current_cmd = NULL;
+        pipeline_start = NULL;
+        
+        if (op == OP_NONE) break;
+        last_pipeline->list_op = op == OP_AND ? LIST_AND : op == OP_OR ? LIST_OR : LIST_SEQ;
+        cmd_str = next_str;
     }
     
     free(input_copy);
-    return first_cmd;
+    return first_list;
+    
+fail:
+    if (pipeline) free_command(pipeline);
+    if (first_list) free_command(first_list);
+    free(input_copy);
+    return NULL;
 }
 
-/* Helper function to expand wildcards in arguments */
-static char **expand_wildcards(char **args, size_t *arg_count) {
-    char **new_args = NULL;
-    size_t new_count = 0;
-    size_t capacity = *arg_count;
+/* Whether an argument lives in the command's glob pool rather than in its
+ * own allocation */
+static int arg_in_pool(const ghost_command *cmd, const char *arg) {
+    return cmd->arg_pool && arg >= cmd->arg_pool && arg < cmd->arg_pool + cmd->arg_pool_size;
+}
 
-    new_args = malloc(capacity * sizeof(char*));
-    if (!new_args) return NULL;
+int command_arg_globbed(const ghost_command *cmd, const char *arg) {
+    return arg_in_pool(cmd, arg);
+}
 
-    for (size_t i = 0; i < *arg_count; i++) {
-        if (strchr(args[i], '*') || strchr(args[i], '?') || strchr(args[i], '[')) {
-            glob_t globbuf;
-            int flags = GLOB_NOCHECK | GLOB_TILDE;
-            
-            if (glob(args[i], flags, NULL, &globbuf) == 0) {
-                // Need more space?
-                if (new_count + globbuf.gl_pathc > capacity) {
-                    capacity = new_count + globbuf.gl_pathc + *arg_count;
-                    char **temp = realloc(new_args, capacity * sizeof(char*));
-                    if (!temp) {
-                        globfree(&globbuf);
-                        for (size_t j = 0; j < new_count; j++) {
-                            free(new_args[j]);
-                        }
-                        free(new_args);
-                        return NULL;
-                    }
-                    new_args = temp;
-                }
+/* Helper function to drop count arguments starting at index */
+static void remove_args(ghost_command *cmd, size_t index, size_t count) {
+    for (size_t i = index; i < index + count; i++) {
+        if (!arg_in_pool(cmd, cmd->args[i])) free(cmd->args[i]);
+    }
+    memmove(&cmd->args[index], &cmd->args[index + count],
+            (cmd->arg_count - index - count) * sizeof(char*));
+    cmd->arg_count -= count;
+    
+    /* Keep the glob range pointing at the same arguments */
+    if (index < cmd->glob_start) {
+        cmd->glob_start -= count;
+        cmd->glob_end -= count;
+    } else if (index < cmd->glob_end) {
+        cmd->glob_end = index + count < cmd->glob_end ? cmd->glob_end - count : index;
+    }
+}
 
-                // Add expanded paths
-                for (size_t j = 0; j < globbuf.gl_pathc; j++) {
-                    new_args[new_count] = strdup(globbuf.gl_pathv[j]);
-                    if (!new_args[new_count]) {
-                        globfree(&globbuf);
-                        for (size_t k = 0; k < new_count; k++) {
-                            free(new_args[k]);
-                        }
-                        free(new_args);
-                        return NULL;
-                    }
-                    new_count++;
-                }
-                globfree(&globbuf);
+/* Helper function to expand wildcards in arguments. All matches are copied
+ * back to back into one pool (cmd->arg_pool) instead of one allocation per
+ * path, and glob_start/glob_end record which arguments came from globbing. */
+static int expand_wildcards(ghost_command *cmd) {
+    size_t count = cmd->arg_count;
+    glob_t *globs = calloc(count, sizeof(glob_t));
+    char *globbed = calloc(count, 1);
+    size_t new_count = 0;
+    size_t pool_size = 0;
+    int any = 0;
+
+    if (!globs || !globbed) {
+        free(globs);
+        free(globbed);
+        return -1;
+    }
+
+    /* First pass: run the globs and size the result */
+    for (size_t i = 0; i < count; i++) {
+        const char *arg = cmd->args[i];
+        if ((strchr(arg, '*') || strchr(arg, '?') || strchr(arg, '[')) &&
+            glob(arg, GLOB_NOCHECK | GLOB_TILDE, NULL, &globs[i]) == 0) {
+            globbed[i] = 1;
+            any = 1;
+            new_count += globs[i].gl_pathc;
+            for (size_t j = 0; j < globs[i].gl_pathc; j++) {
+                pool_size += strlen(globs[i].gl_pathv[j]) + 1;
             }
         } else {
-            // No wildcards, just copy the argument
-            if (new_count >= capacity) {
-                capacity *= 2;
-                char **temp = realloc(new_args, capacity * sizeof(char*));
-                if (!temp) {
-                    for (size_t j = 0; j < new_count; j++) {
-                        free(new_args[j]);
-                    }
-                    free(new_args);
-                    return NULL;
-                }
-                new_args = temp;
-            }
-            new_args[new_count] = strdup(args[i]);
-            if (!new_args[new_count]) {
-                for (size_t j = 0; j < new_count; j++) {
-                    free(new_args[j]);
-                }
-                free(new_args);
-                return NULL;
-            }
             new_count++;
         }
     }
 
-    // Update the argument count
-    *arg_count = new_count;
-    return new_args;
+    /* One extra slot keeps room for the NULL argv terminator */
+    char **new_args = any ? malloc((new_count + 1) * sizeof(char*)) : NULL;
+    char *pool = any ? malloc(pool_size) : NULL;
+    if (!any || !new_args || !pool) {
+        for (size_t i = 0; i < count; i++) {
+            if (globbed[i]) globfree(&globs[i]);
+        }
+        free(new_args);
+        free(pool);
+        free(globs);
+        free(globbed);
+        return any ? -1 : 0;
+    }
+
+    /* Second pass: fill the pool; literal arguments keep their allocation */
+    size_t n = 0, pos = 0;
+    int first_glob = 1;
+    for (size_t i = 0; i < count; i++) {
+        if (!globbed[i]) {
+            new_args[n++] = cmd->args[i];
+            continue;
+        }
+        if (first_glob) {
+            cmd->glob_start = n;
+            first_glob = 0;
+        }
+        for (size_t j = 0; j < globs[i].gl_pathc; j++) {
+            size_t len = strlen(globs[i].gl_pathv[j]) + 1;
+            memcpy(pool + pos, globs[i].gl_pathv[j], len);
+            new_args[n++] = pool + pos;
+            pos += len;
+        }
+        cmd->glob_end = n;
+        globfree(&globs[i]);
+        free(cmd->args[i]);
+    }
+    new_args[n] = NULL;
+
+    free(cmd->args);
+    cmd->args = new_args;
+    cmd->arg_count = n;
+    cmd->arg_pool = pool;
+    cmd->arg_pool_size = pool_size;
+    free(globs);
+    free(globbed);
+    return 0;
 }
 
-static ghost_command *parse_single_command(char *input, char **next_cmd) {
+static ghost_command *parse_single_command(char *input) {
     ghost_command *cmd = calloc(1, sizeof(ghost_command));
     char *expanded_input;
-    char *pipe_pos;
     
     if (!cmd) return NULL;
-    
-    /* Find pipe if it exists */
-    pipe_pos = strchr(input, '|');
-    if (pipe_pos) {
-        *pipe_pos = '\0';
-        *next_cmd = pipe_pos + 1;
-        while (**next_cmd == ' ') (*next_cmd)++;  /* Skip spaces after pipe */
-    } else {
-        *next_cmd = NULL;
-    }
+    cmd->here_doc_fd = -1;
     
     /* Expand environment variables in input */
     expanded_input = expand_env_vars(input);
@@ -249,14 +627,10 @@ static ghost_command *parse_single_command(char *input, char **next_cmd) {
     }
 
     /* Expand wildcards in arguments */
-    char **expanded_args = expand_wildcards(cmd->args, &cmd->arg_count);
-    if (expanded_args) {
-        // Free old arguments
-        for (size_t i = 0; i < cmd->arg_count; i++) {
-            free(cmd->args[i]);
-        }
-        free(cmd->args);
-        cmd->args = expanded_args;
+    if (expand_wildcards(cmd) != 0) {
+        print_error("Memory allocation failed");
+        free_command(cmd);
+        return NULL;
     }
     
     /* First argument is the command name */
@@ -268,45 +642,36 @@ static ghost_command *parse_single_command(char *input, char **next_cmd) {
     
     /* Parse for redirections and background execution */
     for (size_t i = 0; i < cmd->arg_count; i++) {
-        if (strcmp(cmd->args[i], "<<") == 0 && i + 1 < cmd->arg_count) {
-            /* Here document */
-            cmd->here_doc = read_here_doc(cmd->args[i + 1]);
-            if (!cmd->here_doc) {
+        if ((strcmp(cmd->args[i], "<<") == 0 || strcmp(cmd->args[i], "<<<") == 0) &&
+            i + 1 < cmd->arg_count) {
+            /* Here document or here-string */
+            if (cmd->here_doc_fd >= 0) close(cmd->here_doc_fd);
+            cmd->here_doc_fd = cmd->args[i][2] == '<' ? here_string(cmd->args[i + 1])
+                                                      : read_here_doc(cmd->args[i + 1]);
+            if (cmd->here_doc_fd < 0) {
                 free_command(cmd);
                 return NULL;
             }
             /* Remove redirection from args */
-            memmove(&cmd->args[i], &cmd->args[i + 2],
-                    (cmd->arg_count - i - 2) * sizeof(char*));
-            cmd->arg_count -= 2;
+            remove_args(cmd, i, 2);
             i--;
         } else if (strcmp(cmd->args[i], "<") == 0 && i + 1 < cmd->arg_count) {
             /* Input redirection */
             cmd->input_file = strdup(cmd->args[i + 1]);
-            memmove(&cmd->args[i], &cmd->args[i + 2],
-                    (cmd->arg_count - i - 2) * sizeof(char*));
-            cmd->arg_count -= 2;
+            remove_args(cmd, i, 2);
             i--;
         } else if (strcmp(cmd->args[i], ">>") == 0 && i + 1 < cmd->arg_count) {
             /* Append output */
             cmd->output_file = strdup(cmd->args[i + 1]);
             cmd->append_output = 1;
-            memmove(&cmd->args[i], &cmd->args[i + 2],
-                    (cmd->arg_count - i - 2) * sizeof(char*));
-            cmd->arg_count -= 2;
+            remove_args(cmd, i, 2);
             i--;
         } else if (strcmp(cmd->args[i], ">") == 0 && i + 1 < cmd->arg_count) {
             /* Output redirection */
             cmd->output_file = strdup(cmd->args[i + 1]);
             cmd->append_output = 0;
-            memmove(&cmd->args[i], &cmd->args[i + 2],
-                    (cmd->arg_count - i - 2) * sizeof(char*));
-            cmd->arg_count -= 2;
+            remove_args(cmd, i, 2);
             i--;
-        } else if (strcmp(cmd->args[i], "&") == 0) {
-            cmd->background = 1;
-            free(cmd->args[i]);
-            cmd->arg_count--;
         }
     }
     
@@ -316,147 +681,434 @@ static ghost_command *parse_single_command(char *input, char **next_cmd) {
     return cmd;
 }
 
-int execute_command(ghost_command *cmd, shell_context *ctx) {
-    if (!cmd) return 1;
+/* Run a builtin in the shell process with in_fd/out_fd (-1: unchanged) and
+ * the command's own redirections temporarily installed as stdin/stdout */
+static int run_builtin_redirected(ghost_command *cmd, shell_context *ctx, int in_fd, int out_fd) {
+    int redirect_fds[2] = {-1, -1};
+    int saved_fds[2] = {-1, -1};
     
-    /* Handle built-in commands (only for non-piped commands) */
-    if (!cmd->next && is_builtin(cmd->name)) {
+    if (cmd->here_doc_fd >= 0) {
+        lseek(cmd->here_doc_fd, 0, SEEK_SET);
+        in_fd = cmd->here_doc_fd;
+    } else if (cmd->input_file) {
+        redirect_fds[0] = open(cmd->input_file, O_RDONLY | O_CLOEXEC);
+        if (redirect_fds[0] < 0) {
+            fprintf(stderr, "ghost-shell: cannot open %s: %s\n", cmd->input_file, strerror(errno));
+            return 1;
+        }
+        in_fd = redirect_fds[0];
+    }
+    if (cmd->output_file) {
+        int flags = O_WRONLY | O_CREAT | O_CLOEXEC;
+        flags |= cmd->append_output ? O_APPEND : O_TRUNC;
+        redirect_fds[1] = open(cmd->output_file, flags, 0644);
+        if (redirect_fds[1] < 0) {
+            fprintf(stderr, "ghost-shell: cannot open %s: %s\n", cmd->output_file, strerror(errno));
+            if (redirect_fds[0] >= 0) close(redirect_fds[0]);
+            return 1;
+        }
+        out_fd = redirect_fds[1];
+    }
+    
+    /* Nothing to rewire: plain in-process call */
+    if (in_fd < 0 && out_fd < 0) {
         return handle_builtin(cmd, ctx);
     }
     
-    int status = 0;
-    int prev_pipe[2] = {STDIN_FILENO, STDOUT_FILENO};
-    ghost_command *current = cmd;
-    pid_t *pids = NULL;  /* Array to store all process IDs */
-    int pid_count = 0;
+    /* A reader that exits early must not take the shell down with SIGPIPE */
+    struct sigaction ignore, saved_pipe;
+    memset(&ignore, 0, sizeof(ignore));
+    ignore.sa_handler = SIG_IGN;
+    sigemptyset(&ignore.sa_mask);
+    sigaction(SIGPIPE, &ignore, &saved_pipe);
     
-    /* Count number of commands in pipeline */
-    for (ghost_command *c = cmd; c != NULL; c = c->next) {
-        pid_count++;
+    fflush(stdout);
+    if (in_fd >= 0) {
+        saved_fds[0] = fcntl(STDIN_FILENO, F_DUPFD_CLOEXEC, 10);
+        dup2(in_fd, STDIN_FILENO);
+    }
+    if (out_fd >= 0) {
+        saved_fds[1] = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 10);
+        dup2(out_fd, STDOUT_FILENO);
     }
     
-    /* Allocate pid array */
-    pids = malloc(sizeof(pid_t) * pid_count);
-    if (!pids) {
-        perror("ghost-shell: malloc failed");
-        return 1;
+    int status = handle_builtin(cmd, ctx);
+    
+    fflush(stdout);
+    clearerr(stdout);
+    if (saved_fds[0] >= 0) {
+        dup2(saved_fds[0], STDIN_FILENO);
+        close(saved_fds[0]);
+    }
+    if (saved_fds[1] >= 0) {
+        dup2(saved_fds[1], STDOUT_FILENO);
+        close(saved_fds[1]);
     }
+    if (redirect_fds[0] >= 0) close(redirect_fds[0]);
+    if (redirect_fds[1] >= 0) close(redirect_fds[1]);
+    sigaction(SIGPIPE, &saved_pipe, NULL);
+    
+    return status;
+}
+
+/* Start a builtin stage beside the shell, in a new ghost-shell process:
+ * builtins such as parallel start pipelines of their own, and forking the
+ * shell is unsafe once it has threads */
+static pid_t start_builtin(ghost_command *cmd, int in_fd, int out_fd, pid_t pgid, int *status) {
+    char *line = launcher_quote_words(cmd->args, cmd->arg_count);
+    if (!line) {
+        print_error("Memory allocation failed");
+        *status = 1;
+        return -1;
+    }
+    pid_t pid = launch_shell(cmd, line, in_fd, out_fd, pgid, status);
+    free(line);
+    return pid;
+}
+
+/* Start every stage of the pipeline at cmd as part of job j, except inproc
+ * whose stdin/stdout are left in inproc_fds. The first stage reads in_fd and
+ * the last writes out_fd (-1: inherit); both stay owned by the caller.
+ * proc_stage, if given, receives the stage behind each started process.
+ * Returns the launch status of the last stage started. */
+static int launch_stages(ghost_command *cmd, job *j, ghost_command *inproc,
+                         int in_fd, int out_fd, int inproc_fds[2], ghost_command **proc_stage) {
+    sigset_t reaper_mask;
+    jobs_hold_reaper(&reaper_mask);
+    
+    int prev_read = in_fd;  /* Read end of the previous stage's pipe */
+    int launch_status = 0;
+    ghost_command *current = cmd;
     
-    int cmd_index = 0;
     while (current) {
-        int pipe_fds[2] = {STDIN_FILENO, STDOUT_FILENO};
+        int pipe_fds[2] = {-1, out_fd};
         
         /* Create pipe if there's a next command */
         if (current->next) {
             if (pipe(pipe_fds) < 0) {
                 perror("ghost-shell: pipe failed");
-                free(pids);
-                return 1;
+                if (prev_read >= 0 && prev_read != in_fd) close(prev_read);
+                launch_status = 1;
+                break;
             }
+            /* Children only see the ends that are dup'ed onto stdin/stdout */
+            fcntl(pipe_fds[0], F_SETFD, FD_CLOEXEC);
+            fcntl(pipe_fds[1], F_SETFD, FD_CLOEXEC);
         }
         
-        pid_t pid = fork();
-        if (pid == 0) {
-            /* Child process */
-            free(pids);  /* Child doesn't need this */
-            
-            /* Set up input from previous pipe */
-            if (prev_pipe[0] != STDIN_FILENO) {
-                dup2(prev_pipe[0], STDIN_FILENO);
-                close(prev_pipe[0]);
-            }
-            if (prev_pipe[1] != STDOUT_FILENO)
-                close(prev_pipe[1]);
-            
-            /* Set up output to next pipe */
-            if (current->next) {
-                close(pipe_fds[0]);  /* Close read end */
-                dup2(pipe_fds[1], STDOUT_FILENO);
-                close(pipe_fds[1]);
-            }
-            
-            /* Handle input redirection or here-document */
-            if (current->here_doc) {
-                /* Create temporary pipe for here-document */
-                int here_pipe[2];
-                if (pipe(here_pipe) == 0) {
-                    write(here_pipe[1], current->here_doc, strlen(current->here_doc));
-                    close(here_pipe[1]);
-                    dup2(here_pipe[0], STDIN_FILENO);
-                    close(here_pipe[0]);
-                }
-            } else if (current->input_file) {
-                int fd = open(current->input_file, O_RDONLY);
-                if (fd < 0) {
-                    fprintf(stderr, "ghost-shell: cannot open %s: %s\n",
-                            current->input_file, strerror(errno));
-                    exit(1);
-                }
-                dup2(fd, STDIN_FILENO);
-                close(fd);
-            }
-            
-            /* Handle output redirection */
-            if (current->output_file) {
-                int flags = O_WRONLY | O_CREAT;
-                flags |= current->append_output ? O_APPEND : O_TRUNC;
-                
-                int fd = open(current->output_file, flags, 0644);
-                if (fd < 0) {
-                    fprintf(stderr, "ghost-shell: cannot open %s: %s\n",
-                            current->output_file, strerror(errno));
-                    exit(1);
-                }
-                dup2(fd, STDOUT_FILENO);
-                close(fd);
-            }
-            
-            /* Execute the command */
-            if (execvp(current->name, current->args) < 0) {
-                fprintf(stderr, "ghost-shell: %s: command not found\n", current->name);
-                exit(127);
-            }
-            exit(1);  /* Should never reach here */
-        } else if (pid < 0) {
-            perror("ghost-shell: fork failed");
-            free(pids);
-            return 1;
+        launch_status = 0;
+        if (current == inproc) {
+            /* Keep its fds open until it runs */
+            inproc_fds[0] = prev_read;
+            inproc_fds[1] = pipe_fds[1];
+            prev_read = pipe_fds[0];
+            current = current->next;
+            continue;
         }
         
-        /* Parent process */
-        pids[cmd_index++] = pid;
-        
-        /* Close previous pipe fds */
-        if (prev_pipe[0] != STDIN_FILENO)
-            close(prev_pipe[0]);
-        if (prev_pipe[1] != STDOUT_FILENO)
-            close(prev_pipe[1]);
-        
-        /* Set up for next command */
-        if (current->next) {
-            prev_pipe[0] = pipe_fds[0];
-            prev_pipe[1] = pipe_fds[1];
+        pid_t pid;
+        if (is_builtin(current->name)) {
+            pid = start_builtin(current, prev_read, pipe_fds[1], job_pgid(j), &launch_status);
+        } else {
+            pid = launch_command(current, prev_read, pipe_fds[1], job_pgid(j), &launch_status);
+        }
+        if (pid > 0) {
+            size_t before = j->num_procs;
+            job_add_process(j, pid);
+            if (proc_stage && j->num_procs > before) proc_stage[before] = current;
         }
         
+        /* Parent keeps only the read end for the next stage */
+        if (prev_read >= 0 && prev_read != in_fd)
+            close(prev_read);
+        if (current->next)
+            close(pipe_fds[1]);
+        prev_read = pipe_fds[0];
+        
         current = current->next;
     }
     
-    /* Parent waits for all processes unless in background */
+    jobs_release_reaper(&reaper_mask);
+    return launch_status;
+}
+
+job *launch_pipeline(ghost_command *cmd, const char *text, int in_fd, int out_fd, int *status) {
+    int inproc_fds[2] = {-1, -1};
+    
+    job *j = job_create(cmd);
+    if (!j) {
+        perror("ghost-shell: malloc failed");
+        *status = 1;
+        return NULL;
+    }
+    j->keep = 1;
+    
+    if (cmd->next_list) {
+        /* A whole command list runs in a shell of its own */
+        sigset_t reaper_mask;
+        jobs_hold_reaper(&reaper_mask);
+        *status = 0;
+        pid_t pid = launch_shell(NULL, text, in_fd, out_fd, job_pgid(j), status);
+        if (pid > 0) job_add_process(j, pid);
+        jobs_release_reaper(&reaper_mask);
+    } else {
+        *status = launch_stages(cmd, j, NULL, in_fd, out_fd, inproc_fds, NULL);
+    }
+    if (j->num_procs == 0) {
+        job_discard(j);
+        return NULL;
+    }
+    return j;
+}
+
+/* Resource usage of one pipeline stage */
+typedef struct stage_times {
+    const char *name;     /* Command name */
+    pid_t pid;            /* Process ID, 0 for a stage run in the shell */
+    double real;          /* Wall-clock seconds from launch to exit */
+    struct rusage usage;  /* User/system time, max RSS, context switches */
+} stage_times;
+
+static double seconds_between(const struct timespec *from, const struct timespec *to) {
+    return (to->tv_sec - from->tv_sec) + (to->tv_nsec - from->tv_nsec) / 1e9;
+}
+
+static double timeval_seconds(const struct timeval *tv) {
+    return tv->tv_sec + tv->tv_usec / 1e6;
+}
+
+/* ru_maxrss is in kilobytes on Linux and in bytes on macOS */
+static long maxrss_kib(const struct rusage *usage) {
+#ifdef __APPLE__
+    return usage->ru_maxrss / 1024;
+#else
+    return usage->ru_maxrss;
+#endif
+}
+
+/* Helper function to turn shell rusage before/after a builtin into a stage */
+static void builtin_stage_times(stage_times *st, const char *name,
+                                const struct timespec *start, const struct rusage *before) {
+    struct timespec end;
+    struct rusage after;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    getrusage(RUSAGE_SELF, &after);
+    
+    st->name = name;
+    st->pid = 0;
+    st->real = seconds_between(start, &end);
+    st->usage = after;
+    timersub(&after.ru_utime, &before->ru_utime, &st->usage.ru_utime);
+    timersub(&after.ru_stime, &before->ru_stime, &st->usage.ru_stime);
+    st->usage.ru_nvcsw = after.ru_nvcsw - before->ru_nvcsw;
+    st->usage.ru_nivcsw = after.ru_nivcsw - before->ru_nivcsw;
+}
+
+/* Publish a pipeline's timings in GHSH_TIME_* and, for `time`, print a
+ * per-stage breakdown on stderr */
+static void report_times(const stage_times *stages, size_t count, double real, int print) {
+    double user = 0, sys = 0;
+    long maxrss = 0;
+    char value[64];
+    
+    for (size_t i = 0; i < count; i++) {
+        user += timeval_seconds(&stages[i].usage.ru_utime);
+        sys += timeval_seconds(&stages[i].usage.ru_stime);
+        if (maxrss_kib(&stages[i].usage) > maxrss) maxrss = maxrss_kib(&stages[i].usage);
+    }
+    
+    snprintf(value, sizeof(value), "%.3f", real);
+    setenv("GHSH_TIME_REAL", value, 1);
+    snprintf(value, sizeof(value), "%.3f", user);
+    setenv("GHSH_TIME_USER", value, 1);
+    snprintf(value, sizeof(value), "%.3f", sys);
+    setenv("GHSH_TIME_SYS", value, 1);
+    snprintf(value, sizeof(value), "%ld", maxrss);
+    setenv("GHSH_TIME_MAXRSS", value, 1);
+    
+    if (!print) return;
+    
+    fprintf(stderr, "\n%7s  %-16s %9s %9s %9s %10s %7s %7s\n",
+            "PID", "STAGE", "REAL", "USER", "SYS", "MAXRSS", "VCSW", "IVCSW");
+    for (size_t i = 0; i < count; i++) {
+        const stage_times *st = &stages[i];
+        char pid_text[16];
+        if (st->pid > 0) {
+            snprintf(pid_text, sizeof(pid_text), "%d", (int)st->pid);
+        } else {
+            snprintf(pid_text, sizeof(pid_text), "shell");
+        }
+        fprintf(stderr, "%7s  %-16.16s %8.3fs %8.3fs %8.3fs %8ldKi %7ld %7ld\n",
+                pid_text, st->name, st->real,
+                timeval_seconds(&st->usage.ru_utime), timeval_seconds(&st->usage.ru_stime),
+                maxrss_kib(&st->usage), (long)st->usage.ru_nvcsw, (long)st->usage.ru_nivcsw);
+    }
+    fprintf(stderr, "\nreal\t%dm%.3fs\nuser\t%dm%.3fs\nsys\t%dm%.3fs\n",
+            (int)(real / 60), real - 60 * (int)(real / 60),
+            (int)(user / 60), user - 60 * (int)(user / 60),
+            (int)(sys / 60), sys - 60 * (int)(sys / 60));
+}
+
+static int execute_pipeline(ghost_command *cmd, shell_context *ctx) {
+    struct timespec start;
+    struct rusage shell_before;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    
+    /* A lone builtin runs in the shell itself */
+    if (!cmd->next && is_builtin(cmd->name)) {
+        if (!cmd->timed) {
+            return run_builtin_redirected(cmd, ctx, -1, -1);
+        }
+        getrusage(RUSAGE_SELF, &shell_before);
+        int status = run_builtin_redirected(cmd, ctx, -1, -1);
+        stage_times st;
+        builtin_stage_times(&st, cmd->name, &start, &shell_before);
+        report_times(&st, 1, st.real, 1);
+        return status;
+    }
+    
+    /* At most one builtin stage runs in-process: the last stage, or else a
+     * leading producer. It runs after the other stages have started, so
+     * nothing it writes or reads can block on a stage that isn't running yet.
+     * Every other builtin stage is forked but never exec'd. */
+    ghost_command *inproc = NULL;
+    ghost_command *last = cmd;
+    while (last->next) last = last->next;
     if (!cmd->background) {
-        for (int i = 0; i < pid_count; i++) {
-            waitpid(pids[i], &status, 0);
+        if (is_builtin(last->name)) {
+            inproc = last;
+        } else if (is_builtin(cmd->name)) {
+            inproc = cmd;
         }
+    }
+    int inproc_fds[2] = {-1, -1};  /* stdin/stdout reserved for the in-process stage */
+    
+    job *j = job_create(cmd);
+    if (!j) {
+        perror("ghost-shell: malloc failed");
+        return 1;
+    }
+    j->keep = 1;  /* Read its timings once it finishes */
+    
+    /* Pipeline stage behind each started process, for the timing report */
+    size_t num_stages = 0;
+    for (ghost_command *c = cmd; c; c = c->next) num_stages++;
+    ghost_command **proc_stage = calloc(num_stages, sizeof(ghost_command *));
+    
+    int launch_status = launch_stages(cmd, j, inproc, -1, -1, inproc_fds, proc_stage);
+    
+    int inproc_status = 0;
+    stage_times inproc_times;
+    if (inproc) {
+        struct timespec inproc_start;
+        clock_gettime(CLOCK_MONOTONIC, &inproc_start);
+        getrusage(RUSAGE_SELF, &shell_before);
+        
+        /* The other stages own the terminal while the builtin feeds them,
+         * unless the builtin reads the terminal itself: they get it once
+         * it is done, when the pipeline is waited for */
+        int reads_terminal = inproc == cmd && inproc_fds[0] < 0 && inproc->here_doc_fd < 0 &&
+                             !inproc->input_file && isatty(STDIN_FILENO);
+        if (j->num_procs > 0 && !reads_terminal) job_give_terminal(j);
+        inproc_status = run_builtin_redirected(inproc, ctx, inproc_fds[0], inproc_fds[1]);
+        if (inproc_fds[0] >= 0) close(inproc_fds[0]);
+        if (inproc_fds[1] >= 0) close(inproc_fds[1]);
+        if (inproc == last) launch_status = inproc_status;
+        
+        builtin_stage_times(&inproc_times, inproc->name, &inproc_start, &shell_before);
+    }
+    
+    if (j->num_procs == 0) {
+        free(proc_stage);
+        job_discard(j);
+        return launch_status;
+    }
+    
+    /* Background jobs are reaped by the SIGCHLD handler */
+    if (cmd->background) {
+        free(proc_stage);
+        j->keep = 0;
+        job_put_background(j, 0);
+        return 0;
+    }
+    
+    int status = job_wait_foreground(j, 0);
+    
+    if (!job_finished(j)) {
+        /* Stopped: it stays in the job table like any other job */
+        j->keep = 0;
+    } else {
+        struct timespec end;
+        clock_gettime(CLOCK_MONOTONIC, &end);
         
-        /* Return the status of the last command in the pipeline */
-        if (WIFSIGNALED(status)) {
-            fprintf(stderr, "ghost-shell: terminated by signal %d\n", WTERMSIG(status));
-            free(pids);
-            return 128 + WTERMSIG(status);
+        stage_times *stages = proc_stage ? calloc(num_stages, sizeof(stage_times)) : NULL;
+        if (stages) {
+            /* List the stages in pipeline order */
+            size_t count = 0;
+            size_t p = 0;
+            for (ghost_command *c = cmd; c; c = c->next) {
+                if (c == inproc) {
+                    stages[count++] = inproc_times;
+                } else if (p < j->num_procs && proc_stage[p] == c) {
+                    job_process *proc = &j->procs[p++];
+                    stages[count].name = c->name;
+                    stages[count].pid = proc->pid;
+                    stages[count].real = seconds_between(&proc->started, &proc->finished);
+                    stages[count].usage = proc->usage;
+                    count++;
+                }
+            }
+            report_times(stages, count, seconds_between(&start, &end), cmd->timed);
+            free(stages);
         }
+        job_discard(j);
     }
+    free(proc_stage);
     
-    free(pids);
-    return WEXITSTATUS(status);
+    /* A last stage that ran in-process or failed to launch reports its own status */
+    if (inproc == last || launch_status) return launch_status;
+    return status;
+}
+
+/* Helper function to count the commands of a pipeline for fuzzy completion */
+static void record_frecency(ghost_command *cmd) {
+    for (ghost_command *stage = cmd; stage; stage = stage->next) {
+        if (stage->name) frecency_add(FRECENCY_COMMAND, stage->name);
+    }
+}
+
+int execute_command(ghost_command *cmd, shell_context *ctx) {
+    if (!cmd) return 1;
+    
+    int status = 0;
+    while (cmd) {
+        if (cmd->deferred) {
+            ghost_command *pipeline = parse_command(cmd->deferred);
+            if (pipeline) {
+                pipeline->background = cmd->background;
+                record_frecency(pipeline);
+                status = execute_pipeline(pipeline, ctx);
+                free_command(pipeline);
+            } else {
+                status = 2;
+            }
+        } else {
+            record_frecency(cmd);
+            status = execute_pipeline(cmd, ctx);
+        }
+        if (ctx && ctx->exit_flag) break;
+        
+        /* Skip pipelines whose && / || condition does not hold */
+        ghost_list_op op = cmd->list_op;
+        cmd = cmd->next_list;
+        while (cmd && ((op == LIST_AND && status != 0) || (op == LIST_OR && status == 0))) {
+            /* Still parse it so its here-document body is consumed */
+            if (cmd->deferred) free_command(parse_command(cmd->deferred));
+            op = cmd->list_op;
+            cmd = cmd->next_list;
+        }
+    }
+    return status;
 }
 
 void free_command(ghost_command *cmd) {
@@ -465,14 +1117,17 @@ void free_command(ghost_command *cmd) {
     if (cmd->name) free(cmd->name);
     if (cmd->args) {
         for (size_t i = 0; i < cmd->arg_count; i++) {
-            if (cmd->args[i]) free(cmd->args[i]);
+            if (cmd->args[i] && !arg_in_pool(cmd, cmd->args[i])) free(cmd->args[i]);
         }
         free(cmd->args);
     }
+    if (cmd->arg_pool) free(cmd->arg_pool);
     if (cmd->input_file) free(cmd->input_file);
     if (cmd->output_file) free(cmd->output_file);
-    if (cmd->here_doc) free(cmd->here_doc);
+    if (cmd->here_doc_fd >= 0) close(cmd->here_doc_fd);
     if (cmd->next) free_command(cmd->next);
+    if (cmd->next_list) free_command(cmd->next_list);
+    if (cmd->deferred) free(cmd->deferred);
     free(cmd);
 }
 
@@ -499,6 +1154,7 @@ char **split_line(const char *line, size_t *count) {
     
     size_t token_len = 0;
     int in_quotes = 0;
+    int in_single_quotes = 0;
     int escaped = 0;
     
     /* Parse input character by character */
@@ -512,6 +1168,16 @@ char **split_line(const char *line, size_t *count) {
             continue;
         }
         
+        /* Everything between single quotes is literal */
+        if (in_single_quotes) {
+            if (line[i] == '\'') {
+                in_single_quotes = 0;
+            } else {
+                token[token_len++] = line[i];
+            }
+            continue;
+        }
+        
         if (line[i] == '\\') {
             escaped = 1;
             continue;
@@ -522,6 +1188,11 @@ char **split_line(const char *line, size_t *count) {
             continue;
         }
         
+        if (line[i] == '\'' && !in_quotes) {
+            in_single_quotes = 1;
+            continue;
+        }
+        
         if (!in_quotes && isspace(line[i])) {
             if (token_len > 0) {
                 /* End of token */
@@ -626,7 +1297,15 @@ static int is_builtin(const char *cmd) {
             strcmp(cmd, "call") == 0 ||
             strcmp(cmd, "export") == 0 ||
             strcmp(cmd, ".") == 0 ||
-            strcmp(cmd, "source") == 0);
+            strcmp(cmd, "source") == 0 ||
+            strcmp(cmd, "hash") == 0 ||
+            strcmp(cmd, "z") == 0 ||
+            strcmp(cmd, "jobs") == 0 ||
+            strcmp(cmd, "fg") == 0 ||
+            strcmp(cmd, "bg") == 0 ||
+            strcmp(cmd, "wait") == 0 ||
+            strcmp(cmd, "kill") == 0 ||
+            strcmp(cmd, "parallel") == 0);
 }
 
 static int handle_builtin(ghost_command *cmd, shell_context *ctx) {
@@ -644,6 +1323,22 @@ static int handle_builtin(ghost_command *cmd, shell_context *ctx) {
         return builtin_export(cmd, ctx);
     } else if (strcmp(cmd->name, ".") == 0 || strcmp(cmd->name, "source") == 0) {
         return builtin_source(cmd, ctx);
+    } else if (strcmp(cmd->name, "hash") == 0) {
+        return builtin_hash(cmd, ctx);
+    } else if (strcmp(cmd->name, "z") == 0) {
+        return builtin_z(cmd, ctx);
+    } else if (strcmp(cmd->name, "jobs") == 0) {
+        return builtin_jobs(cmd, ctx);
+    } else if (strcmp(cmd->name, "fg") == 0) {
+        return builtin_fg(cmd, ctx);
+    } else if (strcmp(cmd->name, "bg") == 0) {
+        return builtin_bg(cmd, ctx);
+    } else if (strcmp(cmd->name, "wait") == 0) {
+        return builtin_wait(cmd, ctx);
+    } else if (strcmp(cmd->name, "kill") == 0) {
+        return builtin_kill(cmd, ctx);
+    } else if (strcmp(cmd->name, "parallel") == 0) {
+        return builtin_parallel(cmd, ctx);
     }
     return 1;
 }
@@ -0,0 +1,131 @@
+#include "command_index.h"
+#include <stdlib.h>
+#include <string.h>
+
+void command_index_init(command_index *idx) {
+    memset(idx, 0, sizeof(*idx));
+}
+
+void command_index_free(command_index *idx) {
+    for (size_t i = 0; i < idx->num_chunks; i++) {
+        free(idx->chunks[i]);
+    }
+    free(idx->chunks);
+    free(idx->names);
+    memset(idx, 0, sizeof(*idx));
+}
+
+static int compare_names(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+void command_index_sort(char **names, size_t count) {
+    if (count > 1) qsort(names, count, sizeof(char *), compare_names);
+}
+
+/* Helper function to copy a name into the string pool */
+static const char *intern(command_index *idx, const char *name) {
+    size_t len = strlen(name) + 1;
+    if (idx->num_chunks == 0 || idx->chunk_cap - idx->chunk_used < len) {
+        size_t size = len > GHOST_INDEX_CHUNK_SIZE ? len : GHOST_INDEX_CHUNK_SIZE;
+        char **new_chunks = realloc(idx->chunks, (idx->num_chunks + 1) * sizeof(char *));
+        if (!new_chunks) return NULL;
+        idx->chunks = new_chunks;
+        idx->chunks[idx->num_chunks] = malloc(size);
+        if (!idx->chunks[idx->num_chunks]) return NULL;
+        idx->num_chunks++;
+        idx->chunk_used = 0;
+        idx->chunk_cap = size;
+    }
+    char *copy = idx->chunks[idx->num_chunks - 1] + idx->chunk_used;
+    memcpy(copy, name, len);
+    idx->chunk_used += len;
+    return copy;
+}
+
+/* Position of the first name not less than key (compared on len bytes) */
+static size_t lower_bound(const command_index *idx, const char *key, size_t len) {
+    size_t lo = 0, hi = idx->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (strncmp(idx->names[mid], key, len) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/* Helper function to merge sorted names, interning new ones when copy is set */
+static long merge_names(command_index *idx, const char *const *sorted, size_t count, int copy) {
+    if (count == 0) return 0;
+
+    /* Worst case every name is new */
+    size_t need = idx->count + count;
+    const char **merged = malloc(need * sizeof(char *));
+    if (!merged) return -1;
+
+    size_t i = 0, j = 0, n = 0;
+    long added = 0;
+    while (i < idx->count || j < count) {
+        /* Skip repeats within the new names */
+        if (j < count && j > 0 && strcmp(sorted[j], sorted[j - 1]) == 0) {
+            j++;
+            continue;
+        }
+        int cmp = i >= idx->count ? 1 : j >= count ? -1 : strcmp(idx->names[i], sorted[j]);
+        if (cmp < 0) {
+            merged[n++] = idx->names[i++];
+        } else if (cmp == 0) {
+            merged[n++] = idx->names[i++];
+            j++;
+        } else {
+            const char *name = copy ? intern(idx, sorted[j]) : sorted[j];
+            if (!name) {
+                free(merged);
+                return -1;
+            }
+            j++;
+            merged[n++] = name;
+            added++;
+        }
+    }
+
+    free(idx->names);
+    idx->names = merged;
+    idx->count = n;
+    idx->cap = need;
+    return added;
+}
+
+long command_index_merge(command_index *idx, char *const *sorted, size_t count) {
+    return merge_names(idx, (const char *const *)sorted, count, 1);
+}
+
+long command_index_merge_shared(command_index *idx, const char *const *sorted, size_t count) {
+    return merge_names(idx, sorted, count, 0);
+}
+
+size_t command_index_prefix(const command_index *idx, const char *prefix, size_t len, size_t *first) {
+    size_t lo = lower_bound(idx, prefix, len);
+
+    /* Every name in the range compares equal on the first len bytes */
+    size_t a = lo, b = idx->count;
+    while (a < b) {
+        size_t mid = a + (b - a) / 2;
+        if (strncmp(idx->names[mid], prefix, len) == 0) {
+            a = mid + 1;
+        } else {
+            b = mid;
+        }
+    }
+    *first = lo;
+    return a - lo;
+}
+
+int command_index_contains(const command_index *idx, const char *name) {
+    size_t len = strlen(name) + 1;  /* Include the terminator: exact match */
+    size_t pos = lower_bound(idx, name, len);
+    return pos < idx->count && strcmp(idx->names[pos], name) == 0;
+}
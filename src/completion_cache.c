@@ -0,0 +1,242 @@
+#include "completion_cache.h"
+#include <sys/mman.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* File layout: a header, one record per directory, then the strings. Each
+ * record's names are stored sorted, back to back and NUL-terminated, so a
+ * hit only needs pointers into the mapping. The file is in native byte
+ * order; a cache from another machine fails the magic check. */
+#define CACHE_MAGIC "GHSHCMD"
+#define CACHE_VERSION 1
+
+typedef struct cache_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_dirs;
+    uint64_t size;           /* Total file size */
+} cache_header;
+
+typedef struct cache_record {
+    uint64_t dev;
+    uint64_t ino;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint64_t path_offset;    /* NUL-terminated directory path */
+    uint64_t names_offset;   /* Sorted names, each NUL-terminated */
+    uint64_t names_size;
+    uint64_t num_names;
+} cache_record;
+
+struct timespec stat_mtime(const struct stat *st) {
+#ifdef __APPLE__
+    return st->st_mtimespec;
+#else
+    return st->st_mtim;
+#endif
+}
+
+void dir_stamp_from_stat(dir_stamp *stamp, const struct stat *st) {
+    stamp->dev = st->st_dev;
+    stamp->ino = st->st_ino;
+    stamp->mtime = stat_mtime(st);
+}
+
+int completion_cache_path(char *buf, size_t size, const char *name, int create) {
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    int n;
+
+    if (xdg && xdg[0] == '/') {
+        n = snprintf(buf, size, "%s", xdg);
+    } else if (home && *home) {
+        n = snprintf(buf, size, "%s/.cache", home);
+    } else {
+        return -1;
+    }
+    if (n < 0 || (size_t)n >= size) return -1;
+    if (create && mkdir(buf, 0700) != 0 && errno != EEXIST) return -1;
+
+    size_t len = (size_t)n;
+    n = snprintf(buf + len, size - len, "/%s", GHOST_CACHE_DIR);
+    if (n < 0 || (size_t)n >= size - len) return -1;
+    if (create && mkdir(buf, 0700) != 0 && errno != EEXIST) return -1;
+
+    len += (size_t)n;
+    n = snprintf(buf + len, size - len, "/%s", name);
+    if (n < 0 || (size_t)n >= size - len) return -1;
+    return 0;
+}
+
+int completion_cache_load(completion_cache *cache) {
+    cache->map = NULL;
+    cache->size = 0;
+
+    char path[PATH_MAX];
+    if (completion_cache_path(path, sizeof(path), GHOST_COMMAND_CACHE_FILE, 0) != 0) return -1;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(cache_header)) {
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    const cache_header *hdr = map;
+    if (memcmp(hdr->magic, CACHE_MAGIC, sizeof(hdr->magic)) != 0 ||
+        hdr->version != CACHE_VERSION || hdr->size != (uint64_t)st.st_size ||
+        hdr->num_dirs > (hdr->size - sizeof(cache_header)) / sizeof(cache_record)) {
+        munmap(map, (size_t)st.st_size);
+        return -1;
+    }
+
+    cache->map = map;
+    cache->size = (size_t)st.st_size;
+    return 0;
+}
+
+/* Helper function to check that a string lies inside the mapping */
+static const char *cache_string(const completion_cache *cache, uint64_t offset) {
+    if (offset >= cache->size) return NULL;
+    const char *s = (const char *)cache->map + offset;
+    return memchr(s, '\0', cache->size - offset) ? s : NULL;
+}
+
+int completion_cache_lookup(const completion_cache *cache, const char *dir,
+                            const dir_stamp *stamp, command_index *names) {
+    if (!cache->map) return -1;
+
+    const cache_header *hdr = cache->map;
+    const cache_record *records = (const cache_record *)(hdr + 1);
+    for (uint32_t i = 0; i < hdr->num_dirs; i++) {
+        const cache_record *r = &records[i];
+        const char *path = cache_string(cache, r->path_offset);
+        if (!path || strcmp(path, dir) != 0) continue;
+
+        if (r->dev != (uint64_t)stamp->dev || r->ino != (uint64_t)stamp->ino ||
+            r->mtime_sec != (int64_t)stamp->mtime.tv_sec ||
+            r->mtime_nsec != (int64_t)stamp->mtime.tv_nsec) {
+            return -1;  /* Directory changed since it was cached */
+        }
+        if (r->names_offset > cache->size || r->names_size > cache->size - r->names_offset ||
+            r->num_names > r->names_size) {
+            return -1;
+        }
+
+        /* Collect the names, checking they are terminated and in order */
+        const char *p = (const char *)cache->map + r->names_offset;
+        const char *end = p + r->names_size;
+        const char **list = malloc((r->num_names ? r->num_names : 1) * sizeof(char *));
+        if (!list) return -1;
+        size_t n = 0;
+        while (p < end && n < r->num_names) {
+            const char *nul = memchr(p, '\0', (size_t)(end - p));
+            if (!nul || (n > 0 && strcmp(list[n - 1], p) >= 0)) break;
+            list[n++] = p;
+            p = nul + 1;
+        }
+        int ok = n == r->num_names && p == end &&
+                 command_index_merge_shared(names, list, n) >= 0;
+        free(list);
+        return ok ? 0 : -1;
+    }
+    return -1;
+}
+
+/* Helper function to write a whole buffer */
+static int write_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+int completion_cache_save(const completion_cache_dir *dirs, size_t count) {
+    /* Lay the file out in memory first */
+    size_t size = sizeof(cache_header) + count * sizeof(cache_record);
+    for (size_t i = 0; i < count; i++) {
+        size += strlen(dirs[i].path) + 1;
+        for (size_t j = 0; j < dirs[i].names->count; j++) {
+            size += strlen(dirs[i].names->names[j]) + 1;
+        }
+    }
+
+    char *buf = calloc(1, size);
+    if (!buf) return -1;
+
+    cache_header *hdr = (cache_header *)buf;
+    memcpy(hdr->magic, CACHE_MAGIC, sizeof(hdr->magic));
+    hdr->version = CACHE_VERSION;
+    hdr->num_dirs = (uint32_t)count;
+    hdr->size = size;
+
+    cache_record *records = (cache_record *)(hdr + 1);
+    size_t off = sizeof(cache_header) + count * sizeof(cache_record);
+    for (size_t i = 0; i < count; i++) {
+        cache_record *r = &records[i];
+        r->dev = (uint64_t)dirs[i].stamp.dev;
+        r->ino = (uint64_t)dirs[i].stamp.ino;
+        r->mtime_sec = (int64_t)dirs[i].stamp.mtime.tv_sec;
+        r->mtime_nsec = (int64_t)dirs[i].stamp.mtime.tv_nsec;
+
+        size_t len = strlen(dirs[i].path) + 1;
+        r->path_offset = off;
+        memcpy(buf + off, dirs[i].path, len);
+        off += len;
+
+        r->names_offset = off;
+        r->num_names = dirs[i].names->count;
+        for (size_t j = 0; j < dirs[i].names->count; j++) {
+            len = strlen(dirs[i].names->names[j]) + 1;
+            memcpy(buf + off, dirs[i].names->names[j], len);
+            off += len;
+        }
+        r->names_size = off - r->names_offset;
+    }
+
+    int result = completion_cache_write(GHOST_COMMAND_CACHE_FILE, buf, size);
+    free(buf);
+    return result;
+}
+
+int completion_cache_write(const char *name, const char *buf, size_t size) {
+    /* Write a temporary file and rename it over the old one */
+    char path[PATH_MAX], tmp[PATH_MAX];
+    if (completion_cache_path(path, sizeof(path), name, 1) != 0 ||
+        snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", path, (long)getpid()) >= (int)sizeof(tmp)) {
+        return -1;
+    }
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) return -1;
+    int ok = write_all(fd, buf, size) == 0;
+    if (close(fd) != 0) ok = 0;
+    if (ok) ok = rename(tmp, path) == 0;
+    if (!ok) unlink(tmp);
+    return ok ? 0 : -1;
+}
+
+void completion_cache_close(completion_cache *cache) {
+    if (cache->map) {
+        munmap(cache->map, cache->size);
+    }
+    cache->map = NULL;
+    cache->size = 0;
+}
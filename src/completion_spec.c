@@ -0,0 +1,524 @@
+#include "completion_spec.h"
+#include "completion_cache.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Compiled layout: a header, the nodes of the subcommand tree (the root
+ * first), the edges out of them, then the strings. A node's edges are
+ * contiguous and sorted by word, so the words for a prefix are a binary
+ * search away. The header records the source file it was compiled from;
+ * native byte order, like the command cache. */
+#define SPEC_MAGIC "GHSHSPC"
+#define SPEC_VERSION 1
+#define SPEC_NO_CHILD UINT32_MAX
+
+typedef struct spec_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_nodes;
+    uint32_t num_edges;
+    uint32_t strings_size;
+    uint64_t source_dev;
+    uint64_t source_ino;
+    int64_t source_mtime_sec;
+    int64_t source_mtime_nsec;
+    uint64_t source_size;
+    uint64_t size;           /* Total size */
+} spec_header;
+
+typedef struct spec_node {
+    uint32_t first_edge;
+    uint32_t num_edges;
+    uint32_t sources;        /* SPEC_SOURCE_* */
+} spec_node;
+
+typedef struct spec_edge {
+    uint32_t word;           /* Offset into the strings */
+    uint32_t child;          /* Node of the subcommand, or SPEC_NO_CHILD */
+} spec_edge;
+
+struct completion_spec {
+    char *command;
+    const spec_header *hdr;  /* NULL: the command has no spec */
+    const spec_node *nodes;
+    const spec_edge *edges;
+    const char *strings;
+    size_t size;
+    int mapped;              /* hdr is a mapping rather than malloc'd */
+    struct completion_spec *next;
+};
+
+/* Node of a spec being compiled */
+typedef struct build_node {
+    char *path;              /* Subcommand words joined by single spaces */
+    char **words;
+    size_t num_words;
+    size_t cap;
+    unsigned sources;
+} build_node;
+
+typedef struct spec_builder {
+    build_node *nodes;
+    size_t count;
+    size_t cap;
+} spec_builder;
+
+static completion_spec *specs = NULL;
+
+static const struct {
+    const char *name;
+    unsigned flag;
+} source_names[] = {
+    {"@files", SPEC_SOURCE_FILES},
+    {"@dirs", SPEC_SOURCE_DIRS},
+    {"@branches", SPEC_SOURCE_BRANCHES},
+    {"@tags", SPEC_SOURCE_TAGS},
+    {"@remotes", SPEC_SOURCE_REMOTES},
+};
+
+/* Helper function to find a node by path, adding it if asked */
+static build_node *builder_node(spec_builder *b, const char *path, int create) {
+    for (size_t i = 0; i < b->count; i++) {
+        if (strcmp(b->nodes[i].path, path) == 0) return &b->nodes[i];
+    }
+    if (!create) return NULL;
+
+    if (b->count == b->cap) {
+        size_t new_cap = b->cap ? b->cap * 2 : 16;
+        build_node *new_nodes = realloc(b->nodes, new_cap * sizeof(build_node));
+        if (!new_nodes) return NULL;
+        b->nodes = new_nodes;
+        b->cap = new_cap;
+    }
+    build_node *node = &b->nodes[b->count];
+    memset(node, 0, sizeof(*node));
+    node->path = strdup(path);
+    if (!node->path) return NULL;
+    b->count++;
+    return node;
+}
+
+static int add_word(build_node *node, const char *word, size_t len) {
+    if (node->num_words == node->cap) {
+        size_t new_cap = node->cap ? node->cap * 2 : 16;
+        char **new_words = realloc(node->words, new_cap * sizeof(char *));
+        if (!new_words) return -1;
+        node->words = new_words;
+        node->cap = new_cap;
+    }
+    char *copy = strndup(word, len);
+    if (!copy) return -1;
+    node->words[node->num_words++] = copy;
+    return 0;
+}
+
+/* Helper function to add the node for path along with the nodes above it,
+ * each listing the next subcommand as a word */
+static build_node *builder_path(spec_builder *b, const char *path) {
+    build_node *node = builder_node(b, path, 0);
+    if (node) return node;
+
+    const char *space = strrchr(path, ' ');
+    char *parent_path = strndup(path, space ? (size_t)(space - path) : 0);
+    if (!parent_path) return NULL;
+    build_node *parent = builder_path(b, parent_path);
+    free(parent_path);
+    if (!parent) return NULL;
+
+    const char *word = space ? space + 1 : path;
+    if (add_word(parent, word, strlen(word)) != 0) return NULL;
+    return builder_node(b, path, 1);
+}
+
+static void builder_free(spec_builder *b) {
+    for (size_t i = 0; i < b->count; i++) {
+        for (size_t j = 0; j < b->nodes[i].num_words; j++) {
+            free(b->nodes[i].words[j]);
+        }
+        free(b->nodes[i].words);
+        free(b->nodes[i].path);
+    }
+    free(b->nodes);
+}
+
+static int compare_words(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* Helper function to parse one line of a spec into the builder. Returns an
+ * error message, or NULL. */
+static const char *parse_line(spec_builder *b, char *line) {
+    /* Comments run from a '#' at the start of a word */
+    for (char *p = line; *p; p++) {
+        if (*p == '#' && (p == line || isspace((unsigned char)p[-1]))) {
+            *p = '\0';
+            break;
+        }
+    }
+    char *p = line;
+    while (isspace((unsigned char)*p)) p++;
+    if (!*p) return NULL;
+
+    char *colon = strchr(p, ':');
+    if (!colon) return "expected 'subcommands: words'";
+    *colon = '\0';
+
+    /* Normalize the path to words joined by single spaces */
+    char path[1024];
+    size_t len = 0;
+    for (char *tok = strtok(p, " \t"); tok; tok = strtok(NULL, " \t")) {
+        int n = snprintf(path + len, sizeof(path) - len, "%s%s", len ? " " : "", tok);
+        if (n < 0 || (size_t)n >= sizeof(path) - len) return "subcommand path too long";
+        len += (size_t)n;
+    }
+    path[len] = '\0';
+
+    build_node *node = builder_path(b, path);
+    if (!node) return "out of memory";
+
+    for (char *tok = strtok(colon + 1, " \t\r"); tok; tok = strtok(NULL, " \t\r")) {
+        if (tok[0] == '@') {
+            size_t i;
+            for (i = 0; i < sizeof(source_names) / sizeof(source_names[0]); i++) {
+                if (strcmp(tok, source_names[i].name) == 0) break;
+            }
+            if (i == sizeof(source_names) / sizeof(source_names[0])) return "unknown argument source";
+            node->sources |= source_names[i].flag;
+        } else if (add_word(node, tok, strlen(tok)) != 0) {
+            return "out of memory";
+        }
+    }
+    return NULL;
+}
+
+/* Helper function to compile spec text into the binary layout. Lines that
+ * cannot be parsed are reported and skipped. Returns a malloc'd buffer. */
+static char *compile_spec(const char *source, char *text, size_t *size) {
+    spec_builder b = {0};
+    if (!builder_node(&b, "", 1)) return NULL;
+
+    int line_no = 0;
+    for (char *line = text; line; ) {
+        char *next = strchr(line, '\n');
+        if (next) *next++ = '\0';
+        line_no++;
+        const char *error = parse_line(&b, line);
+        if (error) {
+            fprintf(stderr, "\nghost-shell: %s:%d: %s\n", source, line_no, error);
+        }
+        line = next;
+    }
+
+    /* Sort and deduplicate each node's words, then size the layout */
+    size_t num_edges = 0, strings_size = 1;
+    for (size_t i = 0; i < b.count; i++) {
+        build_node *node = &b.nodes[i];
+        if (node->num_words > 1) qsort(node->words, node->num_words, sizeof(char *), compare_words);
+        size_t n = 0;
+        for (size_t j = 0; j < node->num_words; j++) {
+            if (n > 0 && strcmp(node->words[n - 1], node->words[j]) == 0) {
+                free(node->words[j]);
+                continue;
+            }
+            node->words[n++] = node->words[j];
+            strings_size += strlen(node->words[j]) + 1;
+        }
+        node->num_words = n;
+        num_edges += n;
+    }
+
+    *size = sizeof(spec_header) + b.count * sizeof(spec_node) + num_edges * sizeof(spec_edge) + strings_size;
+    char *buf = calloc(1, *size);
+    if (!buf || *size > UINT32_MAX) {
+        free(buf);
+        builder_free(&b);
+        return NULL;
+    }
+
+    spec_header *hdr = (spec_header *)buf;
+    memcpy(hdr->magic, SPEC_MAGIC, sizeof(hdr->magic));
+    hdr->version = SPEC_VERSION;
+    hdr->num_nodes = (uint32_t)b.count;
+    hdr->num_edges = (uint32_t)num_edges;
+    hdr->strings_size = (uint32_t)strings_size;
+    hdr->size = *size;
+
+    spec_node *nodes = (spec_node *)(hdr + 1);
+    spec_edge *edges = (spec_edge *)(nodes + b.count);
+    char *strings = (char *)(edges + num_edges);
+    size_t edge = 0, off = 1;  /* Offset 0 is the empty string */
+
+    for (size_t i = 0; i < b.count; i++) {
+        const build_node *node = &b.nodes[i];
+        nodes[i].first_edge = (uint32_t)edge;
+        nodes[i].num_edges = (uint32_t)node->num_words;
+        nodes[i].sources = node->sources;
+
+        for (size_t j = 0; j < node->num_words; j++, edge++) {
+            const char *word = node->words[j];
+            size_t len = strlen(word) + 1;
+            memcpy(strings + off, word, len);
+            edges[edge].word = (uint32_t)off;
+            off += len;
+
+            /* A word with its own line is a subcommand */
+            char child_path[1024];
+            edges[edge].child = SPEC_NO_CHILD;
+            int n = snprintf(child_path, sizeof(child_path), "%s%s%s", node->path,
+                             node->path[0] ? " " : "", word);
+            if (n > 0 && (size_t)n < sizeof(child_path)) {
+                for (size_t k = 0; k < b.count; k++) {
+                    if (strcmp(b.nodes[k].path, child_path) == 0) {
+                        edges[edge].child = (uint32_t)k;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    builder_free(&b);
+    return buf;
+}
+
+/* Helper function to check a compiled spec's header and table sizes;
+ * offsets within it are checked as they are followed */
+static int spec_valid(const spec_header *hdr, size_t size) {
+    if (size < sizeof(spec_header) || memcmp(hdr->magic, SPEC_MAGIC, sizeof(hdr->magic)) != 0 ||
+        hdr->version != SPEC_VERSION || hdr->size != size || hdr->num_nodes == 0 ||
+        hdr->strings_size == 0) {
+        return 0;
+    }
+    uint64_t need = sizeof(spec_header) + (uint64_t)hdr->num_nodes * sizeof(spec_node) +
+                    (uint64_t)hdr->num_edges * sizeof(spec_edge) + hdr->strings_size;
+    return need == size && ((const char *)hdr)[size - 1] == '\0';
+}
+
+static int source_matches(const spec_header *hdr, const struct stat *st) {
+    struct timespec mtime = stat_mtime(st);
+    return hdr->source_dev == (uint64_t)st->st_dev && hdr->source_ino == (uint64_t)st->st_ino &&
+           hdr->source_mtime_sec == (int64_t)mtime.tv_sec &&
+           hdr->source_mtime_nsec == (int64_t)mtime.tv_nsec &&
+           hdr->source_size == (uint64_t)st->st_size;
+}
+
+static void set_layout(completion_spec *spec, const void *data, size_t size, int mapped) {
+    spec->hdr = data;
+    spec->size = size;
+    spec->mapped = mapped;
+    spec->nodes = (const spec_node *)(spec->hdr + 1);
+    spec->edges = (const spec_edge *)(spec->nodes + spec->hdr->num_nodes);
+    spec->strings = (const char *)(spec->edges + spec->hdr->num_edges);
+}
+
+/* Helper function to map the compiled spec in the cache if it was compiled
+ * from the current source */
+static int map_compiled(completion_spec *spec, const char *name, const struct stat *source) {
+    char path[PATH_MAX];
+    if (completion_cache_path(path, sizeof(path), name, 0) != 0) return -1;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(spec_header)) {
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    if (!spec_valid(map, (size_t)st.st_size) || !source_matches(map, source)) {
+        munmap(map, (size_t)st.st_size);
+        return -1;
+    }
+    set_layout(spec, map, (size_t)st.st_size, 1);
+    return 0;
+}
+
+/* Helper function to compile the source and save the result in the cache */
+static int compile_source(completion_spec *spec, const char *name, const char *path, const struct stat *st) {
+    if (st->st_size > GHOST_SPEC_MAX_SIZE) return -1;
+
+    FILE *fp = fopen(path, "r");
+    if (!fp) return -1;
+    char *text = malloc((size_t)st->st_size + 1);
+    size_t len = text ? fread(text, 1, (size_t)st->st_size, fp) : 0;
+    fclose(fp);
+    if (!text) return -1;
+    text[len] = '\0';
+
+    size_t size;
+    char *buf = compile_spec(path, text, &size);
+    free(text);
+    if (!buf) return -1;
+
+    spec_header *hdr = (spec_header *)buf;
+    hdr->source_dev = (uint64_t)st->st_dev;
+    hdr->source_ino = (uint64_t)st->st_ino;
+    struct timespec mtime = stat_mtime(st);
+    hdr->source_mtime_sec = (int64_t)mtime.tv_sec;
+    hdr->source_mtime_nsec = (int64_t)mtime.tv_nsec;
+    hdr->source_size = (uint64_t)st->st_size;
+
+    /* Keep using the compiled copy in memory even if it cannot be saved */
+    completion_cache_write(name, buf, size);
+    set_layout(spec, buf, size, 0);
+    return 0;
+}
+
+/* Helper function to find the source of command's spec in the search path */
+static int find_source(const char *command, char *path, size_t size, struct stat *st) {
+    char dirs[PATH_MAX * 2];
+    const char *env = getenv("GHSH_SPEC_PATH");
+    const char *config = getenv("XDG_CONFIG_HOME");
+    const char *home = getenv("HOME");
+
+    if (env && *env) {
+        snprintf(dirs, sizeof(dirs), "%s", env);
+    } else if (config && config[0] == '/') {
+        snprintf(dirs, sizeof(dirs), "%s/ghsh/completions:%s", config, GHOST_SPEC_DIR);
+    } else if (home && *home) {
+        snprintf(dirs, sizeof(dirs), "%s/.config/ghsh/completions:%s", home, GHOST_SPEC_DIR);
+    } else {
+        snprintf(dirs, sizeof(dirs), "%s", GHOST_SPEC_DIR);
+    }
+
+    char *save;
+    for (char *dir = strtok_r(dirs, ":", &save); dir; dir = strtok_r(NULL, ":", &save)) {
+        int n = snprintf(path, size, "%s/%s%s", dir, command, GHOST_SPEC_SUFFIX);
+        if (n < 0 || (size_t)n >= size) continue;
+        if (stat(path, st) == 0 && S_ISREG(st->st_mode)) return 0;
+    }
+    return -1;
+}
+
+const completion_spec *completion_spec_find(const char *command) {
+    for (completion_spec *spec = specs; spec; spec = spec->next) {
+        if (strcmp(spec->command, command) == 0) return spec->hdr ? spec : NULL;
+    }
+
+    /* Remember the outcome, found or not, for the rest of the session */
+    completion_spec *spec = calloc(1, sizeof(completion_spec));
+    if (!spec) return NULL;
+    spec->command = strdup(command);
+    if (!spec->command) {
+        free(spec);
+        return NULL;
+    }
+    spec->next = specs;
+    specs = spec;
+
+    if (!command[0] || command[0] == '.' || strchr(command, '/') || strlen(command) > NAME_MAX - 8) {
+        return NULL;
+    }
+
+    char path[PATH_MAX], name[NAME_MAX + 1];
+    struct stat st;
+    snprintf(name, sizeof(name), "spec-%s", command);
+    if (find_source(command, path, sizeof(path), &st) != 0) return NULL;
+    if (map_compiled(spec, name, &st) != 0 && compile_source(spec, name, path, &st) != 0) return NULL;
+    return spec;
+}
+
+/* Helper function to get a node's edges, or NULL if they are out of range */
+static const spec_edge *node_edges(const completion_spec *spec, uint32_t node, uint32_t *count) {
+    if (node >= spec->hdr->num_nodes) return NULL;
+    const spec_node *n = &spec->nodes[node];
+    if (n->first_edge > spec->hdr->num_edges || n->num_edges > spec->hdr->num_edges - n->first_edge) {
+        return NULL;
+    }
+    *count = n->num_edges;
+    return spec->edges + n->first_edge;
+}
+
+static const char *edge_word(const completion_spec *spec, const spec_edge *edge) {
+    return edge->word < spec->hdr->strings_size ? spec->strings + edge->word : "";
+}
+
+uint32_t completion_spec_walk(const completion_spec *spec, const char *const *words, size_t count) {
+    uint32_t node = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (words[i][0] == '-') continue;
+
+        uint32_t num_edges;
+        const spec_edge *edges = node_edges(spec, node, &num_edges);
+        if (!edges) return node;
+
+        /* Binary search for the word */
+        uint32_t lo = 0, hi = num_edges;
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            int cmp = strcmp(edge_word(spec, &edges[mid]), words[i]);
+            if (cmp == 0) {
+                if (edges[mid].child < spec->hdr->num_nodes) node = edges[mid].child;
+                break;
+            }
+            if (cmp < 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+    }
+    return node;
+}
+
+size_t completion_spec_words(const completion_spec *spec, uint32_t node, const char *prefix,
+                             const char ***words) {
+    *words = NULL;
+    uint32_t num_edges;
+    const spec_edge *edges = node_edges(spec, node, &num_edges);
+    if (!edges) return 0;
+
+    /* First word not less than the prefix */
+    size_t len = strlen(prefix);
+    uint32_t lo = 0, hi = num_edges;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (strncmp(edge_word(spec, &edges[mid]), prefix, len) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    size_t count = 0;
+    for (uint32_t i = lo; i < num_edges && strncmp(edge_word(spec, &edges[i]), prefix, len) == 0; i++) {
+        const char *word = edge_word(spec, &edges[i]);
+        if (word[0] == '-' && prefix[0] != '-') continue;
+        if (count == 0) {
+            *words = malloc((num_edges - i) * sizeof(char *));
+            if (!*words) return 0;
+        }
+        (*words)[count++] = word;
+    }
+    return count;
+}
+
+unsigned completion_spec_sources(const completion_spec *spec, uint32_t node) {
+    return node < spec->hdr->num_nodes ? spec->nodes[node].sources : 0;
+}
+
+void completion_spec_cleanup(void) {
+    while (specs) {
+        completion_spec *next = specs->next;
+        if (specs->hdr) {
+            if (specs->mapped) {
+                munmap((void *)specs->hdr, specs->size);
+            } else {
+                free((void *)specs->hdr);
+            }
+        }
+        free(specs->command);
+        free(specs);
+        specs = next;
+    }
+}
@@ -1,5 +1,15 @@
 #include "completions.h"
 #include "ghost_shell.h"
+#include "command_index.h"
+#include "completion_cache.h"
+#include "dir_listing.h"
+#include "fuzzy.h"
+#include "frecency.h"
+#include "dir_jump.h"
+#include "fs_worker.h"
+#include "completion_spec.h"
+#include "git_refs.h"
+#include "bk_tree.h"
 #include <sys/stat.h>
 #include <limits.h>
 #include <libgen.h>
@@ -9,13 +19,79 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <errno.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
 
-/* Completion state */
-static char **commands = NULL;
-static size_t num_commands = 0;
+/* Completion state. Between updates the index is read without the lock:
+ * it only grows while PATH is being indexed, and inotify changes are
+ * applied by the main thread once indexing is complete (the directories
+ * are listed again on a filesystem worker). The names point
+ * into the per-directory lists below and the builtin table. */
+static command_index commands;
 
-/* Helper function to format completions in columns */
-static void print_completions_columns(char **items, size_t count) {
+/* Edit-distance index of the commands for "did you mean" suggestions,
+ * built from the index on first use and dropped when the index changes */
+static bk_tree command_tree;
+
+/* Built-in commands, sorted at startup */
+static const char *builtin_names[] = {"cd", "exit", "help", "history", "call", "export", "source", ".",
+                                      "hash", "jobs", "fg", "bg", "wait", "kill", "parallel", "z"};
+#define NUM_BUILTIN_NAMES (sizeof(builtin_names) / sizeof(builtin_names[0]))
+
+/* PATH directory scanned by the background indexer */
+typedef struct index_dir {
+    char *path;
+    int claimed;          /* Some thread has started scanning it */
+    int done;             /* Its commands are in the index */
+    int stale;            /* Changed since it was indexed */
+    int wd;               /* inotify watch, -1 if none */
+    int stamped;          /* The directory exists and stamp identifies it */
+    dir_stamp stamp;      /* Identity when it was listed */
+    command_index names;  /* Its commands (interned, or in the cache mapping) */
+} index_dir;
+
+/* Background PATH index state, protected by index_lock */
+static index_dir *index_dirs = NULL;
+static size_t num_index_dirs = 0;
+static size_t next_index_dir = 0;
+static size_t index_dirs_done = 0;
+static size_t index_dirs_cached = 0;
+static int index_stop = 0;
+static int cache_dirty = 0;
+static pthread_mutex_t index_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t index_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t index_thread;
+static int index_thread_running = 0;
+static int index_thread_exited = 0;
+static int index_workers_active = 0;  /* Threads inside index_work or a rescan */
+static struct timespec index_started;
+static double index_elapsed_ms = -1;
+
+/* On-disk listing cache and the watch on PATH */
+static completion_cache cache;
+static int inotify_fd = -1;
+
+#ifdef __linux__
+#define INDEX_WATCH_MASK (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB | \
+                          IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+#endif
+
+/* Helper function to read one key while a completion function runs.
+ * Returns 0 at end of input. */
+static char read_key(EditLine *edit_line) {
+    char key;
+    return el_getc(edit_line, &key) == 1 ? key : 0;
+}
+
+/* Helper function to format completions in columns. Output longer than the
+ * terminal is paged: space shows the next page, return the next line, and
+ * any other key stops. */
+static void print_completions_columns(EditLine *edit_line, const char *const *items, size_t count) {
     if (!items || count == 0) return;
     
     /* Find the maximum width of completions */
@@ -28,182 +104,882 @@ static void print_completions_columns(char **items, size_t count) {
     /* Add padding between columns */
     max_width += 2;
     
-    /* Get terminal width */
+    /* Get terminal size */
     struct winsize ws;
-    ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws);
-    int term_width = ws.ws_col;
+    size_t term_width = 80, term_height = 24;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0) {
+        term_width = ws.ws_col;
+        if (ws.ws_row > 1) term_height = ws.ws_row;
+    }
     
     /* Calculate number of columns */
-    int num_cols = term_width / max_width;
+    size_t num_cols = term_width / max_width;
     if (num_cols == 0) num_cols = 1;
     
     /* Calculate number of rows */
-    int num_rows = (count + num_cols - 1) / num_cols;
+    size_t num_rows = (count + num_cols - 1) / num_cols;
     
     printf("\n");
-    /* Print completions in columns */
-    for (int row = 0; row < num_rows; row++) {
-        for (int col = 0; col < num_cols; col++) {
-            int index = col * num_rows + row;
-            if ((size_t)index < count) {
+    /* Print completions in columns, a page at a time */
+    size_t lines_left = term_height - 1;
+    for (size_t row = 0; row < num_rows; row++) {
+        if (lines_left == 0) {
+            printf("--More--");
+            fflush(stdout);
+            char key = read_key(edit_line);
+            printf("\r\033[K");
+            if (key == ' ') {
+                lines_left = term_height - 1;
+            } else if (key == '\r' || key == '\n') {
+                lines_left = 1;
+            } else {
+                break;
+            }
+        }
+        for (size_t col = 0; col < num_cols; col++) {
+            size_t index = col * num_rows + row;
+            if (index < count) {
                 printf("%-*s", (int)max_width, items[index]);
             }
         }
         printf("\n");
+        lines_left--;
     }
+    fflush(stdout);
 }
 
-/* Initialize command list for completion */
-void completions_init(void) {
-    /* Add built-in commands */
-    const char *builtins[] = {"cd", "exit", "help", "history", "call", "export", "source", "."};
-    for (size_t i = 0; i < sizeof(builtins) / sizeof(builtins[0]); i++) {
-        char **new_commands = realloc(commands, (num_commands + 1) * sizeof(char*));
-        if (new_commands) {
-            commands = new_commands;
-            commands[num_commands++] = strdup(builtins[i]);
+/* Helper function to ask before listing a large number of matches */
+static int confirm_completions(EditLine *edit_line, size_t count) {
+    if (count <= GHOST_COMPLETION_QUERY_ITEMS) return 1;
+
+    printf("\nDisplay all %zu possibilities? (y or n)", count);
+    fflush(stdout);
+    char key = read_key(edit_line);
+    if (key == 'y' || key == 'Y' || key == ' ') return 1;
+    printf("\n");
+    return 0;
+}
+
+static double ms_since(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1e3 + (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+/* Helper function to add the executables of one PATH directory to names */
+static void index_scan_dir(const char *dir, command_index *names) {
+    char **found = NULL;
+    size_t count = 0, cap = 0;
+
+    DIR *d = opendir(dir);
+    if (!d) return;
+
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL) {
+        if (entry->d_type == DT_REG || entry->d_type == DT_LNK) {
+            char full_path[PATH_MAX];
+            snprintf(full_path, sizeof(full_path), "%s/%s", dir, entry->d_name);
+            if (access(full_path, X_OK) == 0) {
+                if (count == cap) {
+                    size_t new_cap = cap ? cap * 2 : 64;
+                    char **new_found = realloc(found, new_cap * sizeof(char*));
+                    if (!new_found) break;
+                    found = new_found;
+                    cap = new_cap;
+                }
+                found[count] = strdup(entry->d_name);
+                if (found[count]) count++;
+            }
+        }
+    }
+    closedir(d);
+
+    command_index_sort(found, count);
+    command_index_merge(names, found, count);
+    for (size_t i = 0; i < count; i++) free(found[i]);
+    free(found);
+}
+
+/* Helper function to (re)list a PATH directory into dir->names, from the
+ * cache when its stamp is unchanged. Runs without the lock.
+ * Returns 1 if the listing came from the cache. */
+static int index_load_dir(index_dir *dir) {
+#ifdef __linux__
+    /* Watch before listing, so no change can slip in between */
+    if (inotify_fd >= 0) {
+        dir->wd = inotify_add_watch(inotify_fd, dir->path, INDEX_WATCH_MASK);
+    }
+#endif
+
+    command_index_init(&dir->names);
+    struct stat st;
+    dir->stamped = stat(dir->path, &st) == 0 && S_ISDIR(st.st_mode);
+    if (!dir->stamped) return 0;
+
+    dir_stamp_from_stat(&dir->stamp, &st);
+    if (completion_cache_lookup(&cache, dir->path, &dir->stamp, &dir->names) == 0) {
+        return 1;
+    }
+    index_scan_dir(dir->path, &dir->names);
+    return 0;
+}
+
+/* Helper function to merge a listed directory into the command index */
+static void index_publish(index_dir *dir, int from_cache) {
+    pthread_mutex_lock(&index_lock);
+    command_index_merge_shared(&commands, dir->names.names, dir->names.count);
+    if (from_cache) {
+        index_dirs_cached++;
+    } else if (dir->stamped) {
+        cache_dirty = 1;
+    }
+
+    dir->done = 1;
+    if (++index_dirs_done == num_index_dirs) {
+        index_elapsed_ms = ms_since(&index_started);
+    }
+    pthread_cond_broadcast(&index_cond);
+    pthread_mutex_unlock(&index_lock);
+}
+
+/* Helper function to scan unclaimed directories until none are left.
+ * Called by the indexer thread, and by filesystem workers when a PATH
+ * directory holds it up. */
+static void index_work(void) {
+    pthread_mutex_lock(&index_lock);
+    index_workers_active++;
+    pthread_mutex_unlock(&index_lock);
+
+    for (;;) {
+        pthread_mutex_lock(&index_lock);
+        if (index_stop || next_index_dir >= num_index_dirs) {
+            index_workers_active--;
+            pthread_cond_broadcast(&index_cond);
+            pthread_mutex_unlock(&index_lock);
+            return;
+        }
+        index_dir *dir = &index_dirs[next_index_dir++];
+        dir->claimed = 1;
+        pthread_mutex_unlock(&index_lock);
+
+        int from_cache = index_load_dir(dir);
+        index_publish(dir, from_cache);
+    }
+}
+
+/* Helper function to write the listings to the cache file. Called with
+ * index_lock held (or once the indexer thread is gone). */
+static void index_save_cache(void) {
+    completion_cache_dir *dirs = malloc((num_index_dirs ? num_index_dirs : 1) * sizeof(completion_cache_dir));
+    if (!dirs) return;
+
+    size_t n = 0;
+    for (size_t i = 0; i < num_index_dirs; i++) {
+        if (!index_dirs[i].done || !index_dirs[i].stamped) continue;
+        dirs[n].path = index_dirs[i].path;
+        dirs[n].stamp = index_dirs[i].stamp;
+        dirs[n].names = &index_dirs[i].names;
+        n++;
+    }
+    if (completion_cache_save(dirs, n) == 0) {
+        cache_dirty = 0;
+    }
+    free(dirs);
+}
+
+static void *index_thread_main(void *arg) {
+    (void)arg;
+    index_work();
+
+    /* Once every directory is in, store what had to be scanned */
+    pthread_mutex_lock(&index_lock);
+    while (!index_stop && index_dirs_done < num_index_dirs) {
+        pthread_cond_wait(&index_cond, &index_lock);
+    }
+    if (!index_stop && cache_dirty) {
+        index_save_cache();
+    }
+    index_thread_exited = 1;
+    pthread_cond_broadcast(&index_cond);
+    pthread_mutex_unlock(&index_lock);
+    return NULL;
+}
+
+/* Helper function for a filesystem worker to take over unclaimed
+ * directories while another one hangs */
+static void index_help(void *unused) {
+    (void)unused;
+    index_work();
+}
+
+/* Helper function to wait on index_cond until the deadline (0: forever).
+ * Returns 0 once the deadline has passed. Called with index_lock held. */
+static int index_wait(const struct timespec *deadline, long ms) {
+    if (ms == 0) {
+        pthread_cond_wait(&index_cond, &index_lock);
+        return 1;
+    }
+    return pthread_cond_timedwait(&index_cond, &index_lock, deadline) != ETIMEDOUT;
+}
+
+/* Helper function to compute a deadline for index_wait */
+static void index_deadline(struct timespec *deadline, long ms) {
+    clock_gettime(CLOCK_REALTIME, deadline);
+    deadline->tv_sec += ms / 1000;
+    deadline->tv_nsec += (ms % 1000) * 1000000L;
+    if (deadline->tv_nsec >= 1000000000L) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000L;
+    }
+}
+
+/* PATH directories being listed again after inotify reported a change.
+ * The worker lists copies; the main thread puts them in the index. */
+typedef struct rescan_task {
+    size_t count;
+    index_dir *dirs;  /* Copies: path, then the new listing */
+    size_t *slots;    /* Where each one goes in index_dirs */
+} rescan_task;
+
+/* Rescan that missed its deadline, and its arg */
+static fs_task *pending_rescan = NULL;
+static rescan_task *pending_rescan_arg = NULL;
+
+static void free_rescan_task(void *arg) {
+    rescan_task *t = arg;
+    for (size_t i = 0; i < t->count; i++) {
+        free(t->dirs[i].path);
+        command_index_free(&t->dirs[i].names);
+    }
+    free(t->dirs);
+    free(t->slots);
+    free(t);
+}
+
+/* Helper function to list the changed directories, on a filesystem worker.
+ * Counted in index_workers_active so cleanup waits for it. */
+static void run_rescan_task(void *arg) {
+    rescan_task *t = arg;
+    for (size_t i = 0; i < t->count; i++) {
+        index_load_dir(&t->dirs[i]);
+    }
+    pthread_mutex_lock(&index_lock);
+    index_workers_active--;
+    pthread_cond_broadcast(&index_cond);
+    pthread_mutex_unlock(&index_lock);
+}
+
+/* Helper function to put a finished rescan in the index: the new listings
+ * replace the old ones and the index is rebuilt from the per-directory
+ * lists. Runs on the main thread. */
+static void index_apply_rescan(rescan_task *t) {
+    pthread_mutex_lock(&index_lock);
+
+    /* Keep the old lists alive until nothing in the index points at them */
+    command_index *old_lists = malloc((t->count ? t->count : 1) * sizeof(command_index));
+    if (!old_lists) {
+        pthread_mutex_unlock(&index_lock);
+        return;
+    }
+    for (size_t i = 0; i < t->count; i++) {
+        index_dir *dir = &index_dirs[t->slots[i]];
+        old_lists[i] = dir->names;
+        dir->names = t->dirs[i].names;
+        dir->wd = t->dirs[i].wd;
+        dir->stamped = t->dirs[i].stamped;
+        dir->stamp = t->dirs[i].stamp;
+        command_index_init(&t->dirs[i].names);
+    }
+
+    command_index rebuilt;
+    command_index_init(&rebuilt);
+    command_index_merge_shared(&rebuilt, builtin_names, NUM_BUILTIN_NAMES);
+    for (size_t i = 0; i < num_index_dirs; i++) {
+        command_index_merge_shared(&rebuilt, index_dirs[i].names.names, index_dirs[i].names.count);
+    }
+    command_index_free(&commands);
+    commands = rebuilt;
+    cache_dirty = 1;
+    bk_tree_free(&command_tree);
+
+    for (size_t i = 0; i < t->count; i++) {
+        command_index_free(&old_lists[i]);
+    }
+    free(old_lists);
+    pthread_mutex_unlock(&index_lock);
+}
+
+/* Helper function to apply PATH changes reported by inotify. Only runs on
+ * the main thread after indexing is complete. Changed directories are
+ * listed again on a filesystem worker within the deadline; a rescan still
+ * going past it is put in the index by a later call, and the old listings
+ * are used meanwhile. */
+static void index_refresh(void) {
+#ifdef __linux__
+    if (inotify_fd < 0) return;
+
+    if (pending_rescan) {
+        if (!fs_task_wait(pending_rescan, 1)) return;
+        index_apply_rescan(pending_rescan_arg);
+        fs_task_release(pending_rescan);
+        pending_rescan = NULL;
+        pending_rescan_arg = NULL;
+    }
+
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    size_t changed = 0;
+    ssize_t len;
+    while ((len = read(inotify_fd, buf, sizeof(buf))) > 0) {
+        for (char *p = buf; p < buf + len; ) {
+            const struct inotify_event *ev = (const struct inotify_event *)p;
+            for (size_t i = 0; i < num_index_dirs; i++) {
+                if ((ev->mask & IN_Q_OVERFLOW) || index_dirs[i].wd == ev->wd) {
+                    if (!index_dirs[i].stale) changed++;
+                    index_dirs[i].stale = 1;
+                    if (ev->mask & IN_IGNORED) index_dirs[i].wd = -1;
+                }
+            }
+            p += sizeof(struct inotify_event) + ev->len;
         }
     }
+    if (!changed) return;
+
+    rescan_task *t = calloc(1, sizeof(rescan_task));
+    if (!t) return;
+    t->dirs = calloc(changed, sizeof(index_dir));
+    t->slots = calloc(changed, sizeof(size_t));
+    if (!t->dirs || !t->slots) {
+        free_rescan_task(t);
+        return;
+    }
+    for (size_t i = 0; i < num_index_dirs && t->count < changed; i++) {
+        if (!index_dirs[i].stale) continue;
+        index_dir *copy = &t->dirs[t->count];
+        copy->path = strdup(index_dirs[i].path);
+        if (!copy->path) continue;
+        copy->wd = index_dirs[i].wd;
+        command_index_init(&copy->names);
+        t->slots[t->count++] = i;
+        index_dirs[i].stale = 0;
+    }
+
+    pthread_mutex_lock(&index_lock);
+    index_workers_active++;
+    pthread_mutex_unlock(&index_lock);
 
-    /* Add commands from PATH */
+    fs_task *task = fs_task_start(run_rescan_task, t, free_rescan_task);
+    if (!task) {
+        /* No worker to be had: list them here */
+        run_rescan_task(t);
+        index_apply_rescan(t);
+        free_rescan_task(t);
+        return;
+    }
+    if (!fs_task_wait(task, fs_deadline_ms())) {
+        pending_rescan = task;
+        pending_rescan_arg = t;
+        return;
+    }
+    index_apply_rescan(t);
+    fs_task_release(task);
+#endif
+}
+
+/* Helper function to compare names for qsort */
+static int compare_strings(const void *a, const void *b) {
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+/* Initialize command list for completion. Builtins are added right away;
+ * PATH is indexed by a background thread so the prompt is not delayed.
+ * Directories unchanged since the last run come from the mapped cache. */
+void completions_init(void) {
+    /* Add built-in commands */
+    qsort(builtin_names, NUM_BUILTIN_NAMES, sizeof(builtin_names[0]), compare_strings);
+    command_index_init(&commands);
+    command_index_merge_shared(&commands, builtin_names, NUM_BUILTIN_NAMES);
+
+    /* Directories of PATH, in order */
+    clock_gettime(CLOCK_MONOTONIC, &index_started);
     const char *path = getenv("PATH");
     if (path) {
         char *path_copy = strdup(path);
-        char *dir = strtok(path_copy, ":");
-        
+        char *dir = path_copy ? strtok(path_copy, ":") : NULL;
         while (dir) {
-            DIR *d = opendir(dir);
-            if (d) {
-                struct dirent *entry;
-                while ((entry = readdir(d)) != NULL) {
-                    if (entry->d_type == DT_REG || entry->d_type == DT_LNK) {
-                        char full_path[PATH_MAX];
-                        snprintf(full_path, sizeof(full_path), "%s/%s", dir, entry->d_name);
-                        if (access(full_path, X_OK) == 0) {
-                            char **new_commands = realloc(commands, (num_commands + 1) * sizeof(char*));
-                            if (new_commands) {
-                                commands = new_commands;
-                                commands[num_commands++] = strdup(entry->d_name);
-                            }
-                        }
-                    }
-                }
-                closedir(d);
+            index_dir *new_dirs = realloc(index_dirs, (num_index_dirs + 1) * sizeof(index_dir));
+            if (new_dirs) {
+                index_dirs = new_dirs;
+                memset(&index_dirs[num_index_dirs], 0, sizeof(index_dir));
+                index_dirs[num_index_dirs].path = strdup(dir);
+                index_dirs[num_index_dirs].wd = -1;
+                if (index_dirs[num_index_dirs].path) num_index_dirs++;
             }
             dir = strtok(NULL, ":");
         }
         free(path_copy);
     }
+    if (num_index_dirs == 0) {
+        index_elapsed_ms = ms_since(&index_started);
+        return;
+    }
+
+    completion_cache_load(&cache);
+#ifdef __linux__
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+
+    /* The thread starts with every signal blocked, so SIGCHLD and friends
+     * are always delivered to the main thread */
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    index_thread_running = pthread_create(&index_thread, NULL, index_thread_main, NULL) == 0;
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (!index_thread_running) {
+        index_work();
+        if (cache_dirty) index_save_cache();
+    }
+}
+
+int completions_wait_index(void) {
+    long ms = fs_deadline_ms();
+    struct timespec deadline;
+    index_deadline(&deadline, ms);
+
+    pthread_mutex_lock(&index_lock);
+    while (!index_stop && index_dirs_done < num_index_dirs) {
+        if (!index_wait(&deadline, ms)) break;
+    }
+    int complete = index_dirs_done >= num_index_dirs;
+    int unclaimed = next_index_dir < num_index_dirs;
+    pthread_mutex_unlock(&index_lock);
+
+    if (!complete) {
+        /* Some directory is slow to answer; let a worker carry on with the
+         * ones behind it */
+        if (unclaimed) fs_task_release(fs_task_start(index_help, NULL, NULL));
+        return 0;
+    }
+    index_refresh();
+    return 1;
+}
+
+void completions_index_status(size_t *dirs_done, size_t *dirs_total, size_t *dirs_cached,
+                              size_t *commands_found, double *elapsed_ms) {
+    pthread_mutex_lock(&index_lock);
+    *dirs_done = index_dirs_done;
+    *dirs_total = num_index_dirs;
+    *dirs_cached = index_dirs_cached;
+    *commands_found = commands.count;
+    *elapsed_ms = index_elapsed_ms;
+    pthread_mutex_unlock(&index_lock);
 }
 
 /* Clean up completion system */
 void completions_cleanup(void) {
-    for (size_t i = 0; i < num_commands; i++) {
-        free(commands[i]);
+    /* Stop indexing. A thread stuck on a hung directory is left behind,
+     * along with everything it may still touch. */
+    long ms = fs_deadline_ms();
+    struct timespec deadline;
+    index_deadline(&deadline, ms);
+
+    /* A rescan still going is dropped; index_workers_active covers it */
+    if (pending_rescan) {
+        fs_task_release(pending_rescan);
+        pending_rescan = NULL;
+        pending_rescan_arg = NULL;
+    }
+
+    pthread_mutex_lock(&index_lock);
+    index_stop = 1;
+    int stopped = 1;
+    while ((index_thread_running && !index_thread_exited) || index_workers_active > 0) {
+        if (!index_wait(&deadline, ms)) {
+            stopped = 0;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&index_lock);
+
+    if (index_thread_running) {
+        if (stopped) {
+            pthread_join(index_thread, NULL);
+        } else {
+            pthread_detach(index_thread);
+        }
+        index_thread_running = 0;
+    }
+    if (!stopped) return;
+
+    /* Store changes picked up while running */
+    if (cache_dirty && index_dirs_done == num_index_dirs) {
+        index_save_cache();
+    }
+    if (inotify_fd >= 0) {
+        close(inotify_fd);
+        inotify_fd = -1;
+    }
+
+    command_index_free(&commands);
+    for (size_t i = 0; i < num_index_dirs; i++) {
+        free(index_dirs[i].path);
+        command_index_free(&index_dirs[i].names);
     }
-    free(commands);
-    commands = NULL;
-    num_commands = 0;
+    free(index_dirs);
+    index_dirs = NULL;
+    num_index_dirs = next_index_dir = index_dirs_done = index_dirs_cached = 0;
+    index_stop = cache_dirty = index_thread_exited = 0;
+
+    bk_tree_free(&command_tree);
+    completion_cache_close(&cache);
 }
 
-/* Helper function to check if a path is a directory */
-static int is_directory(const char *path) {
-    struct stat st;
-    return (stat(path, &st) == 0 && S_ISDIR(st.st_mode));
+/* Candidate ordering for completions_suggest: fewest typos, then the more
+ * frecent command, then by name */
+typedef struct suggestion {
+    const char *name;
+    unsigned typos;
+    double frecency;
+} suggestion;
+
+static int compare_suggestions(const void *a, const void *b) {
+    const suggestion *x = a, *y = b;
+    if (x->typos != y->typos) return x->typos < y->typos ? -1 : 1;
+    if (x->frecency != y->frecency) return x->frecency > y->frecency ? -1 : 1;
+    return strcmp(x->name, y->name);
 }
 
-/* Helper function to escape spaces in filenames */
-static char *escape_spaces(const char *str) {
-    if (!str) return NULL;
-    
-    /* Count spaces to determine buffer size */
-    size_t spaces = 0;
-    for (const char *p = str; *p; p++) {
-        if (*p == ' ') spaces++;
-    }
-    
-    /* If no spaces, just return a copy */
-    if (spaces == 0) return strdup(str);
-    
-    /* Allocate buffer for escaped string */
-    char *escaped = malloc(strlen(str) + spaces + 1);
-    if (!escaped) return NULL;
-    
-    /* Copy string and escape spaces */
-    char *out = escaped;
-    for (const char *p = str; *p; p++) {
-        if (*p == ' ') {
-            *out++ = '\\';
+size_t completions_suggest(const char *name, const char **suggestions, size_t max) {
+    size_t len = strlen(name);
+    if (len == 0 || max == 0 || !completions_wait_index()) return 0;
+
+    pthread_mutex_lock(&index_lock);
+    int empty = commands.count == 0;
+    if (!empty && command_tree.count == 0) {
+        for (size_t i = 0; i < commands.count; i++) {
+            if (bk_tree_add(&command_tree, commands.names[i]) != 0) break;
         }
-        *out++ = *p;
     }
-    *out = '\0';
-    
-    return escaped;
+    pthread_mutex_unlock(&index_lock);
+    if (empty) return 0;
+
+    /* Allow about one typo per three characters */
+    unsigned radius = len <= 2 ? 1 : len <= 7 ? 2 : 3;
+    bk_match found[GHOST_SUGGEST_CANDIDATES];
+    size_t num_found = bk_tree_search(&command_tree, name, radius, found, GHOST_SUGGEST_CANDIDATES);
+
+    suggestion ranked[GHOST_SUGGEST_CANDIDATES];
+    for (size_t i = 0; i < num_found; i++) {
+        ranked[i].name = found[i].word;
+        ranked[i].typos = typo_distance(name, len, found[i].word, strlen(found[i].word));
+        ranked[i].frecency = frecency_score(FRECENCY_COMMAND, found[i].word);
+    }
+    qsort(ranked, num_found, sizeof(suggestion), compare_suggestions);
+
+    size_t count = num_found < max ? num_found : max;
+    for (size_t i = 0; i < count; i++) {
+        suggestions[i] = ranked[i].name;
+    }
+    return count;
 }
 
-/* Helper function to get directory entries */
-static char **get_directory_entries(const char *dir_path, const char *prefix, size_t *count, int dirs_only) {
-    char **entries = NULL;
+/* Helper function to collect the file completions for prefix in dir_path,
+ * as views into the directory listing cache. *stale is set when the
+ * directory did not answer in time and the cached listing was used. */
+static const char **get_directory_entries(const char *dir_path, const char *prefix, size_t *count,
+                                          int dirs_only, int *stale) {
     *count = 0;
-    
-    DIR *d = opendir(dir_path && dir_path[0] ? dir_path : ".");
-    if (!d) return NULL;
-    
-    size_t prefix_len = prefix ? strlen(prefix) : 0;
-    struct dirent *entry;
-    
-    while ((entry = readdir(d)) != NULL) {
+
+    size_t num_entries;
+    const dir_entry *entries = dir_listing_get(dir_path && dir_path[0] ? dir_path : ".", &num_entries, stale);
+    if (!entries) return NULL;
+
+    size_t first;
+    size_t n = dir_listing_prefix(entries, num_entries, prefix ? prefix : "", &first);
+    const char **matches = malloc((n ? n : 1) * sizeof(char *));
+    if (!matches) return NULL;
+
+    for (size_t i = first; i < first + n; i++) {
         /* Skip . and .. unless explicitly requested */
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
-            if (!prefix || prefix[0] != '.') continue;
-        }
-        
-        /* Check prefix match */
-        if (prefix && strncmp(entry->d_name, prefix, prefix_len) != 0) {
+        if ((strcmp(entries[i].name, ".") == 0 || strcmp(entries[i].name, "..") == 0) &&
+            (!prefix || prefix[0] != '.')) {
             continue;
         }
-        
-        /* Construct full path for directory check */
-        char full_path[PATH_MAX];
-        if (dir_path && dir_path[0]) {
-            snprintf(full_path, sizeof(full_path), "%s/%s", dir_path, entry->d_name);
-        } else {
-            snprintf(full_path, sizeof(full_path), "%s", entry->d_name);
-        }
-        
-        /* Check if it's a directory */
-        int is_dir = is_directory(full_path);
-        
         /* Skip if we only want directories and this isn't one */
-        if (dirs_only && !is_dir) continue;
-        
-        /* Add to entries */
-        char **new_entries = realloc(entries, (*count + 1) * sizeof(char*));
-        if (new_entries) {
-            entries = new_entries;
-            /* Add trailing slash for directories */
-            char *escaped_name = escape_spaces(entry->d_name);
-            if (escaped_name) {
-                if (is_dir) {
-                    entries[*count] = malloc(strlen(escaped_name) + 2);
-                    if (entries[*count]) {
-                        strcpy(entries[*count], escaped_name);
-                        strcat(entries[*count], "/");
-                    }
-                } else {
-                    entries[*count] = strdup(escaped_name);
-                }
-                free(escaped_name);
-                if (entries[*count]) {
-                    (*count)++;
-                }
+        if (dirs_only && !entries[i].is_dir) continue;
+        matches[(*count)++] = entries[i].display;
+    }
+    return matches;
+}
+
+/* A directory completion and its frecency, for ordering */
+typedef struct ranked_dir {
+    const char *display;
+    double score;
+    size_t position;   /* In the listing */
+} ranked_dir;
+
+static int compare_ranked_dirs(const void *a, const void *b) {
+    const ranked_dir *x = a, *y = b;
+    if (x->score != y->score) return x->score > y->score ? -1 : 1;
+    return (x->position > y->position) - (x->position < y->position);
+}
+
+/* Helper function to list the directories cd can complete in dir_path with
+ * those entered most often and recently first, the rest in listing order */
+static void rank_directories(const char **matches, size_t count, const char *dir_path) {
+    char *base = realpath(dir_path && dir_path[0] ? dir_path : ".", NULL);
+    ranked_dir *ranked = base ? malloc(count * sizeof(ranked_dir)) : NULL;
+    int any = 0;
+    for (size_t i = 0; ranked && i < count; i++) {
+        /* The display form has spaces escaped and a '/' after the name */
+        char path[PATH_MAX];
+        size_t n = (size_t)snprintf(path, sizeof(path), "%s/", strcmp(base, "/") == 0 ? "" : base);
+        for (const char *p = matches[i]; *p && n + 1 < sizeof(path); p++) {
+            if (*p == '\\' && p[1] == ' ') p++;
+            path[n++] = *p;
+        }
+        if (n > 1 && path[n - 1] == '/') n--;
+        path[n] = '\0';
+
+        ranked[i].display = matches[i];
+        ranked[i].score = dir_jump_score(path);
+        ranked[i].position = i;
+        if (ranked[i].score > 0) any = 1;
+    }
+    if (any) {
+        qsort(ranked, count, sizeof(ranked_dir), compare_ranked_dirs);
+        for (size_t i = 0; i < count; i++) matches[i] = ranked[i].display;
+    }
+    free(ranked);
+    free(base);
+}
+
+/* Helper function to offer the directories entered before that match the
+ * word, best first, for cd when nothing in the directory starts with it.
+ * They are returned in completion form (spaces escaped, '/' after), each
+ * to be freed. */
+static char **get_jump_matches(const char *word, size_t *count) {
+    *count = 0;
+    char *cwd = getcwd(NULL, 0);
+    char *paths[GHOST_DIR_JUMP_CANDIDATES];
+    size_t found = dir_jump_search(&word, 1, cwd, paths, NULL, GHOST_DIR_JUMP_CANDIDATES);
+    free(cwd);
+
+    char **result = malloc((found ? found : 1) * sizeof(char *));
+    for (size_t i = 0; i < found; i++) {
+        char *display = result ? malloc(2 * strlen(paths[i]) + 2) : NULL;
+        if (display) {
+            char *out = display;
+            for (const char *p = paths[i]; *p; p++) {
+                if (*p == ' ') *out++ = '\\';
+                *out++ = *p;
             }
+            if (out[-1] != '/') *out++ = '/';
+            *out = '\0';
+            result[(*count)++] = display;
         }
+        free(paths[i]);
     }
-    
-    closedir(d);
-    return entries;
+    return result;
+}
+
+/* Helper function to find the completion spec of the command the word at
+ * word_start is an argument of, and the spec node the words between them
+ * lead to. Returns NULL if the command has no spec. */
+static const completion_spec *find_line_spec(const char *buffer, const char *word_start, uint32_t *node) {
+    /* The command starts after the last separator before the word */
+    const char *start = buffer;
+    for (const char *p = buffer; p < word_start; p++) {
+        if ((*p == ';' || *p == '|' || *p == '&') && (p == buffer || p[-1] != '\\')) start = p + 1;
+    }
+
+    /* Split the words before the word being completed */
+    char *words[GHOST_MAX_ARGS];
+    size_t num_words = 0;
+    const char *p = start;
+    while (num_words < GHOST_MAX_ARGS) {
+        while (p < word_start && isspace((unsigned char)*p)) p++;
+        if (p >= word_start) break;
+        const char *end = p;
+        while (end < word_start && !(isspace((unsigned char)*end) && end[-1] != '\\')) end++;
+        words[num_words] = strndup(p, (size_t)(end - p));
+        if (!words[num_words]) break;
+        num_words++;
+        p = end;
+    }
+
+    const completion_spec *spec = NULL;
+    if (num_words > 0) {
+        const char *slash = strrchr(words[0], '/');
+        spec = completion_spec_find(slash ? slash + 1 : words[0]);
+        if (spec) *node = completion_spec_walk(spec, (const char *const *)words + 1, num_words - 1);
+    }
+    for (size_t i = 0; i < num_words; i++) {
+        free(words[i]);
+    }
+    return spec;
+}
+
+/* Helper function to collect what a spec node offers for the word: its
+ * subcommands and flags, then names from its git sources, sorted and
+ * without duplicates. Returns a malloc'd array of views. *stale is set
+ * when the repository did not answer in time. */
+static const char **get_spec_matches(const completion_spec *spec, uint32_t node, const char *word,
+                                     size_t *count, int *stale) {
+    static const struct {
+        unsigned flag;
+        git_ref_kind kind;
+    } ref_sources[] = {
+        {SPEC_SOURCE_BRANCHES, GIT_REF_BRANCHES},
+        {SPEC_SOURCE_TAGS, GIT_REF_TAGS},
+        {SPEC_SOURCE_REMOTES, GIT_REF_REMOTES},
+    };
+
+    const char **words;
+    *count = completion_spec_words(spec, node, word, &words);
+
+    unsigned sources = completion_spec_sources(spec, node);
+    for (size_t i = 0; i < sizeof(ref_sources) / sizeof(ref_sources[0]); i++) {
+        if (!(sources & ref_sources[i].flag)) continue;
+        const command_index *refs = git_refs_get(ref_sources[i].kind, stale);
+        if (*stale) break;
+        if (!refs) continue;
+
+        size_t first;
+        size_t n = command_index_prefix(refs, word, strlen(word), &first);
+        if (n == 0) continue;
+        const char **grown = realloc(words, (*count + n) * sizeof(char *));
+        if (!grown) continue;
+        words = grown;
+        memcpy(words + *count, refs->names + first, n * sizeof(char *));
+        *count += n;
+    }
+
+    if (*count > 1 && sources & (SPEC_SOURCE_BRANCHES | SPEC_SOURCE_TAGS | SPEC_SOURCE_REMOTES)) {
+        qsort(words, *count, sizeof(char *), compare_strings);
+        size_t n = 1;
+        for (size_t i = 1; i < *count; i++) {
+            if (strcmp(words[i], words[n - 1]) != 0) words[n++] = words[i];
+        }
+        *count = n;
+    }
+    return words;
+}
+
+/* Helper function to turn a frecency into a bounded score bonus */
+static double frecency_bonus(double frecency) {
+    return GHOST_FUZZY_FRECENCY_WEIGHT * frecency / (frecency + 4);
+}
+
+static double command_bonus(const char *name, void *arg) {
+    (void)arg;
+    return frecency_bonus(frecency_score(FRECENCY_COMMAND, name));
+}
+
+/* Bonus for a file name in directory arg: directories cd has entered */
+static double path_bonus(const char *name, void *arg) {
+    const char *base = arg;
+    char path[PATH_MAX];
+    if (!base) return 0;
+    int n = snprintf(path, sizeof(path), "%s/%s", strcmp(base, "/") == 0 ? "" : base, name);
+    if (n < 0 || (size_t)n >= sizeof(path)) return 0;
+    return frecency_bonus(dir_jump_score(path));
+}
+
+/* Bonus for a file completion in directory arg, given in display form
+ * (spaces escaped, '/' after directories) */
+static double display_bonus(const char *display, void *arg) {
+    char name[PATH_MAX];
+    size_t n = 0;
+    for (const char *p = display; *p && n + 1 < sizeof(name); p++) {
+        if (*p == '\\' && p[1] == ' ') p++;
+        name[n++] = *p;
+    }
+    if (n > 1 && name[n - 1] == '/') n--;
+    name[n] = '\0';
+    return path_bonus(name, arg);
+}
+
+/* Helper function to order prefix matches as fuzzy matches are ordered
+ * (GHSH_FUZZY=1): by match quality plus bonus, best first, ties in the
+ * order they were listed */
+static void rank_prefix_matches(const char **matches, size_t count, const char *word,
+                                fuzzy_bonus_fn bonus, void *arg) {
+    fuzzy_pattern pattern;
+    if (count < 2 || fuzzy_compile(&pattern, word) != 0) return;
+    ranked_dir *ranked = malloc(count * sizeof(ranked_dir));
+    if (!ranked) return;
+
+    for (size_t i = 0; i < count; i++) {
+        ranked[i].display = matches[i];
+        ranked[i].score = fuzzy_score(&pattern, matches[i]) + (bonus ? bonus(matches[i], arg) : 0);
+        ranked[i].position = i;
+    }
+    qsort(ranked, count, sizeof(ranked_dir), compare_ranked_dirs);
+    for (size_t i = 0; i < count; i++) matches[i] = ranked[i].display;
+    free(ranked);
+}
+
+/* Helper function to rank fuzzy matches for the word, best first, as views
+ * into the command index or the listing cache. Used when GHSH_FUZZY=1 and
+ * nothing starts with the word. */
+static const char **get_fuzzy_matches(const char *word, int completing_command, const char *dir_path,
+                                      const char *prefix, int dirs_only, size_t *count, int *stale) {
+    *count = 0;
+    fuzzy_pattern pattern;
+    if (fuzzy_compile(&pattern, completing_command ? word : prefix) != 0) return NULL;
+
+    const char **result = NULL;
+    fuzzy_match *ranked = NULL;
+    size_t num_ranked;
+
+    if (completing_command) {
+        num_ranked = fuzzy_rank(&pattern, commands.names, commands.count, command_bonus, NULL, &ranked);
+        result = malloc((num_ranked ? num_ranked : 1) * sizeof(char *));
+        if (result) {
+            for (size_t i = 0; i < num_ranked; i++) result[i] = ranked[i].candidate;
+            *count = num_ranked;
+        }
+        free(ranked);
+        return result;
+    }
+
+    size_t num_entries;
+    const dir_entry *entries = dir_listing_get(dir_path && dir_path[0] ? dir_path : ".", &num_entries, stale);
+    if (!entries) return NULL;
+
+    /* Candidates by name; hidden files only when the pattern asks for them */
+    const char **names = malloc((num_entries ? num_entries : 1) * sizeof(char *));
+    size_t *positions = malloc((num_entries ? num_entries : 1) * sizeof(size_t));
+    size_t num_names = 0;
+    if (names && positions) {
+        for (size_t i = 0; i < num_entries; i++) {
+            if (strcmp(entries[i].name, ".") == 0 || strcmp(entries[i].name, "..") == 0) continue;
+            if (entries[i].name[0] == '.' && prefix[0] != '.') continue;
+            if (dirs_only && !entries[i].is_dir) continue;
+            names[num_names] = entries[i].name;
+            positions[num_names++] = i;
+        }
+
+        /* No realpath on a directory that is slow to answer */
+        char *base = *stale ? NULL : realpath(dir_path && dir_path[0] ? dir_path : ".", NULL);
+        num_ranked = fuzzy_rank(&pattern, names, num_names, path_bonus, base, &ranked);
+        free(base);
+
+        result = malloc((num_ranked ? num_ranked : 1) * sizeof(char *));
+        if (result) {
+            for (size_t i = 0; i < num_ranked; i++) {
+                result[i] = entries[positions[ranked[i].index]].display;
+            }
+            *count = num_ranked;
+        }
+        free(ranked);
+    }
+    free(names);
+    free(positions);
+    return result;
 }
 
 /* Tab completion function */
@@ -217,6 +993,13 @@ unsigned char ghost_complete(EditLine *edit_line, int ch) {
         word_start--;
     }
     
+    /* Arguments of a command with a completion spec complete from it */
+    uint32_t spec_node = 0;
+    const completion_spec *spec = NULL;
+    if (word_start != line_info->buffer) {
+        spec = find_line_spec(line_info->buffer, word_start, &spec_node);
+    }
+    
     /* Get word length */
     int len = line_info->cursor - word_start;
     if (len == 0) {
@@ -225,8 +1008,8 @@ unsigned char ghost_complete(EditLine *edit_line, int ch) {
             el_insertstr(edit_line, "\t");
             return CC_REDISPLAY;
         }
-        /* Otherwise, do nothing */
-        return CC_NORM;
+        /* Otherwise, do nothing unless a spec lists what comes next */
+        if (!spec) return CC_NORM;
     }
     
     /* Get current word and unescape it for matching */
@@ -249,12 +1032,13 @@ unsigned char ghost_complete(EditLine *edit_line, int ch) {
     int completing_command = (word_start == line_info->buffer);
     int completing_cd = 0;
     
-    /* Check if we're completing after 'cd' or starting with ./ */
+    /* Check if we're completing after 'cd' (or 'z') or starting with ./ */
     if (!completing_command) {
         const char *cmd_start = line_info->buffer;
         while (isspace(*cmd_start)) cmd_start++;
         completing_cd = (strncmp(cmd_start, "cd", 2) == 0 && 
-                       (isspace(cmd_start[2]) || cmd_start[2] == '\0'));
+                       (isspace(cmd_start[2]) || cmd_start[2] == '\0')) ||
+                        (cmd_start[0] == 'z' && isspace(cmd_start[1]));
     } else if (strncmp(word, "./", 2) == 0) {
         /* If starting with ./, treat as file completion instead of command */
         completing_command = 0;
@@ -278,32 +1062,124 @@ unsigned char ghost_complete(EditLine *edit_line, int ch) {
         file_part = strdup(word);
     }
     
-    /* Get completions */
-    char **matches = NULL;
+    /* Get completions. Command matches are a range of the index itself and
+     * file matches point into the listing cache; neither is copied. */
+    const char *const *matches = NULL;
+    const char **match_list = NULL;
     size_t num_matches = 0;
+    size_t num_spec = 0;  /* Leading matches that come from a spec */
+    
+    /* Filesystem work is bounded by the deadline; past it the results are
+     * partial or stale, which the note below says */
+    char note[PATH_MAX + 128] = "";
+    int index_complete = 1;
+    int stale = 0;
+    int refs_stale = 0;
+    const char *fuzzy_env = getenv("GHSH_FUZZY");
+    int fuzzy = fuzzy_env && strcmp(fuzzy_env, "1") == 0;
     
     if (completing_command) {
-        /* Complete commands */
-        for (size_t i = 0; i < num_commands; i++) {
-            if (strncmp(commands[i], word, len) == 0) {
-                char **new_matches = realloc(matches, (num_matches + 1) * sizeof(char*));
-                if (new_matches) {
-                    matches = new_matches;
-                    matches[num_matches++] = strdup(commands[i]);
-                }
-            }
+        /* Complete commands. An incomplete PATH index keeps changing, so
+         * matches are copied out of it under the lock. */
+        index_complete = completions_wait_index();
+        if (!index_complete) {
+            pthread_mutex_lock(&index_lock);
+            snprintf(note, sizeof(note), "(PATH index incomplete: %zu of %zu directories answered within %ld ms)",
+                     index_dirs_done, num_index_dirs, fs_deadline_ms());
         }
-    } else {
+        size_t first;
+        num_matches = command_index_prefix(&commands, word, strlen(word), &first);
+        matches = commands.names + first;
+        /* Ranked ones are reordered, so they need a copy too */
+        if (!index_complete || (fuzzy && num_matches > 1)) {
+            match_list = malloc((num_matches ? num_matches : 1) * sizeof(char *));
+            if (match_list) memcpy(match_list, matches, num_matches * sizeof(char *));
+            num_matches = match_list ? num_matches : 0;
+            matches = match_list;
+        }
+        if (fuzzy && match_list) rank_prefix_matches(match_list, num_matches, word, command_bonus, NULL);
+    } else if (completing_cd || !spec) {
         /* Complete files/directories */
-        matches = get_directory_entries(dir_part, file_part, &num_matches, completing_cd);
+        match_list = get_directory_entries(dir_part, file_part, &num_matches, completing_cd, &stale);
+        if (completing_cd && num_matches > 1 && !stale) {
+            rank_directories(match_list, num_matches, dir_part);
+        } else if (fuzzy && num_matches > 1 && !stale) {
+            char *base = realpath(dir_part && dir_part[0] ? dir_part : ".", NULL);
+            rank_prefix_matches(match_list, num_matches, file_part, display_bonus, base);
+            free(base);
+        }
+        matches = match_list;
+    } else {
+        /* Complete from the spec, followed by files where it takes them or
+         * offers nothing else. Spec words are whole words, so a word with
+         * a '/' gets either kind, not both. */
+        match_list = get_spec_matches(spec, spec_node, word, &num_spec, &refs_stale);
+        num_matches = num_spec;
+        unsigned sources = completion_spec_sources(spec, spec_node);
+        int want_files = len > 0 ? num_spec == 0 || (!last_slash && (sources & (SPEC_SOURCE_FILES | SPEC_SOURCE_DIRS)))
+                                 : (sources & (SPEC_SOURCE_FILES | SPEC_SOURCE_DIRS)) != 0;
+        if (want_files) {
+            size_t num_files;
+            int dirs_only = (sources & SPEC_SOURCE_DIRS) && !(sources & SPEC_SOURCE_FILES);
+            const char **files = get_directory_entries(dir_part, file_part, &num_files, dirs_only, &stale);
+            const char **all = num_files ? realloc(match_list, (num_spec + num_files) * sizeof(char *)) : NULL;
+            if (all) {
+                memcpy(all + num_spec, files, num_files * sizeof(char *));
+                match_list = all;
+                num_matches += num_files;
+            }
+            free(files);
+        }
+        matches = match_list;
+    }
+    
+    /* Nothing here starts with the word: for cd, directories entered
+     * before that match it */
+    char **jumps = NULL;
+    int fuzzy_matched = 0;
+    if (num_matches == 0 && completing_cd && word[0] && !last_slash) {
+        jumps = get_jump_matches(word, &num_matches);
+        if (num_matches > 0) {
+            free(match_list);
+            match_list = (const char **)jumps;
+            matches = match_list;
+            fuzzy_matched = 1;
+        } else {
+            free(jumps);
+            jumps = NULL;
+        }
+    }
+
+    /* Nothing starts with the word: rank fuzzy matches instead */
+    if (num_matches == 0 && fuzzy) {
+        free(match_list);
+        match_list = get_fuzzy_matches(word, completing_command, dir_part, file_part, completing_cd,
+                                       &num_matches, &stale);
+        matches = match_list;
+        fuzzy_matched = 1;
+    }
+    if (!index_complete) {
+        pthread_mutex_unlock(&index_lock);
+    }
+    if (stale) {
+        snprintf(note, sizeof(note), "(%s did not answer within %ld ms; %s)", dir_part,
+                 fs_deadline_ms(), num_matches ? "showing cached entries" : "nothing cached yet");
+    } else if (refs_stale) {
+        snprintf(note, sizeof(note), "(the git repository did not answer within %ld ms; branches, tags and remotes left out)",
+                 fs_deadline_ms());
     }
     
     /* Handle completions */
     if (num_matches == 0) {
         /* No matches */
+        free(match_list);
         free(word);
         free(dir_part);
         free(file_part);
+        if (note[0]) {
+            printf("\n%s\n", note);
+            return CC_REDISPLAY;
+        }
         return CC_ERROR;
     }
     
@@ -311,16 +1187,27 @@ unsigned char ghost_complete(EditLine *edit_line, int ch) {
     char *common_prefix = strdup(matches[0]);
     size_t common_len = strlen(common_prefix);
     
-    for (size_t i = 1; i < num_matches; i++) {
+    for (size_t i = 1; i < num_matches && common_len > 0; i++) {
         size_t j;
         for (j = 0; j < common_len && matches[i][j] == common_prefix[j]; j++);
         common_len = j;
         common_prefix[common_len] = '\0';
     }
     
+    /* Fuzzy and jump matches need not share a prefix; keep the word until
+     * one is left */
+    if (fuzzy_matched && num_matches > 1) {
+        common_prefix[0] = '\0';
+    }
+    
     /* Show all matches if there's more than one */
-    if (num_matches > 1) {
-        print_completions_columns(matches, num_matches);
+    int listed = 0;
+    if (num_matches > 1 && confirm_completions(edit_line, num_matches)) {
+        print_completions_columns(edit_line, matches, num_matches);
+        listed = 1;
+    }
+    if (note[0]) {
+        printf(listed ? "%s\n" : "\n%s\n", note);
     }
     
     /* Replace current word with completion */
@@ -332,14 +1219,14 @@ unsigned char ghost_complete(EditLine *edit_line, int ch) {
         }
         
         /* Insert completion */
-        if (last_slash) {
+        if (last_slash && num_spec == 0) {
             /* Preserve directory part and handle special cases */
             char *completion = NULL;
             size_t completion_size = 0;
             
             /* Always preserve the original directory structure */
             const char *prefix = dir_part;
-            const char *separator = "/";
+            const char *separator = prefix[strlen(prefix) - 1] == '/' ? "" : "/";
             completion_size = strlen(prefix) + strlen(separator) + strlen(common_prefix) + 1;
             completion = malloc(completion_size);
             if (completion) {
@@ -354,18 +1241,18 @@ unsigned char ghost_complete(EditLine *edit_line, int ch) {
             el_insertstr(edit_line, common_prefix);
         }
         
-        /* Add space after unique command completion */
-        if (num_matches == 1 && completing_command) {
+        /* Add space after unique command completion, or a unique spec
+         * word that is not waiting for a value */
+        if (num_matches == 1 && (completing_command ||
+                                 (num_spec == 1 && strchr("/=", common_prefix[common_len - 1]) == NULL))) {
             el_insertstr(edit_line, " ");
         }
     }
     
     /* Clean up */
     free(common_prefix);
-    for (size_t i = 0; i < num_matches; i++) {
-        free(matches[i]);
-    }
-    free(matches);
+    for (size_t i = 0; jumps && i < num_matches; i++) free(jumps[i]);
+    free(match_list);
     free(word);
     free(dir_part);
     free(file_part);
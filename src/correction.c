@@ -0,0 +1,75 @@
+#include "correction.h"
+#include "completions.h"
+#include "path_cache.h"
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+void correction_report(const char *name) {
+    if (!name || strchr(name, '/')) return;
+
+    const char *suggestions[GHOST_SUGGEST_SHOWN];
+    size_t count = completions_suggest(name, suggestions, GHOST_SUGGEST_SHOWN);
+    if (count == 0) return;
+
+    fprintf(stderr, "ghost-shell: did you mean: ");
+    for (size_t i = 0; i < count; i++) {
+        fprintf(stderr, "%s%s", i ? ", " : "", suggestions[i]);
+    }
+    fprintf(stderr, "?\n");
+}
+
+/* Helper function to read the answer line from the terminal one byte at a
+ * time, so nothing typed after it is taken from libedit. Returns its first
+ * character, or 0 at end of input. */
+static char read_answer(void) {
+    char answer = 0;
+    for (;;) {
+        unsigned char c;
+        ssize_t n = read(STDIN_FILENO, &c, 1);
+        if (n < 0 && errno == EINTR) continue;
+        if (n != 1 || c == '\n') return answer;
+        if (!answer) answer = (char)c;
+    }
+}
+
+char *correction_offer(const char *line) {
+    const char *enabled = getenv("GHSH_CORRECT");
+    if (!enabled || strcmp(enabled, "1") != 0 || !isatty(STDIN_FILENO)) return NULL;
+
+    /* The first word, if it is a plain name */
+    const char *start = line;
+    while (isspace((unsigned char)*start)) start++;
+    const char *end = start;
+    while (*end && !isspace((unsigned char)*end) && !strchr(";|&<>", *end)) {
+        if (strchr("/=$'\"\\*?[~", *end)) return NULL;
+        end++;
+    }
+    if (end == start || (end - start == 4 && strncmp(start, "time", 4) == 0)) return NULL;
+
+    char *word = strndup(start, (size_t)(end - start));
+    if (!word) return NULL;
+
+    const char *suggestion;
+    char *corrected = NULL;
+    if (!path_cache_lookup(word) && completions_suggest(word, &suggestion, 1) == 1 &&
+        strcmp(suggestion, word) != 0) {
+        fprintf(stderr, "ghost-shell: %s: command not found; run '%s' instead? [y/N] ", word, suggestion);
+        fflush(stderr);
+
+        char answer = read_answer();
+        if (answer == 'y' || answer == 'Y') {
+            size_t before = (size_t)(start - line);
+            size_t size = before + strlen(suggestion) + strlen(end) + 1;
+            corrected = malloc(size);
+            if (corrected) {
+                snprintf(corrected, size, "%.*s%s%s", (int)before, line, suggestion, end);
+            }
+        }
+    }
+    free(word);
+    return corrected;
+}
@@ -0,0 +1,502 @@
+#include "dir_jump.h"
+#include "frecency.h"
+#include "history_store.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DIRS_MAGIC "GHSHDZ1\n"
+#define MAGIC_LEN 8
+
+/* The file: this header, then max_entries entries, the pair bits of each,
+ * 2 * max_entries hash slots (entry number + 1, 0 if free) and
+ * strings_max bytes of paths */
+typedef struct dirs_header {
+    char magic[MAGIC_LEN];
+    uint32_t num_entries;
+    uint32_t max_entries;   /* A power of two */
+    uint32_t strings_used;
+    uint32_t strings_max;
+    uint64_t total;         /* Visits counted since the counts were halved */
+} dirs_header;
+
+typedef struct dirs_entry {
+    uint32_t count;         /* Visits; no entry has more than the one before */
+    uint32_t last_used;     /* Time of the last visit */
+    uint32_t hash;
+    uint32_t path;          /* Offset of the path, NUL-terminated */
+    uint32_t path_len;
+} dirs_entry;
+
+/* Which byte pairs (ASCII case folded, hashed to 64 bits) occur in an
+ * entry's path and in its final component; a lookup skips entries that
+ * lack a pair of the fragments without reading the path. Kept apart from
+ * the entries so that going through them reads as little as possible. */
+typedef struct dirs_bits {
+    uint64_t path;
+    uint64_t base;
+} dirs_bits;
+
+static char db_path[PATH_MAX];
+static int db_fd = -1;
+static char *db_map = NULL;
+static size_t db_size = 0;
+static dev_t db_dev;
+static ino_t db_ino;
+static dirs_header *hdr = NULL;
+static dirs_entry *entries = NULL;
+static dirs_bits *bits = NULL;
+static uint32_t *slots = NULL;
+static char *strings = NULL;
+
+/* FNV-1a hash of a path */
+static uint32_t hash_path(const char *path, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)path[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* Helper function to fold a byte for matching */
+static unsigned char fold(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? (unsigned char)(c - 'A' + 'a') : c;
+}
+
+/* Helper function to get the pair bits of s[0, len) */
+static uint64_t pair_bits(const char *s, size_t len) {
+    uint64_t b = 0;
+    for (size_t i = 1; i < len; i++) {
+        uint32_t pair = (uint32_t)fold((unsigned char)s[i - 1]) << 8 | fold((unsigned char)s[i]);
+        b |= (uint64_t)1 << ((pair * 2654435761u) >> 26);
+    }
+    return b;
+}
+
+/* Helper function to find where the final component of a path starts */
+static size_t base_start(const char *path, size_t len) {
+    while (len > 0 && path[len - 1] != '/') len--;
+    return len;
+}
+
+/* Helper function to get the size of a database file */
+static size_t db_bytes(uint32_t max_entries, uint32_t strings_max) {
+    return sizeof(dirs_header) + (size_t)max_entries * (sizeof(dirs_entry) + sizeof(dirs_bits) + 2 * sizeof(uint32_t)) +
+           strings_max;
+}
+
+/* Helper function to point into a mapped database. Returns 0 if it is
+ * sound. */
+static int db_layout(char *map, size_t size) {
+    dirs_header *h = (dirs_header *)map;
+    if (size < sizeof(*h) || memcmp(h->magic, DIRS_MAGIC, MAGIC_LEN) != 0) return -1;
+    if (h->max_entries == 0 || (h->max_entries & (h->max_entries - 1)) != 0 || h->max_entries > (1u << 28) ||
+        h->num_entries > h->max_entries || h->strings_used > h->strings_max ||
+        db_bytes(h->max_entries, h->strings_max) != size) {
+        return -1;
+    }
+
+    hdr = h;
+    entries = (dirs_entry *)(map + sizeof(*h));
+    bits = (dirs_bits *)(entries + h->max_entries);
+    slots = (uint32_t *)(bits + h->max_entries);
+    strings = (char *)(slots + 2 * (size_t)h->max_entries);
+    return 0;
+}
+
+/* Helper function to get the path of an entry, or NULL if it points
+ * outside the file (another shell may be writing it) */
+static const char *entry_path(const dirs_entry *e) {
+    if (e->path >= hdr->strings_max || e->path_len >= hdr->strings_max - e->path) return NULL;
+    return strings + e->path;
+}
+
+/* Helper function to find the hash slot of path: the one holding its
+ * entry, or the free one it would go in. Returns UINT32_MAX if the table
+ * makes no sense. */
+static uint32_t find_slot(const char *path, size_t len, uint32_t hash) {
+    uint32_t mask = 2 * hdr->max_entries - 1;
+    uint32_t s = hash & mask;
+    for (uint32_t n = 0; n <= mask; n++, s = (s + 1) & mask) {
+        uint32_t v = slots[s];
+        if (v == 0) return s;
+        if (v > hdr->max_entries) return UINT32_MAX;
+
+        const dirs_entry *e = &entries[v - 1];
+        const char *p = e->hash == hash && e->path_len == len ? entry_path(e) : NULL;
+        if (p && memcmp(p, path, len) == 0) return s;
+    }
+    return UINT32_MAX;
+}
+
+/* Helper function to write a database with room for max_entries
+ * directories and strings_max bytes of paths, holding the entries of the
+ * mapped one that still have visits (if one is mapped), and put it in
+ * place: renamed over the mapped one, or linked if there is none yet */
+static int write_db(uint32_t max_entries, uint32_t strings_max) {
+    char tmp[PATH_MAX];
+    if (snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", db_path, (long)getpid()) >= (int)sizeof(tmp)) return -1;
+    int fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) return -1;
+
+    size_t size = db_bytes(max_entries, strings_max);
+    char *map = MAP_FAILED;
+    int ok = ftruncate(fd, (off_t)size) == 0 &&
+             (map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) != MAP_FAILED;
+    if (ok) {
+        dirs_header *h = (dirs_header *)map;
+        dirs_entry *out = (dirs_entry *)(map + sizeof(*h));
+        dirs_bits *out_bits = (dirs_bits *)(out + max_entries);
+        uint32_t *out_slots = (uint32_t *)(out_bits + max_entries);
+        char *out_strings = (char *)(out_slots + 2 * (size_t)max_entries);
+        uint32_t mask = 2 * max_entries - 1;
+
+        memcpy(h->magic, DIRS_MAGIC, MAGIC_LEN);
+        h->max_entries = max_entries;
+        h->strings_max = strings_max;
+        uint32_t num_entries = hdr ? hdr->num_entries : 0;
+        for (uint32_t i = 0; i < num_entries && h->num_entries < max_entries; i++) {
+            const dirs_entry *e = &entries[i];
+            const char *path = entry_path(e);
+            if (e->count == 0 || !path || e->path_len >= strings_max - h->strings_used) continue;
+
+            dirs_entry *n = &out[h->num_entries];
+            *n = *e;
+            out_bits[h->num_entries] = bits[i];
+            n->path = h->strings_used;
+            memcpy(out_strings + n->path, path, e->path_len);
+            h->strings_used += e->path_len + 1;
+            h->total += e->count;
+
+            uint32_t s = e->hash & mask;
+            while (out_slots[s]) s = (s + 1) & mask;
+            out_slots[s] = ++h->num_entries;
+        }
+        munmap(map, size);
+        ok = fsync(fd) == 0;
+    }
+    if (close(fd) != 0) ok = 0;
+
+    /* Another shell creating it first is as good */
+    if (ok) ok = db_map ? rename(tmp, db_path) == 0 : link(tmp, db_path) == 0 || errno == EEXIST;
+    unlink(tmp);
+    return ok ? 0 : -1;
+}
+
+/* Helper function to drop the mapping */
+static void unmap_db(void) {
+    if (db_map) munmap(db_map, db_size);
+    if (db_fd >= 0) close(db_fd);
+    db_map = NULL;
+    db_size = 0;
+    db_fd = -1;
+    hdr = NULL;
+    entries = NULL;
+    bits = NULL;
+    slots = NULL;
+    strings = NULL;
+}
+
+/* Helper function to map the database, writing an empty one first if
+ * there is none */
+static int map_db(int report) {
+    int fd = -1;
+    for (int attempt = 0; attempt < 3 && fd < 0; attempt++) {
+        fd = open(db_path, O_RDWR | O_CLOEXEC);
+        if (fd < 0 && (errno != ENOENT || write_db(GHOST_DIR_JUMP_MIN_ENTRIES, GHOST_DIR_JUMP_MIN_STRINGS) != 0)) {
+            return -1;
+        }
+    }
+    if (fd < 0) return -1;
+
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        map = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (map != MAP_FAILED && db_layout(map, (size_t)st.st_size) != 0) {
+        munmap(map, (size_t)st.st_size);
+        map = MAP_FAILED;
+        if (report) fprintf(stderr, "ghost-shell: %s: not a directory database\n", db_path);
+    }
+    if (map == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+
+    db_fd = fd;
+    db_map = map;
+    db_size = (size_t)st.st_size;
+    db_dev = st.st_dev;
+    db_ino = st.st_ino;
+    return 0;
+}
+
+/* Helper function to tell whether the mapped file is still the database */
+static int db_current(void) {
+    struct stat st;
+    return db_map && stat(db_path, &st) == 0 && st.st_dev == db_dev && st.st_ino == db_ino;
+}
+
+/* Helper function to follow the database to the file that replaced it,
+ * here or in another shell */
+static int refresh_db(void) {
+    if (!db_path[0]) return -1;
+    if (db_current()) return 0;
+    unmap_db();
+    return map_db(0);
+}
+
+/* Helper function to find the first entry in [lo, hi) with at most count
+ * visits (hi if none has) */
+static uint32_t first_at_most(uint32_t lo, uint32_t hi, uint32_t count) {
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (entries[mid].count > count) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/* Helper function to count a visit to entry i. Entries stay in
+ * descending order of visits: it trades places with the first entry that
+ * has as few, all of which it now outnumbers. */
+static void visit_entry(uint32_t i) {
+    uint32_t lo = first_at_most(0, i, entries[i].count);
+
+    if (lo < i) {
+        const char *a = entry_path(&entries[lo]), *b = entry_path(&entries[i]);
+        uint32_t slot_a = a ? find_slot(a, entries[lo].path_len, entries[lo].hash) : UINT32_MAX;
+        uint32_t slot_b = b ? find_slot(b, entries[i].path_len, entries[i].hash) : UINT32_MAX;
+        if (slot_a != UINT32_MAX && slot_b != UINT32_MAX) {
+            dirs_entry e = entries[lo];
+            entries[lo] = entries[i];
+            entries[i] = e;
+            dirs_bits b = bits[lo];
+            bits[lo] = bits[i];
+            bits[i] = b;
+            slots[slot_a] = i + 1;
+            slots[slot_b] = lo + 1;
+            i = lo;
+        }
+    }
+    entries[i].count++;
+    entries[i].last_used = (uint32_t)time(NULL);
+    hdr->total++;
+}
+
+/* Helper function to halve every count. Returns 1 if some are left with
+ * none, which rewriting the database drops. */
+static int age_entries(void) {
+    int emptied = 0;
+    hdr->total = 0;
+    for (uint32_t i = 0; i < hdr->num_entries; i++) {
+        entries[i].count /= 2;
+        hdr->total += entries[i].count;
+        if (entries[i].count == 0) emptied = 1;
+    }
+    return emptied;
+}
+
+int dir_jump_open(void) {
+    if (db_map) return 0;
+    if (history_store_path(db_path, sizeof(db_path), GHOST_DIR_JUMP_FILE, 1) != 0 || map_db(1) != 0) {
+        db_path[0] = '\0';
+        return -1;
+    }
+    return 0;
+}
+
+void dir_jump_add(const char *path) {
+    if (!path || path[0] != '/') return;
+    size_t len = strlen(path);
+    uint32_t hash = hash_path(path, len);
+
+    /* Under the lock of the file in place; one replaced while waiting for
+     * it is followed and locked again */
+    for (int attempt = 0; attempt < 4; attempt++) {
+        if (refresh_db() != 0 || flock(db_fd, LOCK_EX) != 0) return;
+        if (!db_current()) {
+            flock(db_fd, LOCK_UN);
+            continue;
+        }
+
+        uint32_t slot = find_slot(path, len, hash);
+        if (slot != UINT32_MAX && slots[slot] == 0) {
+            /* A new directory, once there is room for it */
+            uint32_t max_entries = hdr->max_entries, strings_max = hdr->strings_max;
+            if (hdr->num_entries == max_entries) max_entries *= 2;
+            while (len >= strings_max - hdr->strings_used && strings_max <= UINT32_MAX / 2) strings_max *= 2;
+            if (len >= strings_max - hdr->strings_used || max_entries > (1u << 28)) {
+                flock(db_fd, LOCK_UN);
+                return;
+            }
+            if (max_entries != hdr->max_entries || strings_max != hdr->strings_max) {
+                int grown = write_db(max_entries, strings_max) == 0;
+                flock(db_fd, LOCK_UN);
+                if (!grown) return;
+                continue;
+            }
+
+            uint32_t i = hdr->num_entries;
+            entries[i] = (dirs_entry){0, 0, hash, hdr->strings_used, (uint32_t)len};
+            bits[i].path = pair_bits(path, len);
+            bits[i].base = pair_bits(path + base_start(path, len), len - base_start(path, len));
+            memcpy(strings + hdr->strings_used, path, len + 1);
+            hdr->strings_used += (uint32_t)len + 1;
+            slots[slot] = i + 1;
+            hdr->num_entries = i + 1;
+            visit_entry(i);
+        } else if (slot != UINT32_MAX) {
+            visit_entry(slots[slot] - 1);
+        }
+
+        uint64_t age_at = (uint64_t)hdr->num_entries * GHOST_DIR_JUMP_AGE_AVERAGE;
+        if (hdr->total > (age_at > GHOST_DIR_JUMP_AGE_MIN ? age_at : GHOST_DIR_JUMP_AGE_MIN) && age_entries()) {
+            write_db(hdr->max_entries, hdr->strings_max);
+        }
+        flock(db_fd, LOCK_UN);
+        return;
+    }
+}
+
+double dir_jump_score(const char *path) {
+    if (!path || refresh_db() != 0) return 0;
+    size_t len = strlen(path);
+    uint32_t slot = find_slot(path, len, hash_path(path, len));
+    if (slot == UINT32_MAX || slots[slot] == 0) return 0;
+
+    const dirs_entry *e = &entries[slots[slot] - 1];
+    return (double)e->count * frecency_weight(time(NULL) - (time_t)e->last_used);
+}
+
+/* Helper function to find needle in path[from, to), ASCII case folded
+ * unless exact. Returns where it ends, or 0 if it is not there. */
+static size_t find_fragment(const char *path, size_t from, size_t to, const char *needle, size_t len, int exact) {
+    for (size_t i = from; i + len <= to; i++) {
+        size_t j = 0;
+        while (j < len && (exact ? path[i + j] == needle[j]
+                                 : fold((unsigned char)path[i + j]) == fold((unsigned char)needle[j]))) {
+            j++;
+        }
+        if (j == len) return i + len;
+    }
+    return 0;
+}
+
+/* A fragment to look for */
+typedef struct fragment {
+    const char *text;
+    size_t len;
+    int exact;              /* Has a capital, so case-sensitive */
+} fragment;
+
+/* Helper function to check whether the fragments occur in path in order,
+ * the last one in its final component */
+static int path_matches(const char *path, size_t len, const fragment *fragments, size_t num_fragments) {
+    size_t at = 0;
+    for (size_t i = 0; i < num_fragments; i++) {
+        if (i == num_fragments - 1 && base_start(path, len) > at) at = base_start(path, len);
+        at = find_fragment(path, at, len, fragments[i].text, fragments[i].len, fragments[i].exact);
+        if (at == 0) return 0;
+    }
+    return 1;
+}
+
+size_t dir_jump_search(const char *const *fragments, size_t num_fragments, const char *exclude,
+                       char **paths, double *scores, size_t max) {
+    if (max == 0 || refresh_db() != 0) return 0;
+    uint32_t *found = malloc(max * sizeof(uint32_t));
+    double *found_scores = scores ? scores : malloc(max * sizeof(double));
+    fragment *wanted = malloc((num_fragments ? num_fragments : 1) * sizeof(fragment));
+    if (!found || !found_scores || !wanted) {
+        free(found);
+        if (!scores) free(found_scores);
+        free(wanted);
+        return 0;
+    }
+
+    /* The pairs an entry needs: the last fragment's in its final component */
+    size_t num_wanted = 0;
+    uint64_t path_bits = 0, base_bits = 0;
+    for (size_t i = 0; i < num_fragments; i++) {
+        fragment *f = &wanted[num_wanted];
+        f->text = fragments[i];
+        f->len = strlen(fragments[i]);
+        if (f->len == 0) continue;
+        f->exact = 0;
+        for (size_t j = 0; j < f->len && !f->exact; j++) f->exact = f->text[j] >= 'A' && f->text[j] <= 'Z';
+        path_bits |= base_bits;
+        base_bits = pair_bits(f->text, f->len);
+        num_wanted++;
+    }
+
+    /* The shared lock keeps visits from moving entries under the scan */
+    size_t num_found = 0;
+    if (flock(db_fd, LOCK_SH) == 0) {
+        time_t now = time(NULL);
+        double top_weight = frecency_weight(0);
+        size_t exclude_len = exclude ? strlen(exclude) : 0;
+
+        /* Entries further on have no more visits, so once the worst one
+         * kept cannot be beaten with as many, the scan ends before them */
+        uint32_t end = first_at_most(0, hdr->num_entries, 0);
+        for (uint32_t i = 0; i < end; i++) {
+            if ((bits[i].base & base_bits) != base_bits || (bits[i].path & path_bits) != path_bits) continue;
+
+            const dirs_entry *e = &entries[i];
+            const char *path = entry_path(e);
+            if (!path || !path_matches(path, e->path_len, wanted, num_wanted)) continue;
+            if (exclude && e->path_len == exclude_len && memcmp(path, exclude, exclude_len) == 0) continue;
+
+            double score = e->count * frecency_weight(now - (time_t)e->last_used);
+            if (num_found == max && score <= found_scores[max - 1]) continue;
+
+            size_t at = num_found < max ? num_found++ : max - 1;
+            while (at > 0 && found_scores[at - 1] < score) {
+                found[at] = found[at - 1];
+                found_scores[at] = found_scores[at - 1];
+                at--;
+            }
+            found[at] = i;
+            found_scores[at] = score;
+            if (num_found == max) {
+                double beaten = found_scores[max - 1] / top_weight;
+                end = first_at_most(i + 1, end, beaten < UINT32_MAX ? (uint32_t)beaten : UINT32_MAX);
+            }
+        }
+
+        size_t copied = 0;
+        for (size_t i = 0; i < num_found; i++) {
+            const dirs_entry *e = &entries[found[i]];
+            const char *path = entry_path(e);
+            paths[copied] = path ? strndup(path, e->path_len) : NULL;
+            if (paths[copied]) found_scores[copied++] = found_scores[i];
+        }
+        num_found = copied;
+        flock(db_fd, LOCK_UN);
+    }
+
+    free(found);
+    if (!scores) free(found_scores);
+    free(wanted);
+    return num_found;
+}
+
+void dir_jump_close(void) {
+    unmap_db();
+    db_path[0] = '\0';
+}
@@ -0,0 +1,403 @@
+#include "dir_listing.h"
+#include "completion_cache.h"
+#include "fs_worker.h"
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+/* Cached listing of one directory */
+typedef struct listing {
+    char *path;              /* Directory as completed ("." for the current one) */
+    dir_stamp stamp;         /* Identity when it was read */
+    struct timespec checked; /* CLOCK_MONOTONIC of the last check */
+    int expired;             /* Check the directory on the next lookup */
+    dir_entry *entries;      /* Sorted by name */
+    size_t count;
+    char *pool;              /* Names and display forms */
+    unsigned long used;      /* Recency, for eviction */
+} listing;
+
+/* Listing in construction; strings are pool offsets until it is complete */
+typedef struct raw_entry {
+    size_t name;
+    size_t display;
+    int is_dir;
+} raw_entry;
+
+static listing listings[GHOST_LISTING_CACHE_SIZE];
+static unsigned long use_counter = 0;
+
+static void free_listing(listing *l) {
+    free(l->path);
+    free(l->entries);
+    free(l->pool);
+    memset(l, 0, sizeof(*l));
+}
+
+/* Helper function to make room for len more bytes in the pool */
+static char *pool_reserve(char **pool, size_t *used, size_t *cap, size_t len) {
+    if (*cap - *used < len) {
+        size_t new_cap = *cap ? *cap * 2 : 4096;
+        while (new_cap - *used < len) new_cap *= 2;
+        char *new_pool = realloc(*pool, new_cap);
+        if (!new_pool) return NULL;
+        *pool = new_pool;
+        *cap = new_cap;
+    }
+    return *pool + *used;
+}
+
+static int compare_entries(const void *a, const void *b) {
+    return strcmp(((const dir_entry *)a)->name, ((const dir_entry *)b)->name);
+}
+
+/* Listing being read */
+typedef struct listing_builder {
+    int dir_fd;
+    raw_entry *raw;
+    size_t count;
+    size_t raw_cap;
+    char *pool;
+    size_t pool_used;
+    size_t pool_cap;
+} listing_builder;
+
+/* Helper function to add one directory entry. The type comes from d_type;
+ * only symlinks and DT_UNKNOWN cost an fstatat on the directory fd. */
+static int add_entry(listing_builder *b, const char *name, unsigned char type) {
+    int is_dir = type == DT_DIR;
+    if (type == DT_LNK || type == DT_UNKNOWN) {
+        struct stat st;
+        is_dir = fstatat(b->dir_fd, name, &st, 0) == 0 && S_ISDIR(st.st_mode);
+    }
+
+    size_t len = strlen(name);
+    size_t spaces = 0;
+    for (const char *p = name; *p; p++) {
+        if (*p == ' ') spaces++;
+    }
+
+    if (b->count == b->raw_cap) {
+        size_t new_cap = b->raw_cap ? b->raw_cap * 2 : 64;
+        raw_entry *new_raw = realloc(b->raw, new_cap * sizeof(raw_entry));
+        if (!new_raw) return -1;
+        b->raw = new_raw;
+        b->raw_cap = new_cap;
+    }
+
+    /* Name, then the display form with spaces escaped */
+    char *out = pool_reserve(&b->pool, &b->pool_used, &b->pool_cap, 2 * len + spaces + 3);
+    if (!out) return -1;
+    raw_entry *r = &b->raw[b->count++];
+    r->name = b->pool_used;
+    memcpy(out, name, len + 1);
+    out += len + 1;
+    r->display = b->pool_used + len + 1;
+    for (const char *p = name; *p; p++) {
+        if (*p == ' ') *out++ = '\\';
+        *out++ = *p;
+    }
+    if (is_dir) *out++ = '/';
+    *out++ = '\0';
+    r->is_dir = is_dir;
+    b->pool_used = (size_t)(out - b->pool);
+    return 0;
+}
+
+#ifdef __linux__
+/* Record layout returned by getdents64 */
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+/* Helper function to read the entries straight from the kernel in large
+ * batches, without the per-entry overhead of readdir */
+static int read_entries(listing_builder *b) {
+    char buf[GHOST_DIRENT_BUFFER_SIZE] __attribute__((aligned(8)));
+    for (;;) {
+        long n = syscall(SYS_getdents64, b->dir_fd, buf, sizeof(buf));
+        if (n < 0) return -1;
+        if (n == 0) return 0;
+        for (long pos = 0; pos < n; ) {
+            const struct linux_dirent64 *d = (const struct linux_dirent64 *)(buf + pos);
+            if (add_entry(b, d->d_name, d->d_type) != 0) return -1;
+            pos += d->d_reclen;
+        }
+    }
+}
+#else
+static int read_entries(listing_builder *b) {
+    int fd = dup(b->dir_fd);
+    DIR *d = fd >= 0 ? fdopendir(fd) : NULL;
+    if (!d) {
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    struct dirent *entry;
+    int status = 0;
+    while (status == 0 && (entry = readdir(d)) != NULL) {
+        status = add_entry(b, entry->d_name, entry->d_type);
+    }
+    closedir(d);
+    return status;
+}
+#endif
+
+/* Helper function to read a directory into l */
+static int read_listing(listing *l, const char *path) {
+    listing_builder b = {0};
+    b.dir_fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (b.dir_fd < 0) return -1;
+
+    struct stat st;
+    int failed = fstat(b.dir_fd, &st) != 0 || read_entries(&b) != 0;
+    close(b.dir_fd);
+
+    dir_entry *entries = failed ? NULL : malloc((b.count ? b.count : 1) * sizeof(dir_entry));
+    l->path = failed ? NULL : strdup(path);
+    if (!entries || !l->path) {
+        free(entries);
+        free(l->path);
+        free(b.raw);
+        free(b.pool);
+        l->path = NULL;
+        return -1;
+    }
+
+    /* The pool no longer moves, so offsets can become pointers */
+    for (size_t i = 0; i < b.count; i++) {
+        entries[i].name = b.pool + b.raw[i].name;
+        entries[i].display = b.pool + b.raw[i].display;
+        entries[i].is_dir = b.raw[i].is_dir;
+    }
+    free(b.raw);
+    qsort(entries, b.count, sizeof(dir_entry), compare_entries);
+
+    dir_stamp_from_stat(&l->stamp, &st);
+    l->entries = entries;
+    l->count = b.count;
+    l->pool = b.pool;
+    return 0;
+}
+
+static int same_stamp(const dir_stamp *a, const dir_stamp *b) {
+    return a->dev == b->dev && a->ino == b->ino &&
+           a->mtime.tv_sec == b->mtime.tv_sec && a->mtime.tv_nsec == b->mtime.tv_nsec;
+}
+
+/* Revalidation or read of one directory, run on a filesystem worker */
+typedef struct listing_task {
+    char *path;
+    unsigned long cwd_changes;  /* cwd_changes when it started */
+    int have_old;          /* A listing exists; check old_stamp first */
+    dir_stamp old_stamp;
+    int unchanged;         /* The directory still has old_stamp */
+    int failed;            /* The directory could not be read */
+    listing result;        /* New listing unless unchanged or failed */
+} listing_task;
+
+/* Task that missed its deadline on an earlier Tab */
+static fs_task *pending = NULL;
+static listing_task *pending_arg = NULL;
+
+/* Times the current directory changed; a relative path read before a
+ * change may have listed the old directory */
+static unsigned long cwd_changes = 0;
+
+/* Helper function to tell whether a task's result still belongs to its
+ * path */
+static int task_current(const listing_task *t) {
+    return t->path[0] == '/' || t->cwd_changes == cwd_changes;
+}
+
+static void run_listing_task(void *arg) {
+    listing_task *t = arg;
+    if (t->have_old) {
+        struct stat st;
+        dir_stamp stamp;
+        if (stat(t->path, &st) == 0) {
+            dir_stamp_from_stat(&stamp, &st);
+            if (same_stamp(&stamp, &t->old_stamp)) {
+                t->unchanged = 1;
+                return;
+            }
+        }
+    }
+    t->failed = read_listing(&t->result, t->path) != 0;
+}
+
+static void free_listing_task(void *arg) {
+    listing_task *t = arg;
+    free_listing(&t->result);
+    free(t->path);
+    free(t);
+}
+
+static listing *find_listing(const char *path) {
+    for (size_t i = 0; i < GHOST_LISTING_CACHE_SIZE; i++) {
+        if (listings[i].path && strcmp(listings[i].path, path) == 0) {
+            return &listings[i];
+        }
+    }
+    return NULL;
+}
+
+/* Helper function to store the outcome of a finished task in the cache.
+ * Returns the listing, or NULL if the directory could not be read. */
+static listing *apply_task(listing_task *t, const struct timespec *now) {
+    listing *l = find_listing(t->path);
+    if (t->unchanged) {
+        if (!l) return NULL;  /* Evicted in the meantime */
+    } else if (t->failed) {
+        if (l) free_listing(l);
+        return NULL;
+    } else {
+        if (!l) {
+            /* Take a free slot, or the least recently used one */
+            l = &listings[0];
+            for (size_t i = 0; i < GHOST_LISTING_CACHE_SIZE && l->path; i++) {
+                if (!listings[i].path || listings[i].used < l->used) l = &listings[i];
+            }
+        }
+        free_listing(l);
+        *l = t->result;
+        memset(&t->result, 0, sizeof(t->result));
+    }
+    l->checked = *now;
+    l->expired = 0;
+    return l;
+}
+
+/* Helper function to drop the pending task, applying it if it finished */
+static void drop_pending(const struct timespec *now) {
+    if (task_current(pending_arg) && fs_task_wait(pending, 1)) {
+        apply_task(pending_arg, now);
+    }
+    fs_task_release(pending);
+    pending = NULL;
+    pending_arg = NULL;
+}
+
+const dir_entry *dir_listing_get(const char *path, size_t *count, int *stale) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    *count = 0;
+    *stale = 0;
+
+    listing *l = find_listing(path);
+    if (l) {
+        long age_ms = (now.tv_sec - l->checked.tv_sec) * 1000 +
+                      (now.tv_nsec - l->checked.tv_nsec) / 1000000;
+        if (!l->expired && age_ms < GHOST_LISTING_TTL_MS) {
+            l->used = ++use_counter;
+            *count = l->count;
+            return l->entries;
+        }
+    }
+
+    /* The directory has to be checked or read. That happens on a worker so
+     * a hung mount cannot freeze the line editor; a task still running from
+     * an earlier Tab gets only a quick look instead of a new deadline. */
+    long deadline = fs_deadline_ms();
+    if (pending && (strcmp(pending_arg->path, path) != 0 || !task_current(pending_arg))) {
+        drop_pending(&now);
+    }
+    listing_task *task = pending_arg;
+    if (pending) {
+        deadline = 1;
+    } else {
+        task = calloc(1, sizeof(listing_task));
+        if (!task || !(task->path = strdup(path))) {
+            free(task);
+            return NULL;
+        }
+        task->cwd_changes = cwd_changes;
+        if (l) {
+            task->have_old = 1;
+            task->old_stamp = l->stamp;
+        }
+        pending = fs_task_start(run_listing_task, task, free_listing_task);
+        pending_arg = pending ? task : NULL;
+        if (!pending) run_listing_task(task);  /* No worker: do it here */
+    }
+
+    if (pending && !fs_task_wait(pending, deadline)) {
+        /* Out of time: what the cache has is all there is */
+        *stale = 1;
+        l = find_listing(path);
+        if (!l) return NULL;
+        l->used = ++use_counter;
+        *count = l->count;
+        return l->entries;
+    }
+
+    l = apply_task(task, &now);
+    if (pending) {
+        fs_task_release(pending);
+        pending = NULL;
+        pending_arg = NULL;
+    } else {
+        free_listing_task(task);
+    }
+    if (!l) return NULL;
+    l->used = ++use_counter;
+    *count = l->count;
+    return l->entries;
+}
+
+size_t dir_listing_prefix(const dir_entry *entries, size_t count, const char *prefix, size_t *first) {
+    size_t len = strlen(prefix);
+
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (strncmp(entries[mid].name, prefix, len) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    size_t end = lo;
+    while (end < count && strncmp(entries[end].name, prefix, len) == 0) {
+        end++;
+    }
+    *first = lo;
+    return end - lo;
+}
+
+void dir_listing_expire(void) {
+    for (size_t i = 0; i < GHOST_LISTING_CACHE_SIZE; i++) {
+        listings[i].expired = 1;
+    }
+}
+
+void dir_listing_chdir(void) {
+    cwd_changes++;
+    for (size_t i = 0; i < GHOST_LISTING_CACHE_SIZE; i++) {
+        if (listings[i].path && listings[i].path[0] != '/') free_listing(&listings[i]);
+    }
+}
+
+void dir_listing_cleanup(void) {
+    if (pending) {
+        fs_task_release(pending);
+        pending = NULL;
+        pending_arg = NULL;
+    }
+    for (size_t i = 0; i < GHOST_LISTING_CACHE_SIZE; i++) {
+        free_listing(&listings[i]);
+    }
+    use_counter = 0;
+}
@@ -0,0 +1,199 @@
+#include "frecency.h"
+#include "history_store.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Use count and last use of one key */
+typedef struct frecency_entry {
+    frecency_kind kind;
+    char *key;
+    unsigned long count;
+    unsigned long added;          /* Uses counted in this session */
+    time_t last_used;
+    int saved;                    /* Written out by frecency_save */
+    struct frecency_entry *next;  /* Next entry in the bucket chain */
+} frecency_entry;
+
+static frecency_entry **buckets = NULL;
+static size_t num_buckets = 0;
+static size_t num_entries = 0;
+
+/* FNV-1a string hash, mixed with the kind */
+static size_t hash_key(frecency_kind kind, const char *key) {
+    size_t h = 2166136261u ^ (size_t)kind;
+    for (const unsigned char *p = (const unsigned char *)key; *p; p++) {
+        h ^= *p;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* Helper function to double the bucket array once the load factor hits 3/4 */
+static int grow_buckets(void) {
+    size_t new_size = num_buckets ? num_buckets * 2 : 64;
+    frecency_entry **new_buckets = calloc(new_size, sizeof(frecency_entry *));
+    if (!new_buckets) return -1;
+
+    for (size_t i = 0; i < num_buckets; i++) {
+        frecency_entry *e = buckets[i];
+        while (e) {
+            frecency_entry *next = e->next;
+            size_t slot = hash_key(e->kind, e->key) & (new_size - 1);
+            e->next = new_buckets[slot];
+            new_buckets[slot] = e;
+            e = next;
+        }
+    }
+
+    free(buckets);
+    buckets = new_buckets;
+    num_buckets = new_size;
+    return 0;
+}
+
+static frecency_entry *find_entry(frecency_kind kind, const char *key) {
+    if (!buckets) return NULL;
+    frecency_entry *e = buckets[hash_key(kind, key) & (num_buckets - 1)];
+    while (e && (e->kind != kind || strcmp(e->key, key) != 0)) {
+        e = e->next;
+    }
+    return e;
+}
+
+/* Helper function to find or create the entry of key */
+static frecency_entry *get_entry(frecency_kind kind, const char *key) {
+    frecency_entry *e = find_entry(kind, key);
+    if (!e) {
+        if (num_entries + 1 > num_buckets / 4 * 3 && grow_buckets() != 0) return NULL;
+        e = calloc(1, sizeof(frecency_entry));
+        if (!e) return NULL;
+        e->key = strdup(key);
+        if (!e->key) {
+            free(e);
+            return NULL;
+        }
+        e->kind = kind;
+        size_t slot = hash_key(kind, key) & (num_buckets - 1);
+        e->next = buckets[slot];
+        buckets[slot] = e;
+        num_entries++;
+    }
+    return e;
+}
+
+void frecency_add(frecency_kind kind, const char *key) {
+    if (!key || !*key) return;
+
+    frecency_entry *e = get_entry(kind, key);
+    if (!e) return;
+    e->count++;
+    e->added++;
+    e->last_used = time(NULL);
+}
+
+double frecency_score(frecency_kind kind, const char *key) {
+    const frecency_entry *e = find_entry(kind, key);
+    if (!e) return 0;
+
+    return (double)e->count * frecency_weight(time(NULL) - e->last_used);
+}
+
+double frecency_weight(time_t age) {
+    return age < 3600 ? 4 : age < 86400 ? 2 : age < 604800 ? 0.5 : 0.25;
+}
+
+/* Path of the saved counts; empty until frecency_load */
+static char save_path[PATH_MAX];
+
+/* Helper function to parse a saved line, "<count> <last used> <command>".
+ * Returns the command, or NULL for a line that does not parse. */
+static char *parse_line(char *line, unsigned long *count, long long *last_used) {
+    line[strcspn(line, "\n")] = '\0';
+    int offset = 0;
+    if (sscanf(line, "%lu %lld %n", count, last_used, &offset) != 2 || offset == 0 || !line[offset]) {
+        return NULL;
+    }
+    return line + offset;
+}
+
+void frecency_load(void) {
+    if (history_store_path(save_path, sizeof(save_path), GHOST_FRECENCY_FILE, 1) != 0) {
+        save_path[0] = '\0';
+        return;
+    }
+    FILE *fp = fopen(save_path, "r");
+    if (!fp) return;
+
+    char line[PATH_MAX + 64];
+    unsigned long count;
+    long long last_used;
+    while (fgets(line, sizeof(line), fp)) {
+        char *key = parse_line(line, &count, &last_used);
+        frecency_entry *e = key ? get_entry(FRECENCY_COMMAND, key) : NULL;
+        if (!e) continue;
+        e->count += count;
+        if ((time_t)last_used > e->last_used) e->last_used = (time_t)last_used;
+    }
+    fclose(fp);
+}
+
+void frecency_save(void) {
+    if (!save_path[0]) return;
+
+    char tmp[PATH_MAX];
+    if (snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", save_path, (long)getpid()) >= (int)sizeof(tmp)) return;
+    FILE *out = fopen(tmp, "w");
+    if (!out) return;
+
+    /* Another shell may have saved since this one loaded: start from the
+     * file as it is now and add only this session's uses */
+    FILE *in = fopen(save_path, "r");
+    if (in) {
+        char line[PATH_MAX + 64];
+        unsigned long count;
+        long long last_used;
+        while (fgets(line, sizeof(line), in)) {
+            char *key = parse_line(line, &count, &last_used);
+            if (!key) continue;
+            frecency_entry *e = find_entry(FRECENCY_COMMAND, key);
+            if (e && !e->saved) {
+                count += e->added;
+                if (e->last_used > (time_t)last_used) last_used = (long long)e->last_used;
+                e->saved = 1;
+            }
+            fprintf(out, "%lu %lld %s\n", count, last_used, key);
+        }
+        fclose(in);
+    }
+    for (size_t i = 0; i < num_buckets; i++) {
+        for (frecency_entry *e = buckets[i]; e; e = e->next) {
+            if (e->kind != FRECENCY_COMMAND || e->saved || e->count == 0 || strchr(e->key, '\n')) continue;
+            fprintf(out, "%lu %lld %s\n", e->count, (long long)e->last_used, e->key);
+            e->saved = 1;
+        }
+    }
+
+    int ok = fflush(out) == 0;
+    ok = fclose(out) == 0 && ok;
+    if (!ok || rename(tmp, save_path) != 0) unlink(tmp);
+}
+
+void frecency_cleanup(void) {
+    for (size_t i = 0; i < num_buckets; i++) {
+        frecency_entry *e = buckets[i];
+        while (e) {
+            frecency_entry *next = e->next;
+            free(e->key);
+            free(e);
+            e = next;
+        }
+    }
+    free(buckets);
+    buckets = NULL;
+    num_buckets = num_entries = 0;
+    save_path[0] = '\0';
+}
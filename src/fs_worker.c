@@ -0,0 +1,164 @@
+#include "fs_worker.h"
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <time.h>
+
+struct fs_task {
+    fs_task_fn fn;
+    void *arg;
+    void (*free_arg)(void *);
+    int done;              /* fn has returned */
+    int released;          /* The caller has given up on it */
+    struct fs_task *next;  /* Next task in the queue */
+};
+
+/* Worker pool state, protected by pool_lock */
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done_cond;
+static pthread_once_t done_cond_once = PTHREAD_ONCE_INIT;
+static fs_task *queue_head = NULL;
+static fs_task *queue_tail = NULL;
+static int num_workers = 0;
+static int idle_workers = 0;
+
+long fs_deadline_ms(void) {
+    const char *value = getenv("GHSH_FS_DEADLINE_MS");
+    if (!value || !*value) return GHOST_FS_DEADLINE_MS;
+    char *end;
+    long ms = strtol(value, &end, 10);
+    return (*end == '\0' && ms >= 0) ? ms : GHOST_FS_DEADLINE_MS;
+}
+
+/* Deadlines are measured on the monotonic clock where a condition
+ * variable can use it; macOS has no pthread_condattr_setclock, so there
+ * they fall back to the wall clock */
+#ifdef __APPLE__
+#define DONE_COND_CLOCK CLOCK_REALTIME
+#else
+#define DONE_COND_CLOCK CLOCK_MONOTONIC
+#endif
+
+static void init_done_cond(void) {
+#ifdef __APPLE__
+    pthread_cond_init(&done_cond, NULL);
+#else
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, DONE_COND_CLOCK);
+    pthread_cond_init(&done_cond, &attr);
+    pthread_condattr_destroy(&attr);
+#endif
+}
+
+static void *worker_main(void *unused) {
+    (void)unused;
+    pthread_mutex_lock(&pool_lock);
+    for (;;) {
+        idle_workers++;
+        while (!queue_head) {
+            pthread_cond_wait(&queue_cond, &pool_lock);
+        }
+        idle_workers--;
+
+        fs_task *task = queue_head;
+        queue_head = task->next;
+        if (!queue_head) queue_tail = NULL;
+        pthread_mutex_unlock(&pool_lock);
+
+        /* May block for as long as the filesystem does */
+        task->fn(task->arg);
+
+        pthread_mutex_lock(&pool_lock);
+        task->done = 1;
+        if (task->released) {
+            if (task->free_arg) task->free_arg(task->arg);
+            free(task);
+        }
+        pthread_cond_broadcast(&done_cond);
+    }
+    return NULL;
+}
+
+fs_task *fs_task_start(fs_task_fn fn, void *arg, void (*free_arg)(void *)) {
+    pthread_once(&done_cond_once, init_done_cond);
+
+    fs_task *task = calloc(1, sizeof(fs_task));
+    if (!task) return NULL;
+    task->fn = fn;
+    task->arg = arg;
+    task->free_arg = free_arg;
+
+    pthread_mutex_lock(&pool_lock);
+
+    /* Every worker may be stuck on a hung mount; add one while allowed */
+    if (idle_workers == 0 && num_workers < GHOST_FS_MAX_WORKERS) {
+        pthread_t thread;
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+        /* Started with every signal blocked, so they keep going to the
+         * main thread */
+        sigset_t all, old;
+        sigfillset(&all);
+        pthread_sigmask(SIG_SETMASK, &all, &old);
+        if (pthread_create(&thread, &attr, worker_main, NULL) == 0) {
+            num_workers++;
+        }
+        pthread_sigmask(SIG_SETMASK, &old, NULL);
+        pthread_attr_destroy(&attr);
+    }
+    if (num_workers == 0) {
+        pthread_mutex_unlock(&pool_lock);
+        free(task);
+        return NULL;
+    }
+
+    if (queue_tail) {
+        queue_tail->next = task;
+    } else {
+        queue_head = task;
+    }
+    queue_tail = task;
+    pthread_cond_signal(&queue_cond);
+    pthread_mutex_unlock(&pool_lock);
+    return task;
+}
+
+int fs_task_wait(fs_task *task, long ms) {
+    struct timespec deadline;
+    clock_gettime(DONE_COND_CLOCK, &deadline);
+    deadline.tv_sec += ms / 1000;
+    deadline.tv_nsec += (ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&pool_lock);
+    while (!task->done) {
+        if (ms == 0) {
+            pthread_cond_wait(&done_cond, &pool_lock);
+        } else if (pthread_cond_timedwait(&done_cond, &pool_lock, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    int done = task->done;
+    pthread_mutex_unlock(&pool_lock);
+    return done;
+}
+
+void fs_task_release(fs_task *task) {
+    if (!task) return;
+    pthread_mutex_lock(&pool_lock);
+    if (task->done) {
+        if (task->free_arg) task->free_arg(task->arg);
+        free(task);
+    } else {
+        task->released = 1;
+    }
+    pthread_mutex_unlock(&pool_lock);
+}
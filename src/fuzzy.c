@@ -0,0 +1,211 @@
+#include "fuzzy.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Scoring as in fzy: a match gets a bonus depending on what precedes it,
+ * runs of consecutive characters are rewarded and every skipped character
+ * costs a little (less before the first match and after the last) */
+#define SCORE_MIN (-1e9)
+#define SCORE_MAX 1e9
+#define SCORE_GAP_LEADING (-0.005)
+#define SCORE_GAP_TRAILING (-0.005)
+#define SCORE_GAP_INNER (-0.01)
+#define SCORE_MATCH_CONSECUTIVE 1.0
+#define SCORE_MATCH_SLASH 0.9
+#define SCORE_MATCH_WORD 0.8
+#define SCORE_MATCH_CAPITAL 0.7
+#define SCORE_MATCH_DOT 0.6
+
+/* ASCII-only case helpers; the locale-aware ctype calls are too slow for
+ * the scoring loop */
+static int is_lower(char c) { return c >= 'a' && c <= 'z'; }
+static int is_upper(char c) { return c >= 'A' && c <= 'Z'; }
+static int is_alnum(char c) { return is_lower(c) || is_upper(c) || (c >= '0' && c <= '9'); }
+static char to_lower(char c) { return is_upper(c) ? (char)(c + 'a' - 'A') : c; }
+
+int fuzzy_compile(fuzzy_pattern *pattern, const char *text) {
+    size_t len = strlen(text);
+    if (len == 0 || len > GHOST_FUZZY_MAX_PATTERN) return -1;
+
+    memcpy(pattern->text, text, len + 1);
+    pattern->len = len;
+
+    /* Smart case: a capital asks for an exact-case match */
+    pattern->ignore_case = 1;
+    for (size_t i = 0; i < len; i++) {
+        if (is_upper(text[i])) pattern->ignore_case = 0;
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        char c = text[i];
+        pattern->accept[i][0] = c;
+        pattern->accept[i][1] = '\0';
+        pattern->accept[i][2] = '\0';
+        if (pattern->ignore_case && is_lower(c)) {
+            pattern->accept[i][1] = (char)(c - 'a' + 'A');
+        }
+    }
+    return 0;
+}
+
+int fuzzy_has_match(const fuzzy_pattern *pattern, const char *candidate) {
+    /* strpbrk is vectorized in the C library, so a candidate missing the
+     * first character is rejected at a few bytes per cycle */
+    const char *p = candidate;
+    for (size_t i = 0; i < pattern->len; i++) {
+        p = strpbrk(p, pattern->accept[i]);
+        if (!p) return 0;
+        p++;
+    }
+    return 1;
+}
+
+/* Helper function to give the bonus for matching ch after last */
+static double match_bonus(char last, char ch) {
+    if (!is_alnum(ch)) return 0;
+    if (last == '/') return SCORE_MATCH_SLASH;
+    if (last == '-' || last == '_' || last == ' ') return SCORE_MATCH_WORD;
+    if (last == '.') return SCORE_MATCH_DOT;
+    if (is_lower(last) && is_upper(ch)) return SCORE_MATCH_CAPITAL;
+    return 0;
+}
+
+double fuzzy_score(const fuzzy_pattern *pattern, const char *candidate) {
+    size_t n = pattern->len;
+    size_t m = strlen(candidate);
+
+    /* A match of the same length is the candidate itself */
+    if (n == m) return SCORE_MAX;
+    if (m > GHOST_FUZZY_MAX_CANDIDATE) return SCORE_MIN;
+
+    /* Candidate characters in the case the pattern is compared in */
+#define TEXT(j) (pattern->ignore_case ? to_lower(candidate[j]) : candidate[j])
+
+    /* Pattern character i can only be matched between its leftmost and
+     * rightmost position in any complete match; the rest of the table is
+     * never needed */
+    size_t lo[GHOST_FUZZY_MAX_PATTERN], hi[GHOST_FUZZY_MAX_PATTERN];
+    size_t j = 0;
+    for (size_t i = 0; i < n; i++) {
+        while (j < m && TEXT(j) != pattern->text[i]) j++;
+        if (j == m) return SCORE_MIN;  /* Not a match after all */
+        lo[i] = j++;
+    }
+    j = m;
+    for (size_t i = n; i-- > 0; ) {
+        while (TEXT(j - 1) != pattern->text[i]) j--;
+        hi[i] = --j;
+    }
+
+    /* D: best score ending with a match at j; M: best score up to j.
+     * Only the previous row of each is needed. */
+    double d_rows[2][GHOST_FUZZY_MAX_CANDIDATE];
+    double m_rows[2][GHOST_FUZZY_MAX_CANDIDATE];
+    double *d_prev = d_rows[0], *d_cur = d_rows[1];
+    double *m_prev = m_rows[0], *m_cur = m_rows[1];
+
+    for (size_t i = 0; i < n; i++) {
+        double prev_score = SCORE_MIN;
+        double gap_score = i == n - 1 ? SCORE_GAP_TRAILING : SCORE_GAP_INNER;
+        size_t end = i == n - 1 ? m : hi[i + 1];
+
+        for (j = lo[i]; j < end; j++) {
+            if (j <= hi[i] && TEXT(j) == pattern->text[i]) {
+                double bonus = match_bonus(j > 0 ? candidate[j - 1] : '/', candidate[j]);
+                double score;
+                if (i == 0) {
+                    score = (double)j * SCORE_GAP_LEADING + bonus;
+                } else {
+                    double a = m_prev[j - 1] + bonus;
+                    double b = d_prev[j - 1] + SCORE_MATCH_CONSECUTIVE;
+                    score = a > b ? a : b;
+                }
+                d_cur[j] = score;
+                prev_score = score > prev_score + gap_score ? score : prev_score + gap_score;
+            } else {
+                d_cur[j] = SCORE_MIN;
+                prev_score = prev_score + gap_score;
+            }
+            m_cur[j] = prev_score;
+        }
+
+        double *t = d_prev; d_prev = d_cur; d_cur = t;
+        t = m_prev; m_prev = m_cur; m_cur = t;
+    }
+    return m_prev[m - 1];
+#undef TEXT
+}
+
+/* Best first; ties go to the shorter, then the alphabetically first name */
+static int better(const fuzzy_match *x, const fuzzy_match *y) {
+    if (x->score != y->score) return x->score > y->score;
+    if (x->length != y->length) return x->length < y->length;
+    return strcmp(x->candidate, y->candidate) < 0;
+}
+
+static int compare_matches(const void *a, const void *b) {
+    return better(a, b) ? -1 : better(b, a) ? 1 : 0;
+}
+
+/* Helper function to restore the heap below pos; the worst match of the
+ * heap is at its root */
+static void sift_down(fuzzy_match *heap, size_t count, size_t pos) {
+    for (;;) {
+        size_t worst = pos, left = 2 * pos + 1, right = left + 1;
+        if (left < count && better(&heap[worst], &heap[left])) worst = left;
+        if (right < count && better(&heap[worst], &heap[right])) worst = right;
+        if (worst == pos) return;
+        fuzzy_match t = heap[pos];
+        heap[pos] = heap[worst];
+        heap[worst] = t;
+        pos = worst;
+    }
+}
+
+static void sift_up(fuzzy_match *heap, size_t pos) {
+    while (pos > 0) {
+        size_t parent = (pos - 1) / 2;
+        if (!better(&heap[parent], &heap[pos])) return;
+        fuzzy_match t = heap[pos];
+        heap[pos] = heap[parent];
+        heap[parent] = t;
+        pos = parent;
+    }
+}
+
+size_t fuzzy_rank(const fuzzy_pattern *pattern, const char *const *candidates, size_t count,
+                  fuzzy_bonus_fn bonus, void *arg, fuzzy_match **matches) {
+    /* Keep the best GHOST_FUZZY_MAX_RESULTS in a heap rooted at the worst,
+     * so a short pattern matching most candidates costs no full sort */
+    fuzzy_match *heap = malloc(GHOST_FUZZY_MAX_RESULTS * sizeof(fuzzy_match));
+    size_t num_kept = 0;
+    *matches = NULL;
+    if (!heap) return 0;
+
+    for (size_t i = 0; i < count; i++) {
+        if (!fuzzy_has_match(pattern, candidates[i])) continue;
+
+        fuzzy_match match;
+        match.index = i;
+        match.candidate = candidates[i];
+        match.length = strlen(candidates[i]);
+        match.score = fuzzy_score(pattern, candidates[i]);
+        if (bonus) match.score += bonus(candidates[i], arg);
+
+        if (num_kept < GHOST_FUZZY_MAX_RESULTS) {
+            heap[num_kept] = match;
+            sift_up(heap, num_kept++);
+        } else if (better(&match, &heap[0])) {
+            heap[0] = match;
+            sift_down(heap, num_kept, 0);
+        }
+    }
+
+    if (num_kept == 0) {
+        free(heap);
+        return 0;
+    }
+    qsort(heap, num_kept, sizeof(fuzzy_match), compare_matches);
+    *matches = heap;
+    return num_kept;
+}
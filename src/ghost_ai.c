@@ -1,6 +1,8 @@
 #include "ghost_shell.h"
 #include "ghost_ai.h"
 #include "json_parser.h"
+#include "launcher.h"
+#include "history_journal.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -9,6 +11,7 @@
 #include <readline/history.h>
 #include <sys/select.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <termios.h>
 #include <sys/time.h>
 #include <ctype.h>
@@ -624,36 +627,58 @@ void ghost_ai_display_command(const char *command, char *modified_command, size_
     fflush(stdout);
 }
 
-/* Capture the output of a command execution */
-char *ghost_ai_capture_command_output(const char *command, ghost_ai_context *ai_ctx) {
-    FILE *fp;
+/* Capture the output of a command execution. The command line runs through
+ * the shell's own parser and executor with stdout pointed at an anonymous
+ * file, so lists and builtins work and state such as cd persists. Pipelines
+ * with redirections such as 2>&1 or other syntax the parser lacks are
+ * handed to /bin/sh -c by parse_command, as popen did. */
+char *ghost_ai_capture_command_output(const char *command, ghost_ai_context *ai_ctx,
+                                      struct shell_context *shell_ctx) {
     char *output = NULL;
     size_t total_size = 0;
     char buffer[4096];
+    ssize_t bytes_read;
 
-    fp = popen(command, "r");
-    if (fp == NULL) {
+    ghost_command *cmd = parse_command(command);
+    if (!cmd) return NULL;
+
+    int out_fd = anon_file_create("ghost-ai-output");
+    if (out_fd == -1) {
         fprintf(stderr, "Failed to run command: %s\n", command);
+        free_command(cmd);
         return NULL;
     }
 
-    while (!feof(fp)) {
-        size_t bytes_read = fread(buffer, 1, sizeof(buffer) - 1, fp);
-        if (bytes_read > 0) {
-            char *new_output = realloc(output, total_size + bytes_read + 1);
-            if (new_output == NULL) {
-                free(output);
-                pclose(fp);
-                return NULL;
-            }
-            output = new_output;
-            memcpy(output + total_size, buffer, bytes_read);
-            total_size += bytes_read;
-            output[total_size] = '\0';
-        }
+    fflush(stdout);
+    int saved_stdout = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
+    if (saved_stdout == -1 || dup2(out_fd, STDOUT_FILENO) == -1) {
+        fprintf(stderr, "Failed to run command: %s\n", command);
+        if (saved_stdout != -1) close(saved_stdout);
+        close(out_fd);
+        free_command(cmd);
+        return NULL;
     }
 
-    pclose(fp);
+    execute_command(cmd, shell_ctx);
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdout);
+    free_command(cmd);
+
+    lseek(out_fd, 0, SEEK_SET);
+    while ((bytes_read = read(out_fd, buffer, sizeof(buffer))) > 0) {
+        char *new_output = realloc(output, total_size + bytes_read + 1);
+        if (new_output == NULL) {
+            free(output);
+            close(out_fd);
+            return NULL;
+        }
+        output = new_output;
+        memcpy(output + total_size, buffer, bytes_read);
+        total_size += bytes_read;
+        output[total_size] = '\0';
+    }
+    close(out_fd);
 
     if (output && ai_ctx && ai_ctx->history) {
         ghost_ai_add_to_history(ai_ctx, MESSAGE_COMMAND_OUTPUT, output);
@@ -674,12 +699,10 @@ void ghost_ai_execute_commands(char **commands, size_t cmd_count, struct shell_c
         /* Add command to shell history */
         if (hist && modified_command[0] != '\0') {
             history(hist, &ev, H_ENTER, modified_command);
-            if (shell_ctx->history_file) {
-                history(hist, &ev, H_SAVE, shell_ctx->history_file);
-            }
+            history_journal_append(modified_command);
         }
         
-        output = ghost_ai_capture_command_output(modified_command, shell_ctx->ai_ctx);
+        output = ghost_ai_capture_command_output(modified_command, shell_ctx->ai_ctx, shell_ctx);
         if (output) {
             printf("%s", output);
             if (ghost_ai_analyze_and_followup(shell_ctx->last_prompt, output,
@@ -0,0 +1,397 @@
+#include "git_refs.h"
+#include "completion_cache.h"
+#include "fs_worker.h"
+#include <sys/stat.h>
+#include <dirent.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* A file or directory a list of refs was read from */
+typedef struct ref_source {
+    char *path;
+    int exists;
+    dir_stamp stamp;
+} ref_source;
+
+/* Names of one kind, with what they were read from */
+typedef struct ref_list {
+    int loaded;
+    command_index names;
+    ref_source *sources;
+    size_t num_sources;
+} ref_list;
+
+/* Cached refs of one repository */
+typedef struct repo_refs {
+    char *git_dir;          /* Directory holding refs and config */
+    ref_list lists[GIT_REF_KINDS];
+    unsigned long used;     /* Recency, for eviction */
+} repo_refs;
+
+/* Names collected while reading a list */
+typedef struct name_list {
+    char **names;
+    size_t count;
+    size_t cap;
+} name_list;
+
+static repo_refs repos[GHOST_GIT_REPO_CACHE_SIZE];
+static unsigned long use_counter = 0;
+
+/* Lookup run on a filesystem worker. The cache belongs to the worker
+ * until the task is done. */
+typedef struct refs_task {
+    git_ref_kind kind;
+    char *git_dir_env;              /* $GIT_DIR, read on the main thread */
+    const command_index *result;
+} refs_task;
+
+/* Lookup that missed its deadline on an earlier Tab */
+static fs_task *pending = NULL;
+
+static void free_list(ref_list *list) {
+    command_index_free(&list->names);
+    for (size_t i = 0; i < list->num_sources; i++) {
+        free(list->sources[i].path);
+    }
+    free(list->sources);
+    memset(list, 0, sizeof(*list));
+}
+
+static void free_repo(repo_refs *repo) {
+    free(repo->git_dir);
+    for (int k = 0; k < GIT_REF_KINDS; k++) {
+        free_list(&repo->lists[k]);
+    }
+    memset(repo, 0, sizeof(*repo));
+}
+
+/* Helper function to read the first line of a small file */
+static int read_line(const char *path, char *buf, size_t size) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) return -1;
+    char *line = fgets(buf, (int)size, fp);
+    fclose(fp);
+    if (!line) return -1;
+    buf[strcspn(buf, "\r\n")] = '\0';
+    return 0;
+}
+
+/* Helper function to resolve a path relative to base */
+static int join_path(char *buf, size_t size, const char *base, const char *path) {
+    int n = path[0] == '/' ? snprintf(buf, size, "%s", path) : snprintf(buf, size, "%s/%s", base, path);
+    return n < 0 || (size_t)n >= size ? -1 : 0;
+}
+
+/* Helper function to find the directory holding the refs of the repository
+ * around the working directory: env ($GIT_DIR), or the nearest .git
+ * upwards. A worktree's .git file points to its own git dir, whose
+ * commondir file points to the shared one. */
+static int find_git_dir(char buf[PATH_MAX], const char *env) {
+    char dir[PATH_MAX], path[PATH_MAX], line[PATH_MAX];
+    struct stat st;
+
+    if (env && *env) {
+        if (!getcwd(dir, sizeof(dir)) || join_path(path, sizeof(path), dir, env) != 0) return -1;
+    } else {
+        if (!getcwd(dir, sizeof(dir))) return -1;
+        for (;;) {
+            if (join_path(path, sizeof(path), strcmp(dir, "/") == 0 ? "" : dir, ".git") != 0) return -1;
+            if (stat(path, &st) == 0) break;
+
+            char *slash = strrchr(dir, '/');
+            if (!slash || strcmp(dir, "/") == 0) return -1;
+            if (slash == dir) {
+                dir[1] = '\0';
+            } else {
+                *slash = '\0';
+            }
+        }
+        if (S_ISREG(st.st_mode)) {
+            if (read_line(path, line, sizeof(line)) != 0 || strncmp(line, "gitdir: ", 8) != 0 ||
+                join_path(path, sizeof(path), dir, line + 8) != 0) {
+                return -1;
+            }
+        }
+    }
+
+    char common[PATH_MAX];
+    if (join_path(common, sizeof(common), path, "commondir") == 0 &&
+        read_line(common, line, sizeof(line)) == 0) {
+        if (join_path(common, sizeof(common), path, line) != 0) return -1;
+        return realpath(common, buf) ? 0 : -1;
+    }
+    return realpath(path, buf) ? 0 : -1;
+}
+
+/* Helper function to remember where a list came from */
+static void add_source(ref_list *list, const char *path, const struct stat *st) {
+    ref_source *sources = realloc(list->sources, (list->num_sources + 1) * sizeof(ref_source));
+    if (!sources) return;
+    list->sources = sources;
+    ref_source *src = &sources[list->num_sources];
+    src->path = strdup(path);
+    if (!src->path) return;
+    src->exists = st != NULL;
+    if (st) {
+        dir_stamp_from_stat(&src->stamp, st);
+    } else {
+        memset(&src->stamp, 0, sizeof(src->stamp));
+    }
+    list->num_sources++;
+}
+
+/* Helper function to check that nothing a list came from has changed */
+static int list_current(const ref_list *list) {
+    for (size_t i = 0; i < list->num_sources; i++) {
+        const ref_source *src = &list->sources[i];
+        struct stat st;
+        int exists = stat(src->path, &st) == 0;
+        if (exists != src->exists) return 0;
+        if (!exists) continue;
+
+        dir_stamp stamp;
+        dir_stamp_from_stat(&stamp, &st);
+        if (stamp.dev != src->stamp.dev || stamp.ino != src->stamp.ino ||
+            stamp.mtime.tv_sec != src->stamp.mtime.tv_sec ||
+            stamp.mtime.tv_nsec != src->stamp.mtime.tv_nsec) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void add_name(name_list *names, const char *name) {
+    if (names->count == names->cap) {
+        size_t new_cap = names->cap ? names->cap * 2 : 64;
+        char **new_names = realloc(names->names, new_cap * sizeof(char *));
+        if (!new_names) return;
+        names->names = new_names;
+        names->cap = new_cap;
+    }
+    char *copy = strdup(name);
+    if (copy) names->names[names->count++] = copy;
+}
+
+/* Helper function to collect loose refs below dir, named relative to the
+ * directory the walk started in; every directory is a source, since a new
+ * branch "feature/x" only changes the mtime of feature/ */
+static void walk_refs(ref_list *list, name_list *names, const char *dir, const char *prefix) {
+    struct stat st;
+    DIR *d = opendir(dir);
+    if (!d) {
+        add_source(list, dir, NULL);
+        return;
+    }
+    add_source(list, dir, fstat(dirfd(d), &st) == 0 ? &st : NULL);
+
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+
+        char path[PATH_MAX], name[PATH_MAX];
+        if (snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name) >= (int)sizeof(path) ||
+            snprintf(name, sizeof(name), "%s%s", prefix, entry->d_name) >= (int)sizeof(name) - 1) {
+            continue;
+        }
+
+        int is_dir = entry->d_type == DT_DIR;
+        if (entry->d_type == DT_UNKNOWN) {
+            is_dir = stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+        }
+        if (is_dir) {
+            strcat(name, "/");
+            walk_refs(list, names, path, name);
+        } else {
+            add_name(names, name);
+        }
+    }
+    closedir(d);
+}
+
+/* Helper function to collect the packed refs under prefix (e.g. "refs/heads/") */
+static void read_packed_refs(ref_list *list, name_list *names, const char *git_dir, const char *prefix) {
+    char path[PATH_MAX];
+    if (join_path(path, sizeof(path), git_dir, "packed-refs") != 0) return;
+
+    struct stat st;
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        add_source(list, path, NULL);
+        return;
+    }
+    add_source(list, path, fstat(fileno(fp), &st) == 0 ? &st : NULL);
+
+    /* Lines are "<object id> <refname>"; comments and peeled tags
+     * ("^<object id>") are skipped */
+    char line[PATH_MAX + 128];
+    size_t prefix_len = strlen(prefix);
+    while (fgets(line, sizeof(line), fp)) {
+        if (line[0] == '#' || line[0] == '^') continue;
+        line[strcspn(line, "\r\n")] = '\0';
+        char *ref = strchr(line, ' ');
+        if (ref && strncmp(ref + 1, prefix, prefix_len) == 0 && ref[1 + prefix_len]) {
+            add_name(names, ref + 1 + prefix_len);
+        }
+    }
+    fclose(fp);
+}
+
+/* Helper function to collect the remote names from the config */
+static void read_remotes(ref_list *list, name_list *names, const char *git_dir) {
+    char path[PATH_MAX];
+    if (join_path(path, sizeof(path), git_dir, "config") != 0) return;
+
+    struct stat st;
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        add_source(list, path, NULL);
+        return;
+    }
+    add_source(list, path, fstat(fileno(fp), &st) == 0 ? &st : NULL);
+
+    char line[1024];
+    while (fgets(line, sizeof(line), fp)) {
+        char *p = line;
+        while (*p == ' ' || *p == '\t') p++;
+        if (strncmp(p, "[remote \"", 9) != 0) continue;
+        char *end = strchr(p + 9, '"');
+        if (!end || end == p + 9) continue;
+        *end = '\0';
+        add_name(names, p + 9);
+    }
+    fclose(fp);
+}
+
+/* Helper function to (re)read one kind of names of a repository */
+static void load_list(repo_refs *repo, git_ref_kind kind) {
+    ref_list *list = &repo->lists[kind];
+    free_list(list);
+    command_index_init(&list->names);
+
+    name_list names = {0};
+    char path[PATH_MAX];
+    switch (kind) {
+    case GIT_REF_BRANCHES:
+    case GIT_REF_TAGS: {
+        const char *refs = kind == GIT_REF_BRANCHES ? "refs/heads" : "refs/tags";
+        if (join_path(path, sizeof(path), repo->git_dir, refs) == 0) {
+            walk_refs(list, &names, path, "");
+        }
+        read_packed_refs(list, &names, repo->git_dir, kind == GIT_REF_BRANCHES ? "refs/heads/" : "refs/tags/");
+        break;
+    }
+    case GIT_REF_REMOTES:
+        read_remotes(list, &names, repo->git_dir);
+        break;
+    default:
+        break;
+    }
+
+    command_index_sort(names.names, names.count);
+    command_index_merge(&list->names, names.names, names.count);
+    for (size_t i = 0; i < names.count; i++) {
+        free(names.names[i]);
+    }
+    free(names.names);
+    list->loaded = 1;
+}
+
+/* Helper function to find the repository and bring its names of one kind
+ * up to date; runs on a worker */
+static const command_index *lookup_refs(git_ref_kind kind, const char *git_dir_env) {
+    char git_dir[PATH_MAX];
+    if (find_git_dir(git_dir, git_dir_env) != 0) return NULL;
+
+    /* Find the repository, or take the least recently used slot */
+    repo_refs *repo = NULL;
+    repo_refs *victim = &repos[0];
+    for (int i = 0; i < GHOST_GIT_REPO_CACHE_SIZE; i++) {
+        if (repos[i].git_dir && strcmp(repos[i].git_dir, git_dir) == 0) {
+            repo = &repos[i];
+            break;
+        }
+        if (!repos[i].git_dir) {
+            if (victim->git_dir) victim = &repos[i];
+        } else if (victim->git_dir && repos[i].used < victim->used) {
+            victim = &repos[i];
+        }
+    }
+    if (!repo) {
+        free_repo(victim);
+        victim->git_dir = strdup(git_dir);
+        if (!victim->git_dir) return NULL;
+        repo = victim;
+    }
+    repo->used = ++use_counter;
+
+    ref_list *list = &repo->lists[kind];
+    if (!list->loaded || !list_current(list)) {
+        load_list(repo, kind);
+    }
+    return &list->names;
+}
+
+static void run_refs_task(void *arg) {
+    refs_task *t = arg;
+    t->result = lookup_refs(t->kind, t->git_dir_env);
+}
+
+static void free_refs_task(void *arg) {
+    refs_task *t = arg;
+    free(t->git_dir_env);
+    free(t);
+}
+
+const command_index *git_refs_get(git_ref_kind kind, int *stale) {
+    *stale = 0;
+    if (kind < 0 || kind >= GIT_REF_KINDS) return NULL;
+
+    /* One still running from an earlier Tab gets only a quick look; until
+     * it is done the cache is not touched */
+    if (pending) {
+        if (!fs_task_wait(pending, 1)) {
+            *stale = 1;
+            return NULL;
+        }
+        fs_task_release(pending);
+        pending = NULL;
+    }
+
+    refs_task *t = calloc(1, sizeof(refs_task));
+    if (!t) return NULL;
+    t->kind = kind;
+    const char *env = getenv("GIT_DIR");
+    if (env && *env && !(t->git_dir_env = strdup(env))) {
+        free(t);
+        return NULL;
+    }
+
+    fs_task *task = fs_task_start(run_refs_task, t, free_refs_task);
+    if (!task) {
+        /* No worker: do it here */
+        run_refs_task(t);
+        const command_index *result = t->result;
+        free_refs_task(t);
+        return result;
+    }
+    if (!fs_task_wait(task, fs_deadline_ms())) {
+        pending = task;
+        *stale = 1;
+        return NULL;
+    }
+    const command_index *result = t->result;
+    fs_task_release(task);
+    return result;
+}
+
+void git_refs_cleanup(void) {
+    /* A worker still in a lookup owns the cache; leave it be */
+    if (pending) return;
+    for (int i = 0; i < GHOST_GIT_REPO_CACHE_SIZE; i++) {
+        free_repo(&repos[i]);
+    }
+}
@@ -0,0 +1,109 @@
+#include "history_index.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Trie node. Children form a list, newest first; nodes are kept in one
+ * array and refer to each other by position, 0 meaning none (the root is
+ * node 0 and never anyone's child). */
+typedef struct trie_node {
+    uint32_t child;     /* First child */
+    uint32_t sibling;   /* Next child of the same parent */
+    uint32_t newest;    /* Newest line through this node, plus one */
+    uint32_t line;      /* Line ending at this node, plus one */
+    unsigned char ch;
+} trie_node;
+
+static trie_node *nodes = NULL;
+static size_t num_nodes = 0;
+static size_t nodes_cap = 0;
+static char **lines = NULL;
+static size_t num_lines = 0;
+static size_t lines_cap = 0;
+
+/* Helper function to find the child of node for ch */
+static uint32_t find_child(uint32_t node, unsigned char ch) {
+    uint32_t c = nodes[node].child;
+    while (c && nodes[c].ch != ch) c = nodes[c].sibling;
+    return c;
+}
+
+/* Helper function to add a child for ch; returns 0 if out of memory */
+static uint32_t add_child(uint32_t node, unsigned char ch) {
+    if (num_nodes == nodes_cap) {
+        size_t new_cap = nodes_cap ? nodes_cap * 2 : 4096;
+        if (new_cap > UINT32_MAX) return 0;
+        trie_node *new_nodes = realloc(nodes, new_cap * sizeof(trie_node));
+        if (!new_nodes) return 0;
+        nodes = new_nodes;
+        nodes_cap = new_cap;
+    }
+    uint32_t c = (uint32_t)num_nodes++;
+    memset(&nodes[c], 0, sizeof(trie_node));
+    nodes[c].ch = ch;
+    nodes[c].sibling = nodes[node].child;
+    nodes[node].child = c;
+    return c;
+}
+
+void history_index_add(const char *line) {
+    if (!line || !*line) return;
+    if (!nodes && !add_child(0, 0)) return;  /* The root */
+
+    /* Find or make the path of the line */
+    uint32_t node = 0;
+    for (const unsigned char *p = (const unsigned char *)line; *p; p++) {
+        uint32_t c = find_child(node, *p);
+        if (!c && !(c = add_child(node, *p))) return;
+        node = c;
+    }
+
+    uint32_t id = nodes[node].line;
+    if (!id) {
+        if (num_lines == lines_cap) {
+            size_t new_cap = lines_cap ? lines_cap * 2 : 256;
+            char **new_lines = realloc(lines, new_cap * sizeof(char *));
+            if (!new_lines) return;
+            lines = new_lines;
+            lines_cap = new_cap;
+        }
+        lines[num_lines] = strdup(line);
+        if (!lines[num_lines]) return;
+        id = (uint32_t)++num_lines;
+        nodes[node].line = id;
+    }
+
+    /* Newest wins: the line takes over every node on its path */
+    node = 0;
+    for (const unsigned char *p = (const unsigned char *)line; *p; p++) {
+        node = find_child(node, *p);
+        nodes[node].newest = id;
+    }
+}
+
+const char *history_index_suggest(const char *prefix, size_t len) {
+    if (!nodes || len == 0) return NULL;
+
+    uint32_t node = 0;
+    for (size_t i = 0; i < len; i++) {
+        node = find_child(node, (unsigned char)prefix[i]);
+        if (!node) return NULL;
+    }
+    const char *line = lines[nodes[node].newest - 1];
+    return line[len] ? line : NULL;
+}
+
+size_t history_index_count(void) {
+    return num_lines;
+}
+
+void history_index_clear(void) {
+    for (size_t i = 0; i < num_lines; i++) {
+        free(lines[i]);
+    }
+    free(lines);
+    free(nodes);
+    lines = NULL;
+    nodes = NULL;
+    num_lines = lines_cap = num_nodes = nodes_cap = 0;
+}
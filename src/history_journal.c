@@ -0,0 +1,553 @@
+#include "history_journal.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/* First line of a libedit history file */
+#define JOURNAL_HEADER "_HiStOrY_V2_\n"
+
+static char *journal_path = NULL;
+static int journal_fd = -1;     /* Appends go here; reopened when replaced */
+static size_t journal_keep = 0;
+
+/* Reading what other shells append (main thread only) */
+static int sharing = 0;
+static int read_fd = -1;
+static size_t read_offset = 0;      /* Where to read from next */
+static char *last_seen = NULL;      /* Last entry read there, encoded */
+static char **own = NULL;           /* Entries appended here, not read back yet */
+static size_t num_own = 0;
+
+/* Shared with the background thread */
+static pthread_mutex_t journal_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t journal_wake = PTHREAD_COND_INITIALIZER;
+static pthread_t journal_thread;
+static int thread_running = 0;
+static int stopping = 0;
+static int compact_wanted = 0;
+static size_t unsynced = 0;         /* Entries appended since the last flush */
+static time_t first_unsynced = 0;   /* When the oldest of them was appended */
+static size_t journal_lines = 0;    /* Entries in the file, as far as known */
+
+/* Helper function to encode a line like libedit's history file does
+ * (strvis with VIS_WHITE): whitespace, control characters and
+ * backslashes as octal escapes. out needs 4 * strlen(line) + 2 bytes;
+ * returns the length including the newline. */
+static size_t encode_entry(const char *line, char *out) {
+    size_t n = 0;
+    for (const unsigned char *p = (const unsigned char *)line; *p; p++) {
+        if (*p <= ' ' || *p == '\\' || *p == 0x7f) {
+            n += (size_t)sprintf(out + n, "\\%03o", *p);
+        } else {
+            out[n++] = (char)*p;
+        }
+    }
+    out[n++] = '\n';
+    return n;
+}
+
+/* Helper function to decode a line of the file (without its newline)
+ * into out, which needs len + 1 bytes: octal escapes as written above, and
+ * the \\^X and \\M-X forms older libedit files use as well */
+static void decode_entry(const char *in, size_t len, char *out) {
+    size_t n = 0;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)in[i];
+        if (c == '\\' && i + 1 < len) {
+            c = (unsigned char)in[++i];
+            unsigned char meta = 0;
+            if (c == 'M' && i + 2 < len && (in[i + 1] == '-' || in[i + 1] == '^')) {
+                meta = 0x80;
+                c = (unsigned char)in[i + 1] == '^' ? (unsigned char)(in[i + 2] & 0x1f) : (unsigned char)in[i + 2];
+                if (in[i + 1] == '^' && in[i + 2] == '?') c = 0x7f;
+                i += 2;
+            } else if (c == '^' && i + 1 < len) {
+                c = in[i + 1] == '?' ? 0x7f : (unsigned char)(in[i + 1] & 0x1f);
+                i++;
+            } else if (c >= '0' && c <= '7') {
+                unsigned value = 0;
+                for (int d = 0; d < 3 && i < len && in[i] >= '0' && in[i] <= '7'; d++, i++) {
+                    value = value * 8 + (unsigned)(in[i] - '0');
+                }
+                i--;
+                c = (unsigned char)value;
+            }
+            c |= meta;
+        }
+        out[n++] = (char)c;
+    }
+    out[n] = '\0';
+}
+
+/* Helper function to write all of buf */
+static int write_all(int fd, const char *buf, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd, buf, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        buf += n;
+        size -= (size_t)n;
+    }
+    return 0;
+}
+
+/* Helper function to take an flock, retrying when a signal interrupts it */
+static int lock_file(int fd, int op) {
+    while (flock(fd, op) != 0) {
+        if (errno != EINTR) return -1;
+    }
+    return 0;
+}
+
+/* Helper function to check that fd is still the file at journal_path */
+static int is_current(int fd, struct stat *st) {
+    struct stat at_path;
+    return fstat(fd, st) == 0 && stat(journal_path, &at_path) == 0 &&
+           st->st_ino == at_path.st_ino && st->st_dev == at_path.st_dev;
+}
+
+/* Helper function to open the journal for appending, creating it with
+ * its header already in place so that no entry can come before it */
+static int open_journal(void) {
+    journal_fd = open(journal_path, O_WRONLY | O_APPEND | O_CLOEXEC);
+    if (journal_fd < 0 && errno == ENOENT) {
+        char tmp[PATH_MAX];
+        if (snprintf(tmp, sizeof(tmp), "%s.%ld.new", journal_path, (long)getpid()) >= (int)sizeof(tmp)) return -1;
+        int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        if (fd >= 0) {
+            if (write_all(fd, JOURNAL_HEADER, strlen(JOURNAL_HEADER)) == 0) link(tmp, journal_path);
+            close(fd);
+            unlink(tmp);
+        }
+        journal_fd = open(journal_path, O_WRONLY | O_APPEND | O_CLOEXEC);
+    }
+    if (journal_fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(journal_fd, &st) == 0 && st.st_size == 0) {
+        write_all(journal_fd, JOURNAL_HEADER, strlen(JOURNAL_HEADER));
+    }
+    return 0;
+}
+
+/* Helper function to append an encoded entry with a single write, taking
+ * no lock. If a compaction replaced the file meanwhile, the entry may
+ * have missed the copy, so it is written again to the new file; at worst
+ * it is there twice until the next compaction. */
+static int write_entry(const char *buf, size_t len) {
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (journal_fd < 0 && open_journal() != 0) return -1;
+        if (write_all(journal_fd, buf, len) != 0) return -1;
+
+        struct stat st;
+        if (is_current(journal_fd, &st)) break;
+        close(journal_fd);
+        journal_fd = -1;
+    }
+    return 0;
+}
+
+/* Helper function to flush the journal to disk; any descriptor of the
+ * file will do */
+static void sync_journal(void) {
+    int fd = open(journal_path, O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+/* FNV-1a hash of an encoded entry */
+static uint32_t hash_entry(const char *s, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* Helper function to rewrite the journal with each entry once (at its
+ * newest position), keeping the newest journal_keep. Returns the number
+ * of entries left in the file, or 0 if it could not tell. */
+static size_t compact_journal(void) {
+    int fd = open(journal_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+
+    /* One compaction at a time across shells */
+    struct stat st;
+    char *buf = NULL;
+    size_t *starts = NULL;
+    uint32_t *seen = NULL;
+    char *keep = NULL;
+    size_t result = 0;
+    if (lock_file(fd, LOCK_EX) != 0 || !is_current(fd, &st)) goto done;
+
+    size_t header = strlen(JOURNAL_HEADER);
+    size_t size = (size_t)st.st_size;
+    buf = malloc(size + 1);
+    if (!buf) goto done;
+    size_t got = 0;
+    while (got < size) {
+        ssize_t n = read(fd, buf + got, size - got);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        got += (size_t)n;
+    }
+    if (got < header || memcmp(buf, JOURNAL_HEADER, header) != 0) goto done;
+    size = got;
+    if (buf[size - 1] != '\n') buf[size++] = '\n';
+
+    /* Where each entry starts; entry i ends at starts[i + 1] */
+    size_t count = 0;
+    for (size_t i = header; i < size; i++) count += buf[i] == '\n';
+    result = count;
+    if (count <= 2 * journal_keep) goto done;
+
+    starts = malloc((count + 1) * sizeof(size_t));
+    size_t slots = 1;
+    while (slots < 2 * count) slots <<= 1;
+    seen = calloc(slots, sizeof(uint32_t));
+    keep = calloc(count, 1);
+    if (!starts || !seen || !keep || count >= UINT32_MAX) goto done;
+    size_t e = 0;
+    starts[e++] = header;
+    for (size_t i = header; i < size; i++) {
+        if (buf[i] == '\n') starts[e++] = i + 1;
+    }
+
+    /* Walk from the newest entry, keeping the first copy of each */
+    size_t kept = 0;
+    for (size_t i = count; i-- > 0 && kept < journal_keep;) {
+        const char *s = buf + starts[i];
+        size_t len = starts[i + 1] - starts[i];
+        size_t slot = hash_entry(s, len) & (slots - 1);
+        int dup = 0;
+        while (seen[slot]) {
+            size_t j = seen[slot] - 1;
+            if (starts[j + 1] - starts[j] == len && memcmp(buf + starts[j], s, len) == 0) {
+                dup = 1;
+                break;
+            }
+            slot = (slot + 1) & (slots - 1);
+        }
+        if (dup) continue;
+        seen[slot] = (uint32_t)(i + 1);
+        keep[i] = 1;
+        kept++;
+    }
+
+    /* Write a temporary file and rename it over the journal */
+    char tmp[PATH_MAX];
+    if (snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", journal_path, (long)getpid()) >= (int)sizeof(tmp)) {
+        goto done;
+    }
+    int out = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    int ok = out >= 0 && write_all(out, JOURNAL_HEADER, header) == 0;
+    for (size_t i = 0; ok && i < count; i++) {
+        if (keep[i]) ok = write_all(out, buf + starts[i], starts[i + 1] - starts[i]) == 0;
+    }
+    if (out >= 0) {
+        if (ok && fsync(out) != 0) ok = 0;
+        if (close(out) != 0) ok = 0;
+    }
+    if (ok) ok = rename(tmp, journal_path) == 0;
+    if (!ok) unlink(tmp);
+    result = ok ? kept : 0;
+
+    /* Entries appended to the old file since it was read go after them;
+     * any appended later notice it was replaced and write themselves again
+     * (one that lands in both is dropped by the next compaction) */
+    if (ok) {
+        int new_fd = open(journal_path, O_WRONLY | O_APPEND | O_CLOEXEC);
+        char block[4096];
+        ssize_t n;
+        while (new_fd >= 0 && (n = pread(fd, block, sizeof(block), (off_t)got)) > 0) {
+            if (write_all(new_fd, block, (size_t)n) != 0) break;
+            got += (size_t)n;
+        }
+        if (new_fd >= 0) close(new_fd);
+    }
+
+done:
+    free(keep);
+    free(seen);
+    free(starts);
+    free(buf);
+    close(fd);
+    return result;
+}
+
+/* Background thread: flushes a batch once it is full or old enough, and
+ * compacts the journal when asked (which flushes it too) */
+static void *journal_main(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&journal_lock);
+    for (;;) {
+        while (!stopping && !compact_wanted && unsynced < GHOST_JOURNAL_SYNC_BATCH) {
+            if (unsynced == 0) {
+                pthread_cond_wait(&journal_wake, &journal_lock);
+                continue;
+            }
+            struct timespec deadline = {first_unsynced + GHOST_JOURNAL_SYNC_SECONDS, 0};
+            if (pthread_cond_timedwait(&journal_wake, &journal_lock, &deadline) == ETIMEDOUT) break;
+        }
+
+        int stop = stopping;
+        int compact = compact_wanted && !stop;
+        size_t pending = unsynced;
+        compact_wanted = 0;
+        unsynced = 0;
+        pthread_mutex_unlock(&journal_lock);
+
+        size_t lines = 0;
+        if (compact) {
+            lines = compact_journal();
+        } else if (pending > 0) {
+            sync_journal();
+        }
+
+        pthread_mutex_lock(&journal_lock);
+        if (compact) journal_lines = lines;
+        if (stop) break;
+    }
+    pthread_mutex_unlock(&journal_lock);
+    return NULL;
+}
+
+/* Helper function to read the whole of a file read so far */
+static char *read_whole(int fd, size_t size, size_t *got) {
+    char *buf = malloc(size + 1);
+    *got = 0;
+    if (!buf) return NULL;
+    while (*got < size) {
+        ssize_t n = pread(fd, buf + *got, size - *got, (off_t)*got);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        *got += (size_t)n;
+    }
+    return buf;
+}
+
+/* Helper function to find where to go on reading a file that replaced the
+ * one read so far: after the last copy of the last entry read, which a
+ * compaction keeps unless it trims it, and then everything left is newer.
+ * With nothing read yet, everything after the header is new too. */
+static size_t find_resume(int fd, size_t size) {
+    size_t header = strlen(JOURNAL_HEADER);
+    if (size < header) return size;
+    if (!last_seen) return header;
+
+    size_t got, len = strlen(last_seen);
+    char *buf = read_whole(fd, size, &got);
+    if (!buf) return size;
+    size_t resume = header;
+    for (size_t end = got; end > header; end--) {
+        /* A line ending at end - 1 */
+        if (buf[end - 1] != '\n' || end - 1 < len) continue;
+        size_t start = end - 1 - len;
+        if ((start == 0 || buf[start - 1] == '\n') && memcmp(buf + start, last_seen, len) == 0) {
+            resume = end;
+            break;
+        }
+    }
+    free(buf);
+    return resume;
+}
+
+/* Helper function to remember the last entry of a file as the one read
+ * last, when starting to read at its end */
+static void find_last_seen(int fd, size_t size) {
+    size_t from = size > 4096 ? size - 4096 : 0;
+    char buf[4096];
+    ssize_t n = pread(fd, buf, size - from, (off_t)from);
+    if (n <= 1 || buf[n - 1] != '\n') return;
+
+    size_t start = (size_t)n - 1;
+    while (start > 0 && buf[start - 1] != '\n') start--;
+    if (start == 0) return;   /* The header, or longer than what was read */
+    free(last_seen);
+    last_seen = strndup(buf + start, (size_t)n - 1 - start);
+}
+
+/* Helper function to find line among the entries this shell wrote and has
+ * not read back. Returns its index, or num_own. */
+static size_t find_own(const char *line, size_t line_len) {
+    for (size_t i = 0; i < num_own; i++) {
+        if (strlen(own[i]) == line_len && memcmp(own[i], line, line_len) == 0) return i;
+    }
+    return num_own;
+}
+
+/* Helper function to take in what was appended: entries this shell wrote
+ * are skipped, the others go to add. Own entries are due oldest first; one
+ * matched further down means those before it were lost (a compaction race),
+ * so they are dropped rather than keep every later one out of step. */
+static void take_lines(const char *buf, size_t len, void (*add)(const char *, void *), void *arg) {
+    const char *last = NULL;
+    size_t last_len = 0;
+    char small[1024];
+    for (size_t start = 0; start < len;) {
+        const char *nl = memchr(buf + start, '\n', len - start);
+        if (!nl) break;
+        size_t line_len = (size_t)(nl - (buf + start));
+        const char *line = buf + start;
+        start += line_len + 1;
+        last = line;
+        last_len = line_len;
+
+        size_t mine = find_own(line, line_len);
+        if (mine < num_own) {
+            for (size_t i = 0; i <= mine; i++) free(own[i]);
+            num_own -= mine + 1;
+            memmove(own, own + mine + 1, num_own * sizeof(char *));
+            continue;
+        }
+        char *decoded = line_len < sizeof(small) ? small : malloc(line_len + 1);
+        if (!decoded) continue;
+        decode_entry(line, line_len, decoded);
+        if (*decoded) add(decoded, arg);
+        if (decoded != small) free(decoded);
+    }
+    if (last) {
+        free(last_seen);
+        last_seen = strndup(last, last_len);
+    }
+}
+
+void history_journal_pull(void (*add)(const char *line, void *arg), void *arg) {
+    if (!sharing || !journal_path) return;
+
+    /* A compaction (or the first entry) made a new file: find the place */
+    struct stat st;
+    if (read_fd < 0 || !is_current(read_fd, &st)) {
+        if (read_fd >= 0) close(read_fd);
+        read_fd = open(journal_path, O_RDONLY | O_CLOEXEC);
+        if (read_fd < 0 || fstat(read_fd, &st) != 0) return;
+        read_offset = find_resume(read_fd, (size_t)st.st_size);
+    }
+    if ((size_t)st.st_size <= read_offset) return;
+
+    /* Only whole lines; the rest is read next time */
+    size_t got;
+    size_t size = (size_t)st.st_size - read_offset;
+    char *buf = malloc(size);
+    if (!buf) return;
+    for (got = 0; got < size;) {
+        ssize_t n = pread(read_fd, buf + got, size - got, (off_t)(read_offset + got));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        got += (size_t)n;
+    }
+    while (got > 0 && buf[got - 1] != '\n') got--;
+    take_lines(buf, got, add, arg);
+    read_offset += got;
+    free(buf);
+}
+
+int history_journal_open(const char *path, int keep, int share) {
+    history_journal_close();
+    journal_path = strdup(path);
+    if (!journal_path) return -1;
+    journal_keep = keep > 0 ? (size_t)keep : 1;
+    stopping = 0;
+    unsynced = 0;
+    journal_lines = 0;
+
+    /* Everything in the file so far was loaded with it */
+    sharing = share;
+    if (sharing) {
+        struct stat st;
+        read_fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (read_fd >= 0 && fstat(read_fd, &st) == 0) {
+            read_offset = (size_t)st.st_size;
+            find_last_seen(read_fd, read_offset);
+        }
+    }
+
+    /* The first pass counts the entries, compacting if there are too many */
+    compact_wanted = 1;
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    thread_running = pthread_create(&journal_thread, NULL, journal_main, NULL) == 0;
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    return thread_running ? 0 : -1;
+}
+
+void history_journal_append(const char *line) {
+    if (!journal_path || !line || !*line) return;
+
+    size_t len = strlen(line);
+    char small[1024];
+    char *buf = 4 * len + 2 <= sizeof(small) ? small : malloc(4 * len + 2);
+    if (!buf) return;
+    size_t encoded = encode_entry(line, buf);
+    int result = write_entry(buf, encoded);
+
+    /* To know it when reading it back among the other shells' entries */
+    if (result == 0 && sharing) {
+        if (num_own == GHOST_JOURNAL_OWN_MAX) {
+            free(own[0]);
+            memmove(own, own + 1, --num_own * sizeof(char *));
+        }
+        if (!own) own = malloc(GHOST_JOURNAL_OWN_MAX * sizeof(char *));
+        if (own && (own[num_own] = strndup(buf, encoded - 1)) != NULL) num_own++;
+    }
+    if (buf != small) free(buf);
+    if (result != 0) return;
+
+    pthread_mutex_lock(&journal_lock);
+    if (unsynced++ == 0) first_unsynced = time(NULL);
+    if (++journal_lines > 2 * journal_keep) compact_wanted = 1;
+    if (compact_wanted || unsynced >= GHOST_JOURNAL_SYNC_BATCH || unsynced == 1) {
+        pthread_cond_signal(&journal_wake);
+    }
+    pthread_mutex_unlock(&journal_lock);
+}
+
+void history_journal_close(void) {
+    if (thread_running) {
+        pthread_mutex_lock(&journal_lock);
+        stopping = 1;
+        pthread_cond_signal(&journal_wake);
+        pthread_mutex_unlock(&journal_lock);
+        pthread_join(journal_thread, NULL);
+        thread_running = 0;
+    } else if (journal_path && unsynced > 0) {
+        sync_journal();
+    }
+    unsynced = 0;
+
+    if (journal_fd >= 0) {
+        close(journal_fd);
+        journal_fd = -1;
+    }
+    free(journal_path);
+    journal_path = NULL;
+
+    if (read_fd >= 0) {
+        close(read_fd);
+        read_fd = -1;
+    }
+    for (size_t i = 0; i < num_own; i++) free(own[i]);
+    free(own);
+    own = NULL;
+    num_own = 0;
+    free(last_seen);
+    last_seen = NULL;
+    read_offset = 0;
+    sharing = 0;
+}
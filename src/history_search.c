@@ -0,0 +1,347 @@
+#include "history_search.h"
+#include "history_store.h"
+#include "autosuggest.h"
+#include <limits.h>
+#include <poll.h>
+#include <time.h>
+
+/* Longest query typed at the Ctrl-R prompt */
+#define SEARCH_QUERY_MAX 256
+
+static char query[SEARCH_QUERY_MAX];
+static int query_failed = 0;
+
+/* Prompt shown while searching */
+static char *search_prompt(EditLine *el) {
+    (void)el;
+    static char prompt[SEARCH_QUERY_MAX + 32];
+    snprintf(prompt, sizeof(prompt), "(%ssearch)`%s': ", query_failed ? "failed " : "", query);
+    return prompt;
+}
+
+/* Distinct commands seen so far while looking for the one wanted */
+typedef struct search_state {
+    size_t wanted;      /* How many distinct matches to skip */
+    char *seen[64];
+    size_t num_seen;
+    char *found;
+} search_state;
+
+static int visit_match(const history_entry *entry, void *arg) {
+    search_state *s = arg;
+    for (size_t i = 0; i < s->num_seen; i++) {
+        if (strcmp(s->seen[i], entry->command) == 0) return 0;
+    }
+    if (s->num_seen == s->wanted) {
+        s->found = strdup(entry->command);
+        return 1;
+    }
+    if (s->num_seen == sizeof(s->seen) / sizeof(s->seen[0])) return 1;
+    s->seen[s->num_seen] = strdup(entry->command);
+    return s->seen[s->num_seen++] == NULL;
+}
+
+/* Helper function to find the skip+1th newest distinct command containing
+ * the query; returns it malloc'd, or NULL */
+static char *find_match(size_t skip) {
+    search_state s;
+    memset(&s, 0, sizeof(s));
+    s.wanted = skip;
+
+    history_query q;
+    memset(&q, 0, sizeof(q));
+    q.pattern = query;
+    char error[256];
+    history_store_search(&q, visit_match, &s, error, sizeof(error));
+    for (size_t i = 0; i < s.num_seen; i++) free(s.seen[i]);
+    return s.found;
+}
+
+/* Helper function to count the characters of UTF-8 text */
+static int count_chars(const char *s, size_t len) {
+    int n = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (((unsigned char)s[i] & 0xC0) != 0x80) n++;
+    }
+    return n;
+}
+
+/* Helper function to replace the whole line */
+static void set_line(EditLine *el, const char *text) {
+    const LineInfo *li = el_line(el);
+    el_cursor(el, count_chars(li->cursor, (size_t)(li->lastchar - li->cursor)));
+    li = el_line(el);
+    int len = count_chars(li->buffer, (size_t)(li->lastchar - li->buffer));
+    if (len > 0) el_deletestr(el, len);
+    if (*text) el_insertstr(el, text);
+}
+
+/* Helper function to read one byte from the terminal */
+static int read_byte(unsigned char *c) {
+    for (;;) {
+        ssize_t n = read(STDIN_FILENO, c, 1);
+        if (n < 0 && errno == EINTR) continue;
+        return n == 1;
+    }
+}
+
+/* Ctrl-R: search the history store as the query is typed */
+static unsigned char search_history(EditLine *el, int ch) {
+    (void)ch;
+    const LineInfo *li = el_line(el);
+    char *original = strndup(li->buffer, (size_t)(li->lastchar - li->buffer));
+    if (!original) return CC_ERROR;
+
+    char *(*saved_prompt)(EditLine *) = NULL;
+    el_get(el, EL_PROMPT, &saved_prompt);
+    el_set(el, EL_PROMPT, search_prompt);
+    query[0] = '\0';
+    query_failed = 0;
+
+    size_t len = 0, skip = 0;
+    size_t prompt_width = autosuggest_prompt_width();
+    char *match = NULL;
+    for (;;) {
+        /* Stay on the oldest match when Ctrl-R goes past it */
+        free(match);
+        match = len > 0 ? find_match(skip) : NULL;
+        if (!match && skip > 0) match = find_match(--skip);
+        autosuggest_clear_line(el, prompt_width);
+        query_failed = len > 0 && !match;
+        set_line(el, match ? match : original);
+        el_set(el, EL_REFRESH);
+        const char *prompt = search_prompt(el);
+        prompt_width = (size_t)count_chars(prompt, strlen(prompt));
+
+        unsigned char c;
+        if (!read_byte(&c) || c == 0x07) {
+            /* Ctrl-G (or end of input): back to the line as it was */
+            set_line(el, original);
+            break;
+        }
+        if (c == 0x12) {
+            if (match) skip++;
+        } else if (c == 0x7f || c == 0x08) {
+            while (len > 0 && ((unsigned char)query[--len] & 0xC0) == 0x80) {}
+            query[len] = '\0';
+            skip = 0;
+        } else if (c == '\r' || c == '\n') {
+            el_push(el, "\n");
+            break;
+        } else if (c == 0x1b) {
+            /* Escape alone keeps the line; a key sequence is handled as
+             * usual after that */
+            char seq[16] = "\033";
+            size_t n = 1;
+            struct pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+            while (n + 1 < sizeof(seq) && poll(&pfd, 1, 20) == 1 && read_byte((unsigned char *)&seq[n])) n++;
+            seq[n] = '\0';
+            if (n > 1) el_push(el, seq);
+            break;
+        } else if (c < 0x20) {
+            char key[2] = {(char)c, '\0'};
+            el_push(el, key);
+            break;
+        } else if (len + 1 < sizeof(query)) {
+            query[len++] = (char)c;
+            query[len] = '\0';
+            skip = 0;
+        }
+    }
+
+    free(match);
+    free(original);
+    el_set(el, EL_PROMPT, saved_prompt);
+    return CC_REFRESH;
+}
+
+void history_search_init(EditLine *el) {
+    if (!el) return;
+    el_set(el, EL_ADDFN, "search-history", "Search the history store", search_history);
+    el_set(el, EL_BIND, "^R", "search-history", NULL);
+}
+
+/* Matches collected by history search, newest first */
+typedef struct search_rows {
+    history_entry *rows;
+    size_t count;
+    size_t cap;        /* Rows allocated; grows as matches come in */
+    size_t max;        /* Matches wanted (-n) */
+    int out_of_memory;
+} search_rows;
+
+static int collect_row(const history_entry *entry, void *arg) {
+    search_rows *r = arg;
+    if (r->count == r->cap) {
+        size_t new_cap = r->cap ? r->cap * 2 : GHOST_HISTORY_SEARCH_ROWS;
+        if (new_cap > r->max) new_cap = r->max;
+        history_entry *rows = realloc(r->rows, new_cap * sizeof(history_entry));
+        if (!rows) {
+            r->out_of_memory = 1;
+            return 1;
+        }
+        r->rows = rows;
+        r->cap = new_cap;
+    }
+    history_entry *row = &r->rows[r->count];
+    row->command = strdup(entry->command);
+    row->cwd = strdup(entry->cwd);
+    row->time = entry->time;
+    row->status = entry->status;
+    if (!row->command || !row->cwd) {
+        free((char *)row->command);
+        free((char *)row->cwd);
+        r->out_of_memory = 1;
+        return 1;
+    }
+    return ++r->count == r->max;
+}
+
+/* Helper function to read WHEN: a time ago with a unit (s, m, h, d, w) or
+ * a local date. Returns -1 if it is neither. */
+static int parse_when(const char *when, time_t *t) {
+    char *end;
+    long n = strtol(when, &end, 10);
+    const char *units = "smhdw";
+    const long seconds[] = {1, 60, 3600, 86400, 604800};
+    const char *unit = end != when && n >= 0 && *end && !end[1] ? strchr(units, *end) : NULL;
+    if (unit) {
+        *t = time(NULL) - (time_t)(n * seconds[unit - units]);
+        return 0;
+    }
+
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    char extra;
+    if (sscanf(when, "%d-%d-%d%c", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &extra) != 3) return -1;
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    tm.tm_isdst = -1;
+    *t = mktime(&tm);
+    return *t == (time_t)-1 ? -1 : 0;
+}
+
+int history_search_builtin(ghost_command *cmd, size_t first) {
+    history_query q;
+    memset(&q, 0, sizeof(q));
+    size_t max = GHOST_HISTORY_SEARCH_ROWS;
+    int long_format = 0;
+    char cwd[PATH_MAX];
+    char error[512];
+
+    size_t i = first;
+    for (; i < cmd->arg_count && cmd->args[i][0] == '-'; i++) {
+        const char *opt = cmd->args[i];
+        const char *value = i + 1 < cmd->arg_count ? cmd->args[i + 1] : NULL;
+        int takes_value = strcmp(opt, "-n") == 0 || strcmp(opt, "--cwd") == 0 || strcmp(opt, "--status") == 0 ||
+                          strcmp(opt, "--since") == 0 || strcmp(opt, "--until") == 0;
+        if (strcmp(opt, "--") == 0) {
+            i++;
+            break;
+        }
+        if (takes_value && !value) {
+            snprintf(error, sizeof(error), "history: %s: option requires an argument", opt);
+            print_error(error);
+            return 2;
+        }
+
+        if (strcmp(opt, "-e") == 0 || strcmp(opt, "--regex") == 0) {
+            q.regex = 1;
+        } else if (strcmp(opt, "-l") == 0) {
+            long_format = 1;
+        } else if (strcmp(opt, "--failed") == 0) {
+            q.status_filter = 2;
+        } else if (strcmp(opt, "-n") == 0) {
+            char *end;
+            long n = strtol(value, &end, 10);
+            if (*end || n <= 0) {
+                snprintf(error, sizeof(error), "history: %s: invalid count", value);
+                print_error(error);
+                return 2;
+            }
+            max = (size_t)n;
+        } else if (strcmp(opt, "--status") == 0) {
+            char *end;
+            q.status = (int)strtol(value, &end, 10);
+            if (*end || end == value) {
+                snprintf(error, sizeof(error), "history: %s: invalid status", value);
+                print_error(error);
+                return 2;
+            }
+            q.status_filter = 1;
+        } else if (strcmp(opt, "--cwd") == 0) {
+            if (!realpath(value, cwd)) {
+                snprintf(error, sizeof(error), "history: %s: %s", value, strerror(errno));
+                print_error(error);
+                return 2;
+            }
+            q.cwd = cwd;
+        } else if (strcmp(opt, "--since") == 0 || strcmp(opt, "--until") == 0) {
+            time_t t;
+            if (parse_when(value, &t) != 0) {
+                snprintf(error, sizeof(error), "history: %s: invalid time", value);
+                print_error(error);
+                return 2;
+            }
+            if (opt[2] == 's') {
+                q.since = t;
+            } else {
+                q.until = t;
+            }
+        } else {
+            snprintf(error, sizeof(error), "history: %s: invalid option", opt);
+            print_error(error);
+            return 2;
+        }
+        if (takes_value) i++;
+    }
+
+    /* The rest is the pattern, words joined by spaces */
+    char pattern[GHOST_MAX_INPUT_SIZE] = "";
+    size_t len = 0;
+    for (; i < cmd->arg_count; i++) {
+        int n = snprintf(pattern + len, sizeof(pattern) - len, "%s%s", len ? " " : "", cmd->args[i]);
+        if (n < 0 || (size_t)n >= sizeof(pattern) - len) break;
+        len += (size_t)n;
+    }
+    q.pattern = pattern;
+
+    /* Scripts can search it too */
+    if (history_store_open() < 0) {
+        print_error("history: history store not available");
+        return 2;
+    }
+
+    search_rows r = {NULL, 0, 0, max, 0};
+    int result = history_store_search(&q, collect_row, &r, error, sizeof(error));
+    if (result != 0) {
+        char msg[600];
+        snprintf(msg, sizeof(msg), "history: %s", error);
+        print_error(msg);
+    } else if (r.out_of_memory) {
+        print_error("history: out of memory; showing the matches collected so far");
+        result = -1;
+    }
+
+    /* Oldest first, like the history list */
+    for (size_t j = r.count; j-- > 0;) {
+        const history_entry *e = &r.rows[j];
+        char when[32] = "-";
+        struct tm tm;
+        if (e->time && localtime_r(&e->time, &tm)) strftime(when, sizeof(when), "%Y-%m-%d %H:%M", &tm);
+        char status[16] = "-";
+        if (e->status >= 0) snprintf(status, sizeof(status), "%d", e->status);
+
+        if (long_format) {
+            printf("%16s  %3s  %s  %s\n", when, status, *e->cwd ? e->cwd : "-", e->command);
+        } else {
+            printf("%16s  %3s  %s\n", when, status, e->command);
+        }
+        free((char *)e->command);
+        free((char *)e->cwd);
+    }
+    free(r.rows);
+
+    if (result != 0) return 2;
+    return r.count > 0 ? 0 : 1;
+}
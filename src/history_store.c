@@ -0,0 +1,779 @@
+#include "history_store.h"
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <regex.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define ENTRIES_MAGIC "GHSHHS1\n"
+#define INDEX_MAGIC "GHSHHX1\n"
+#define MAGIC_LEN 8
+
+/* Entry file: ENTRIES_MAGIC, then records, each padded to 8 bytes */
+typedef struct store_record {
+    uint32_t size;          /* Whole record */
+    int32_t status;
+    int64_t time;
+    uint32_t command_len;   /* The command and the directory follow, */
+    uint32_t cwd_len;       /* each with a NUL */
+} store_record;
+
+/* Index file: the header, the offset of each entry in the entry file,
+ * the trigrams in order and then, trigram by trigram, the numbers of the
+ * entries containing it in ascending order */
+typedef struct index_header {
+    char magic[MAGIC_LEN];
+    uint64_t entries_end;   /* Bytes of the entry file indexed */
+    uint64_t num_entries;
+    uint64_t num_grams;
+    uint64_t num_postings;
+} index_header;
+
+typedef struct index_gram {
+    uint32_t gram;          /* Three bytes, ASCII case folded */
+    uint32_t count;
+    uint64_t first;         /* Position of its first entry number */
+} index_gram;
+
+/* A mapped index */
+typedef struct store_index {
+    const char *map;
+    size_t size;
+    const index_header *hdr;
+    const uint64_t *offsets;
+    const index_gram *grams;
+    const uint32_t *postings;
+} store_index;
+
+static char entries_path[PATH_MAX];
+static char index_path[PATH_MAX];
+static int entries_fd = -1;
+static const char *entries_map = NULL;
+static size_t entries_mapped = 0;
+static store_index mapped = {0};
+static dev_t index_dev;
+static ino_t index_ino;
+
+/* Background index build */
+static pthread_mutex_t build_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t build_thread;
+static int build_started = 0;   /* build_thread needs joining */
+static int building = 0;
+static int build_stop = 0;
+
+int history_store_path(char *buf, size_t size, const char *name, int create) {
+    const char *xdg = getenv("XDG_DATA_HOME");
+    const char *home = getenv("HOME");
+    const char *dirs[3];
+    size_t num_dirs = 0;
+    int n;
+
+    if (xdg && xdg[0] == '/') {
+        n = snprintf(buf, size, "%s", xdg);
+    } else if (home && *home) {
+        n = snprintf(buf, size, "%s", home);
+        dirs[num_dirs++] = "/.local";
+        dirs[num_dirs++] = "/share";
+    } else {
+        return -1;
+    }
+    if (n < 0 || (size_t)n >= size) return -1;
+    dirs[num_dirs++] = "/ghsh";
+
+    size_t len = (size_t)n;
+    for (size_t i = 0; i < num_dirs; i++) {
+        n = snprintf(buf + len, size - len, "%s", dirs[i]);
+        if (n < 0 || (size_t)n >= size - len) return -1;
+        len += (size_t)n;
+        if (create && mkdir(buf, 0700) != 0 && errno != EEXIST) return -1;
+    }
+
+    n = snprintf(buf + len, size - len, "/%s", name);
+    if (n < 0 || (size_t)n >= size - len) return -1;
+    return 0;
+}
+
+/* Helper function to fold a byte for the index */
+static unsigned char fold(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? (unsigned char)(c - 'A' + 'a') : c;
+}
+
+/* Helper function to get the trigram starting at s */
+static uint32_t gram_at(const char *s) {
+    return (uint32_t)fold((unsigned char)s[0]) << 16 | (uint32_t)fold((unsigned char)s[1]) << 8 |
+           fold((unsigned char)s[2]);
+}
+
+/* Helper function to check the record at off of a mapped entry file;
+ * returns NULL if it is not a whole record */
+static const store_record *record_at(const char *map, size_t size, size_t off) {
+    if (off > size || size - off < sizeof(store_record)) return NULL;
+    const store_record *r = (const store_record *)(map + off);
+    uint64_t needed = sizeof(store_record) + (uint64_t)r->command_len + r->cwd_len + 2;
+    if (r->size % 8 != 0 || r->size < needed || r->size > size - off) return NULL;
+
+    const char *command = (const char *)(r + 1);
+    if (command[r->command_len] != '\0' || command[r->command_len + 1 + r->cwd_len] != '\0') return NULL;
+    return r;
+}
+
+/* Helper function to check an index file and point into it. Returns 0 if
+ * it is sound and covers no more than entries_size bytes. */
+static int index_layout(store_index *idx, const char *map, size_t size, size_t entries_size) {
+    memset(idx, 0, sizeof(*idx));
+    if (size < sizeof(index_header)) return -1;
+    const index_header *hdr = (const index_header *)map;
+    if (memcmp(hdr->magic, INDEX_MAGIC, MAGIC_LEN) != 0) return -1;
+    if (hdr->num_entries > UINT32_MAX || hdr->num_grams > (1u << 24) || hdr->num_postings > SIZE_MAX / 8) {
+        return -1;
+    }
+
+    uint64_t expected = sizeof(index_header) + hdr->num_entries * sizeof(uint64_t) +
+                        hdr->num_grams * sizeof(index_gram) + hdr->num_postings * sizeof(uint32_t);
+    if (expected != size || hdr->entries_end > entries_size) return -1;
+
+    idx->map = map;
+    idx->size = size;
+    idx->hdr = hdr;
+    idx->offsets = (const uint64_t *)(map + sizeof(index_header));
+    idx->grams = (const index_gram *)(idx->offsets + hdr->num_entries);
+    idx->postings = (const uint32_t *)(idx->grams + hdr->num_grams);
+    return 0;
+}
+
+/* Helper function to map a whole file read-only */
+static const char *map_file(int fd, size_t size) {
+    if (size == 0) return NULL;
+    void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    return map == MAP_FAILED ? NULL : map;
+}
+
+/* Helper function to map the entry file again once it has grown */
+static void refresh_entries(void) {
+    struct stat st;
+    if (entries_fd < 0 || fstat(entries_fd, &st) != 0 || (size_t)st.st_size == entries_mapped) return;
+
+    if (entries_map) munmap((void *)entries_map, entries_mapped);
+    entries_map = map_file(entries_fd, (size_t)st.st_size);
+    entries_mapped = entries_map ? (size_t)st.st_size : 0;
+}
+
+/* Helper function to drop the mapped index */
+static void unmap_index(void) {
+    if (mapped.map) munmap((void *)mapped.map, mapped.size);
+    memset(&mapped, 0, sizeof(mapped));
+}
+
+/* Helper function to map the index again once it has been rebuilt (here
+ * or in another shell) */
+static void refresh_index(void) {
+    struct stat st;
+    if (stat(index_path, &st) != 0) {
+        unmap_index();
+        return;
+    }
+    if (mapped.map && st.st_dev == index_dev && st.st_ino == index_ino && (size_t)st.st_size == mapped.size &&
+        mapped.hdr->entries_end <= entries_mapped) {
+        return;
+    }
+    unmap_index();
+
+    int fd = open(index_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    if (fstat(fd, &st) == 0) {
+        const char *map = map_file(fd, (size_t)st.st_size);
+        if (map && index_layout(&mapped, map, (size_t)st.st_size, entries_mapped) != 0) {
+            munmap((void *)map, (size_t)st.st_size);
+        }
+        index_dev = st.st_dev;
+        index_ino = st.st_ino;
+    }
+    close(fd);
+}
+
+/* Helper function to find where the index ends in the entry file */
+static size_t indexed_end(void) {
+    return mapped.hdr ? (size_t)mapped.hdr->entries_end : MAGIC_LEN;
+}
+
+/* Growable array of 64-bit values */
+typedef struct u64_array {
+    uint64_t *items;
+    size_t count;
+    size_t cap;
+} u64_array;
+
+/* Helper function to append to a u64_array */
+static int u64_push(u64_array *a, uint64_t v) {
+    if (a->count == a->cap) {
+        size_t new_cap = a->cap ? a->cap * 2 : 4096;
+        uint64_t *new_items = realloc(a->items, new_cap * sizeof(uint64_t));
+        if (!new_items) return -1;
+        a->items = new_items;
+        a->cap = new_cap;
+    }
+    a->items[a->count++] = v;
+    return 0;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* Helper function to check whether the build should give up */
+static int build_cancelled(void) {
+    pthread_mutex_lock(&build_lock);
+    int stop = build_stop;
+    pthread_mutex_unlock(&build_lock);
+    return stop;
+}
+
+/* A trigram of the merged index: from the old index, the new entries or
+ * both */
+typedef struct merged_gram {
+    uint32_t gram;
+    uint32_t old_count;
+    uint64_t old_first;
+    size_t new_first;       /* Into the sorted (trigram, entry) pairs */
+    size_t new_count;
+} merged_gram;
+
+/* Helper function to write the index again, adding the entries appended
+ * since it was built. The old entry numbers and each trigram's old list
+ * are copied over and the new ones appended, so the cost is one pass over
+ * the old index plus sorting the new entries' trigrams. */
+static void build_index(void) {
+    int fd = open(entries_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+
+    /* Shells building at the same time each write a whole index; the last
+     * one renamed stays */
+    const char *map = NULL, *old_map = NULL;
+    size_t size = 0, old_size = 0;
+    u64_array offsets = {0}, pairs = {0};
+    merged_gram *merged = NULL;
+    FILE *out = NULL;
+    char tmp[PATH_MAX] = "";
+    struct stat st;
+    if (fstat(fd, &st) != 0) goto done;
+    size = (size_t)st.st_size;
+    map = map_file(fd, size);
+    if (!map) goto done;
+
+    store_index old = {0};
+    int old_fd = open(index_path, O_RDONLY | O_CLOEXEC);
+    if (old_fd >= 0) {
+        if (fstat(old_fd, &st) == 0) {
+            old_size = (size_t)st.st_size;
+            old_map = map_file(old_fd, old_size);
+            if (old_map && index_layout(&old, old_map, old_size, size) != 0) memset(&old, 0, sizeof(old));
+        }
+        close(old_fd);
+    }
+    uint64_t old_entries = old.hdr ? old.hdr->num_entries : 0;
+
+    /* Trigrams of the new entries as (trigram << 32 | entry number) */
+    size_t off = old.hdr ? (size_t)old.hdr->entries_end : MAGIC_LEN;
+    uint32_t grams[1024];
+    const store_record *r;
+    while ((r = record_at(map, size, off)) != NULL) {
+        uint64_t number = old_entries + offsets.count;
+        if (number >= UINT32_MAX || u64_push(&offsets, off) != 0) goto done;
+        if (offsets.count % 4096 == 0 && build_cancelled()) goto done;
+
+        /* Each trigram once per entry */
+        const char *command = (const char *)(r + 1);
+        for (size_t start = 0; start + 2 < r->command_len; start += 1000) {
+            size_t n = 0;
+            for (size_t i = start; i + 2 < r->command_len && n < 1000; i++) grams[n++] = gram_at(command + i);
+            qsort(grams, n, sizeof(uint32_t), compare_u32);
+            for (size_t i = 0; i < n; i++) {
+                if (i > 0 && grams[i] == grams[i - 1]) continue;
+                if (u64_push(&pairs, (uint64_t)grams[i] << 32 | number) != 0) goto done;
+            }
+        }
+        off += r->size;
+    }
+    if (offsets.count == 0 && old.hdr) goto done;
+    qsort(pairs.items, pairs.count, sizeof(uint64_t), compare_u64);
+
+    /* Long commands were split above, so drop repeats across the pieces */
+    size_t kept = 0;
+    for (size_t i = 0; i < pairs.count; i++) {
+        if (kept == 0 || pairs.items[i] != pairs.items[kept - 1]) pairs.items[kept++] = pairs.items[i];
+    }
+    pairs.count = kept;
+
+    /* Merge the trigram lists */
+    uint64_t old_grams = old.hdr ? old.hdr->num_grams : 0;
+    merged = malloc((old_grams + pairs.count + 1) * sizeof(merged_gram));
+    if (!merged) goto done;
+    size_t num_merged = 0;
+    size_t o = 0, p = 0;
+    while (o < old_grams || p < pairs.count) {
+        uint32_t old_gram = o < old_grams ? old.grams[o].gram : UINT32_MAX;
+        uint32_t new_gram = p < pairs.count ? (uint32_t)(pairs.items[p] >> 32) : UINT32_MAX;
+        merged_gram *m = &merged[num_merged++];
+        memset(m, 0, sizeof(*m));
+        m->gram = old_gram < new_gram ? old_gram : new_gram;
+        if (old_gram == m->gram) {
+            m->old_count = old.grams[o].count;
+            m->old_first = old.grams[o].first;
+            o++;
+        }
+        if (new_gram == m->gram) {
+            m->new_first = p;
+            while (p < pairs.count && (uint32_t)(pairs.items[p] >> 32) == m->gram) p++;
+            m->new_count = p - m->new_first;
+        }
+    }
+
+    /* Write it out and rename it over the old one */
+    if (snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", index_path, (long)getpid()) >= (int)sizeof(tmp)) {
+        tmp[0] = '\0';
+        goto done;
+    }
+    int out_fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (out_fd < 0 || !(out = fdopen(out_fd, "w"))) {
+        if (out_fd >= 0) close(out_fd);
+        goto done;
+    }
+
+    index_header hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, INDEX_MAGIC, MAGIC_LEN);
+    hdr.entries_end = off;
+    hdr.num_entries = old_entries + offsets.count;
+    hdr.num_grams = num_merged;
+    hdr.num_postings = (old.hdr ? old.hdr->num_postings : 0) + pairs.count;
+    fwrite(&hdr, sizeof(hdr), 1, out);
+    if (old_entries) fwrite(old.offsets, sizeof(uint64_t), old_entries, out);
+    if (offsets.count) fwrite(offsets.items, sizeof(uint64_t), offsets.count, out);
+
+    uint64_t first = 0;
+    for (size_t i = 0; i < num_merged; i++) {
+        index_gram g = {merged[i].gram, (uint32_t)(merged[i].old_count + merged[i].new_count), first};
+        fwrite(&g, sizeof(g), 1, out);
+        first += g.count;
+    }
+    for (size_t i = 0; i < num_merged; i++) {
+        if (i % 4096 == 0 && build_cancelled()) goto done;
+        if (merged[i].old_count) {
+            fwrite(old.postings + merged[i].old_first, sizeof(uint32_t), merged[i].old_count, out);
+        }
+        for (size_t j = 0; j < merged[i].new_count; j++) {
+            uint32_t number = (uint32_t)pairs.items[merged[i].new_first + j];
+            fwrite(&number, sizeof(number), 1, out);
+        }
+    }
+
+    int ok = !ferror(out);
+    if (fclose(out) != 0) ok = 0;
+    out = NULL;
+    if (ok && rename(tmp, index_path) == 0) tmp[0] = '\0';
+
+done:
+    if (out) fclose(out);
+    if (tmp[0]) unlink(tmp);
+    free(merged);
+    free(pairs.items);
+    free(offsets.items);
+    if (old_map) munmap((void *)old_map, old_size);
+    if (map) munmap((void *)map, size);
+    close(fd);
+}
+
+static void *build_main(void *arg) {
+    (void)arg;
+    build_index();
+    pthread_mutex_lock(&build_lock);
+    building = 0;
+    pthread_mutex_unlock(&build_lock);
+    return NULL;
+}
+
+/* Helper function to start an index build once enough entries are
+ * unindexed; the more entries are indexed, the more it waits for, so
+ * rebuilding stays cheap on average */
+static void maybe_build(void) {
+    size_t end = indexed_end();
+    size_t tail = entries_mapped > end ? entries_mapped - end : 0;
+    if (tail < GHOST_STORE_MIN_TAIL || tail < end / GHOST_STORE_TAIL_SHARE) return;
+
+    pthread_mutex_lock(&build_lock);
+    int busy = building;
+    pthread_mutex_unlock(&build_lock);
+    if (busy) return;
+    if (build_started) {
+        pthread_join(build_thread, NULL);
+        build_started = 0;
+    }
+
+    building = 1;
+    build_stop = 0;
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    build_started = pthread_create(&build_thread, NULL, build_main, NULL) == 0;
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (!build_started) building = 0;
+}
+
+int history_store_open(void) {
+    if (entries_fd >= 0) return 0;
+    if (history_store_path(entries_path, sizeof(entries_path), GHOST_STORE_ENTRIES_FILE, 1) != 0 ||
+        history_store_path(index_path, sizeof(index_path), GHOST_STORE_INDEX_FILE, 0) != 0) {
+        return -1;
+    }
+
+    int fd = open(entries_path, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) return -1;
+
+    /* Start a new file, or drop the end of a record cut short by a crash,
+     * which would hide everything appended after it */
+    int created = 0;
+    struct stat st;
+    char magic[MAGIC_LEN];
+    if (flock(fd, LOCK_EX) != 0 || fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    if (st.st_size == 0) {
+        created = write(fd, ENTRIES_MAGIC, MAGIC_LEN) == MAGIC_LEN;
+        if (!created) {
+            close(fd);
+            return -1;
+        }
+    } else if (pread(fd, magic, MAGIC_LEN, 0) != MAGIC_LEN || memcmp(magic, ENTRIES_MAGIC, MAGIC_LEN) != 0) {
+        fprintf(stderr, "ghost-shell: %s: not a history store\n", entries_path);
+        close(fd);
+        return -1;
+    }
+    entries_fd = fd;
+
+    refresh_entries();
+    refresh_index();
+    size_t off = indexed_end();
+    const store_record *r;
+    while ((r = record_at(entries_map, entries_mapped, off)) != NULL) off += r->size;
+    if (off < entries_mapped && ftruncate(fd, (off_t)off) == 0) refresh_entries();
+    flock(fd, LOCK_UN);
+
+    maybe_build();
+    return created;
+}
+
+void history_store_add(const char *command, const char *cwd, time_t when, int status) {
+    if (entries_fd < 0 || !command || !*command) return;
+    if (!cwd) cwd = "";
+
+    size_t command_len = strlen(command), cwd_len = strlen(cwd);
+    size_t size = (sizeof(store_record) + command_len + cwd_len + 2 + 7) & ~(size_t)7;
+    if (command_len > UINT32_MAX / 2 || cwd_len > UINT32_MAX / 2) return;
+    char *buf = calloc(1, size);
+    if (!buf) return;
+
+    store_record *r = (store_record *)buf;
+    r->size = (uint32_t)size;
+    r->status = status;
+    r->time = (int64_t)when;
+    r->command_len = (uint32_t)command_len;
+    r->cwd_len = (uint32_t)cwd_len;
+    memcpy(buf + sizeof(*r), command, command_len);
+    memcpy(buf + sizeof(*r) + command_len + 1, cwd, cwd_len);
+
+    /* One write, so entries from several shells do not interleave; the
+     * shared lock keeps a shell starting up from taking it for the end of
+     * a record cut short */
+    if (flock(entries_fd, LOCK_SH) == 0) {
+        ssize_t written;
+        do {
+            written = write(entries_fd, buf, size);
+        } while (written < 0 && errno == EINTR);
+        flock(entries_fd, LOCK_UN);
+    }
+    free(buf);
+
+    refresh_entries();
+    refresh_index();
+    maybe_build();
+}
+
+/* How a query matches commands */
+typedef struct matcher {
+    const history_query *query;
+    const char *pattern;
+    size_t len;
+    int ignore_case;
+    int use_regex;
+    regex_t regex;
+    uint32_t grams[256];    /* Trigrams every match contains */
+    size_t num_grams;
+} matcher;
+
+/* Helper function to add the trigrams of text[0..len) to a matcher */
+static void add_grams(matcher *m, const char *text, size_t len) {
+    for (size_t i = 0; i + 2 < len && m->num_grams < sizeof(m->grams) / sizeof(m->grams[0]); i++) {
+        uint32_t g = gram_at(text + i);
+        size_t j = 0;
+        while (j < m->num_grams && m->grams[j] != g) j++;
+        if (j == m->num_grams) m->grams[m->num_grams++] = g;
+    }
+}
+
+/* Helper function to collect the trigrams of the literal runs a regex
+ * cannot match without. Anything in groups or brackets, and a character
+ * made optional by *, ? or {, ends a run; with | nothing is required. */
+static void add_regex_grams(matcher *m, const char *re) {
+    char run[256];
+    size_t len = 0;
+    for (const char *p = re; *p; p++) {
+        if (*p == '|') {
+            m->num_grams = 0;
+            return;
+        }
+    }
+
+    for (const char *p = re;; p++) {
+        char c = *p;
+        int literal = 0, optional = 0;
+        if (c == '\\' && p[1]) {
+            c = *++p;
+            literal = !isalnum((unsigned char)c);
+        } else if (c == '*' || c == '?' || c == '{') {
+            optional = 1;
+            if (c == '{') {
+                while (p[1] && p[1] != '}') p++;
+                if (p[1]) p++;
+            }
+        } else if (c == '[') {
+            if (p[1] == '^') p++;
+            if (p[1] == ']') p++;
+            while (p[1] && p[1] != ']') p++;
+            if (p[1]) p++;
+        } else if (c == '(') {
+            int depth = 1;
+            while (p[1] && depth > 0) {
+                p++;
+                if (*p == '\\' && p[1]) {
+                    p++;
+                } else if (*p == '(') {
+                    depth++;
+                } else if (*p == ')') {
+                    depth--;
+                }
+            }
+        } else if (c && !strchr(".^$+)", c)) {
+            literal = 1;
+        }
+
+        if (literal && len < sizeof(run)) {
+            run[len++] = c;
+            continue;
+        }
+        if (optional && len > 0) len--;
+        add_grams(m, run, len);
+        len = 0;
+        if (!*p) break;
+    }
+}
+
+/* Helper function to set up a matcher; a capital in the pattern makes it
+ * case-sensitive */
+static int matcher_init(matcher *m, const history_query *query, char *error, size_t error_size) {
+    memset(m, 0, sizeof(*m));
+    m->query = query;
+    m->pattern = query->pattern ? query->pattern : "";
+    m->len = strlen(m->pattern);
+    m->ignore_case = 1;
+    for (const char *p = m->pattern; *p; p++) {
+        if (isupper((unsigned char)*p)) m->ignore_case = 0;
+    }
+
+    if (query->regex && m->len > 0) {
+        int flags = REG_EXTENDED | REG_NOSUB | (m->ignore_case ? REG_ICASE : 0);
+        int rc = regcomp(&m->regex, m->pattern, flags);
+        if (rc != 0) {
+            char msg[256];
+            regerror(rc, &m->regex, msg, sizeof(msg));
+            snprintf(error, error_size, "%s: %s", m->pattern, msg);
+            return -1;
+        }
+        m->use_regex = 1;
+        add_regex_grams(m, m->pattern);
+    } else {
+        add_grams(m, m->pattern, m->len);
+    }
+    return 0;
+}
+
+/* Helper function to find a substring, ASCII case folded if asked */
+static int contains(const char *hay, size_t hay_len, const char *needle, size_t len, int ignore_case) {
+    if (len == 0) return 1;
+    if (!ignore_case) return hay_len >= len && memmem(hay, hay_len, needle, len) != NULL;
+
+    for (size_t i = 0; i + len <= hay_len; i++) {
+        size_t j = 0;
+        while (j < len && fold((unsigned char)hay[i + j]) == fold((unsigned char)needle[j])) j++;
+        if (j == len) return 1;
+    }
+    return 0;
+}
+
+/* Helper function to check an entry against the query and, if it
+ * matches, pass it to visit. Returns non-zero to stop. */
+static int try_entry(const matcher *m, size_t off, history_visit_fn visit, void *arg) {
+    const store_record *r = record_at(entries_map, entries_mapped, off);
+    if (!r) return 0;
+    const history_query *q = m->query;
+    if (q->since && r->time < q->since) return 0;
+    if (q->until && r->time >= q->until) return 0;
+    if (q->status_filter == 1 && r->status != q->status) return 0;
+    if (q->status_filter == 2 && r->status <= 0) return 0;
+
+    const char *command = (const char *)(r + 1);
+    const char *cwd = command + r->command_len + 1;
+    if (q->cwd && strcmp(cwd, q->cwd) != 0) return 0;
+    if (m->use_regex) {
+        if (regexec(&m->regex, command, 0, NULL, 0) != 0) return 0;
+    } else if (!contains(command, r->command_len, m->pattern, m->len, m->ignore_case)) {
+        return 0;
+    }
+
+    history_entry entry = {command, cwd, (time_t)r->time, r->status};
+    return visit(&entry, arg);
+}
+
+/* Helper function to find the entries of a trigram in the index */
+static const index_gram *find_gram(uint32_t gram) {
+    size_t lo = 0, hi = (size_t)mapped.hdr->num_grams;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (mapped.grams[mid].gram < gram) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < mapped.hdr->num_grams && mapped.grams[lo].gram == gram ? &mapped.grams[lo] : NULL;
+}
+
+/* Helper function to visit the indexed entries that may match, newest
+ * first: those in every trigram's list, or all of them if there are no
+ * trigrams to go by */
+static int search_index(const matcher *m, history_visit_fn visit, void *arg) {
+    size_t total = (size_t)mapped.hdr->num_entries;
+    if (m->num_grams == 0) {
+        for (size_t i = total; i-- > 0;) {
+            if (try_entry(m, (size_t)mapped.offsets[i], visit, arg)) return 1;
+        }
+        return 0;
+    }
+
+    /* Walk the shortest list, looking the others up below where the last
+     * number was found since the numbers only go down */
+    const uint32_t *lists[256];
+    size_t counts[256], bounds[256];
+    size_t shortest = 0;
+    for (size_t g = 0; g < m->num_grams; g++) {
+        const index_gram *ig = find_gram(m->grams[g]);
+        if (!ig) return 0;
+        lists[g] = mapped.postings + ig->first;
+        counts[g] = bounds[g] = ig->count;
+        if (counts[g] < counts[shortest]) shortest = g;
+    }
+
+    for (size_t i = counts[shortest]; i-- > 0;) {
+        uint32_t number = lists[shortest][i];
+        int everywhere = 1;
+        for (size_t g = 0; g < m->num_grams && everywhere; g++) {
+            if (g == shortest) continue;
+            size_t lo = 0, hi = bounds[g];
+            while (lo < hi) {
+                size_t mid = lo + (hi - lo) / 2;
+                if (lists[g][mid] < number) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            bounds[g] = lo;
+            everywhere = lo < counts[g] && lists[g][lo] == number;
+        }
+        if (everywhere && number < total && try_entry(m, (size_t)mapped.offsets[number], visit, arg)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int history_store_search(const history_query *query, history_visit_fn visit, void *arg,
+                         char *error, size_t error_size) {
+    if (entries_fd < 0) {
+        snprintf(error, error_size, "history store not available");
+        return -1;
+    }
+    refresh_entries();
+    refresh_index();
+
+    matcher m;
+    if (matcher_init(&m, query, error, error_size) != 0) return -1;
+
+    /* Entries not indexed yet come last in the file, so they go first */
+    u64_array tail = {0};
+    size_t off = indexed_end();
+    const store_record *r;
+    while ((r = record_at(entries_map, entries_mapped, off)) != NULL) {
+        if (u64_push(&tail, off) != 0) break;
+        off += r->size;
+    }
+    int stopped = 0;
+    for (size_t i = tail.count; i-- > 0 && !stopped;) {
+        stopped = try_entry(&m, (size_t)tail.items[i], visit, arg);
+    }
+    free(tail.items);
+
+    if (!stopped && mapped.hdr) search_index(&m, visit, arg);
+    if (m.use_regex) regfree(&m.regex);
+    return 0;
+}
+
+void history_store_wait(void) {
+    if (build_started) {
+        pthread_join(build_thread, NULL);
+        build_started = 0;
+    }
+}
+
+void history_store_close(void) {
+    if (build_started) {
+        pthread_mutex_lock(&build_lock);
+        build_stop = 1;
+        pthread_mutex_unlock(&build_lock);
+        pthread_join(build_thread, NULL);
+        build_started = 0;
+    }
+
+    unmap_index();
+    if (entries_map) munmap((void *)entries_map, entries_mapped);
+    entries_map = NULL;
+    entries_mapped = 0;
+    if (entries_fd >= 0) close(entries_fd);
+    entries_fd = -1;
+}
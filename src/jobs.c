@@ -0,0 +1,784 @@
+#include "jobs.h"
+#include <signal.h>
+#include <termios.h>
+#include <errno.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <time.h>
+
+/* Reaped statuses waiting to be applied to the job table. The SIGCHLD
+ * handler is the only producer; the shell drains it with SIGCHLD blocked. */
+typedef struct reap_event {
+    pid_t pid;
+    int status;
+    struct timespec when;
+    struct rusage usage;
+} reap_event;
+
+static reap_event reap_ring[GHOST_REAP_RING_SIZE];
+static volatile unsigned reap_head = 0;
+static volatile unsigned reap_tail = 0;
+
+/* Job table state */
+static job *job_list = NULL;
+static unsigned long job_seq = 0;
+static int reaper_installed = 0;
+static int job_control = 0;
+static pid_t shell_pgid = 0;
+static struct termios shell_tmodes;
+static volatile sig_atomic_t wait_interrupted = 0;
+
+/* Signals an interactive shell ignores and its children must not inherit */
+static const int job_signals[] = {SIGINT, SIGQUIT, SIGTSTP, SIGTTIN, SIGTTOU};
+
+/* Collect every child status that is ready, as long as there is room */
+static void reap_children(void) {
+    while (reap_head - reap_tail < GHOST_REAP_RING_SIZE) {
+        reap_event *ev_slot = &reap_ring[reap_head % GHOST_REAP_RING_SIZE];
+        int status;
+        pid_t pid = wait4(-1, &status, WNOHANG | WUNTRACED | WCONTINUED, &ev_slot->usage);
+        if (pid <= 0) break;
+        clock_gettime(CLOCK_MONOTONIC, &ev_slot->when);
+        ev_slot->pid = pid;
+        ev_slot->status = status;
+        reap_head++;
+    }
+}
+
+static void sigchld_handler(int sig) {
+    (void)sig;
+    int saved_errno = errno;
+    reap_children();
+    errno = saved_errno;
+}
+
+static void sigint_wait_handler(int sig) {
+    (void)sig;
+    wait_interrupted = 1;
+}
+
+static void install_reaper(void) {
+    if (reaper_installed) return;
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sigchld_handler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;  /* Don't disturb libedit's read() */
+    sigaction(SIGCHLD, &sa, NULL);
+    reaper_installed = 1;
+}
+
+static void block_sigchld(sigset_t *old) {
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &set, old);
+}
+
+static job_process *find_process(pid_t pid, job **owner) {
+    for (job *j = job_list; j; j = j->next) {
+        for (size_t i = 0; i < j->num_procs; i++) {
+            if (j->procs[i].pid == pid) {
+                if (owner) *owner = j;
+                return &j->procs[i];
+            }
+        }
+    }
+    return NULL;
+}
+
+/* Apply buffered statuses to the job table. Must run with SIGCHLD blocked. */
+static void apply_reaped(void) {
+    /* A full ring leaves children unreaped; pick them up now */
+    reap_children();
+
+    while (reap_tail != reap_head) {
+        reap_event *e = &reap_ring[reap_tail % GHOST_REAP_RING_SIZE];
+        job *owner = NULL;
+        job_process *p = find_process(e->pid, &owner);
+        if (p) {
+            p->status = e->status;
+            if (WIFSTOPPED(e->status)) {
+                p->state = PROC_STOPPED;
+                owner->notified = 0;
+            } else if (WIFCONTINUED(e->status)) {
+                p->state = PROC_RUNNING;
+            } else {
+                p->state = PROC_DONE;
+                p->finished = e->when;
+                p->usage = e->usage;
+            }
+        }
+        reap_tail++;
+        if (reap_tail == reap_head) {
+            reap_tail = reap_head = 0;
+            reap_children();
+        }
+    }
+}
+
+/* Drain the ring from normal (non-handler) context */
+static void update_jobs(void) {
+    sigset_t old;
+    block_sigchld(&old);
+    apply_reaped();
+    sigprocmask(SIG_SETMASK, &old, NULL);
+}
+
+static int job_is_done(job *j) {
+    for (size_t i = 0; i < j->num_procs; i++) {
+        if (j->procs[i].state != PROC_DONE) return 0;
+    }
+    return 1;
+}
+
+static int job_is_stopped(job *j) {
+    int stopped = 0;
+    for (size_t i = 0; i < j->num_procs; i++) {
+        if (j->procs[i].state == PROC_RUNNING) return 0;
+        if (j->procs[i].state == PROC_STOPPED) stopped = 1;
+    }
+    return stopped;
+}
+
+/* Convert the status of a job's last process into a shell status */
+static int job_status(job *j) {
+    if (j->num_procs == 0) return 0;
+    job_process *last = &j->procs[j->num_procs - 1];
+    int status = last->status;
+
+    if (last->state == PROC_STOPPED) return 128 + WSTOPSIG(status);
+    if (WIFSIGNALED(status)) return 128 + WTERMSIG(status);
+    return WEXITSTATUS(status);
+}
+
+static void free_job(job *j) {
+    if (!j) return;
+    free(j->command);
+    free(j->procs);
+    free(j);
+}
+
+static void remove_job(job *j) {
+    job **link = &job_list;
+    while (*link && *link != j) {
+        link = &(*link)->next;
+    }
+    if (*link) *link = j->next;
+    free_job(j);
+}
+
+/* Jobs the user can refer to: not the pipeline the shell is running right now */
+static int job_visible(job *j) {
+    return j->background || job_is_stopped(j);
+}
+
+/* Most recently started or stopped job (%+), and the one before it (%-) */
+static job *current_job(int which) {
+    job *best = NULL, *second = NULL;
+    for (job *j = job_list; j; j = j->next) {
+        if (!job_visible(j)) continue;
+        if (!best || j->seq > best->seq) {
+            second = best;
+            best = j;
+        } else if (!second || j->seq > second->seq) {
+            second = j;
+        }
+    }
+    return which == 0 ? best : second;
+}
+
+static char job_marker(job *j) {
+    if (j == current_job(0)) return '+';
+    if (j == current_job(1)) return '-';
+    return ' ';
+}
+
+static const char *job_state_text(job *j, char *buf, size_t size) {
+    if (job_is_stopped(j)) return "Stopped";
+    if (!job_is_done(j)) return "Running";
+
+    int status = j->procs[j->num_procs - 1].status;
+    if (WIFSIGNALED(status)) {
+        snprintf(buf, size, "Terminated (signal %d)", WTERMSIG(status));
+    } else if (WEXITSTATUS(status) != 0) {
+        snprintf(buf, size, "Exit %d", WEXITSTATUS(status));
+    } else {
+        return "Done";
+    }
+    return buf;
+}
+
+static void print_job(job *j, int with_pids) {
+    char buf[64];
+    printf("[%d]%c  %-24s %s", j->id, job_marker(j),
+           job_state_text(j, buf, sizeof(buf)), j->command);
+    if (with_pids) {
+        for (size_t i = 0; i < j->num_procs; i++) {
+            printf("%s%d", i == 0 ? "  (" : " ", (int)j->procs[i].pid);
+        }
+        printf(")");
+    }
+    printf("\n");
+}
+
+/* Helper function to rebuild a printable command line from the pipeline */
+static char *pipeline_text(ghost_command *cmd) {
+    size_t len = 1;
+    for (ghost_command *c = cmd; c; c = c->next) {
+        for (size_t i = 0; i < c->arg_count; i++) {
+            len += strlen(c->args[i]) + 1;
+        }
+        len += 3;
+    }
+
+    char *text = malloc(len);
+    if (!text) return NULL;
+    text[0] = '\0';
+
+    for (ghost_command *c = cmd; c; c = c->next) {
+        if (c != cmd) strcat(text, " | ");
+        for (size_t i = 0; i < c->arg_count; i++) {
+            if (i > 0) strcat(text, " ");
+            strcat(text, c->args[i]);
+        }
+    }
+    return text;
+}
+
+void jobs_init(int interactive) {
+    install_reaper();
+
+    if (!interactive || !isatty(STDIN_FILENO)) {
+        job_control = 0;
+        return;
+    }
+
+    /* Wait until we are in the foreground before taking over the terminal */
+    while (tcgetpgrp(STDIN_FILENO) != (shell_pgid = getpgrp())) {
+        kill(-shell_pgid, SIGTTIN);
+    }
+
+    for (size_t i = 0; i < sizeof(job_signals) / sizeof(job_signals[0]); i++) {
+        signal(job_signals[i], SIG_IGN);
+    }
+
+    /* Put the shell in its own process group and grab the terminal */
+    shell_pgid = getpid();
+    if (getpgrp() != shell_pgid && setpgid(shell_pgid, shell_pgid) < 0) {
+        perror("ghost-shell: setpgid failed");
+        return;
+    }
+    tcsetpgrp(STDIN_FILENO, shell_pgid);
+    tcgetattr(STDIN_FILENO, &shell_tmodes);
+    job_control = 1;
+}
+
+void jobs_cleanup(void) {
+    while (job_list) {
+        job *next = job_list->next;
+        free_job(job_list);
+        job_list = next;
+    }
+}
+
+int jobs_control_enabled(void) {
+    return job_control;
+}
+
+void jobs_child_signals(sigset_t *set) {
+    sigemptyset(set);
+    for (size_t i = 0; i < sizeof(job_signals) / sizeof(job_signals[0]); i++) {
+        sigaddset(set, job_signals[i]);
+    }
+    sigaddset(set, SIGCHLD);
+    sigaddset(set, SIGPIPE);
+}
+
+void jobs_child_setup(pid_t pgid) {
+    if (pgid >= 0) {
+        setpgid(0, pgid);
+    }
+
+    sigset_t set;
+    jobs_child_signals(&set);
+    for (int sig = 1; sig < NSIG; sig++) {
+        if (sigismember(&set, sig) == 1) {
+            signal(sig, SIG_DFL);
+        }
+    }
+    sigemptyset(&set);
+    sigprocmask(SIG_SETMASK, &set, NULL);
+}
+
+void jobs_hold_reaper(sigset_t *old) {
+    block_sigchld(old);
+}
+
+void jobs_release_reaper(const sigset_t *old) {
+    sigprocmask(SIG_SETMASK, old, NULL);
+}
+
+job *job_create(ghost_command *cmd) {
+    install_reaper();
+
+    job *j = calloc(1, sizeof(job));
+    if (!j) return NULL;
+
+    j->command = pipeline_text(cmd);
+    if (!j->command) {
+        free(j);
+        return NULL;
+    }
+
+    /* Lowest free job number */
+    int id = 1;
+    for (int taken = 1; taken; ) {
+        taken = 0;
+        for (job *o = job_list; o; o = o->next) {
+            if (o->id == id) {
+                id++;
+                taken = 1;
+            }
+        }
+    }
+    j->id = id;
+    j->seq = ++job_seq;
+
+    /* Keep the table ordered by job number */
+    job **link = &job_list;
+    while (*link && (*link)->id < id) {
+        link = &(*link)->next;
+    }
+    j->next = *link;
+    *link = j;
+    return j;
+}
+
+void job_add_process(job *j, pid_t pid) {
+    job_process *procs = realloc(j->procs, (j->num_procs + 1) * sizeof(job_process));
+    if (!procs) {
+        /* Can't track it; the reaper still collects it */
+        return;
+    }
+    j->procs = procs;
+    j->procs[j->num_procs].pid = pid;
+    j->procs[j->num_procs].status = 0;
+    j->procs[j->num_procs].state = PROC_RUNNING;
+    clock_gettime(CLOCK_MONOTONIC, &j->procs[j->num_procs].started);
+    memset(&j->procs[j->num_procs].finished, 0, sizeof(struct timespec));
+    memset(&j->procs[j->num_procs].usage, 0, sizeof(struct rusage));
+    j->num_procs++;
+
+    if (job_control) {
+        if (j->pgid == 0) j->pgid = pid;
+        /* Also set from the parent so there is no window before exec */
+        setpgid(pid, j->pgid);
+    }
+}
+
+pid_t job_pgid(job *j) {
+    if (!job_control) return -1;
+    return j ? j->pgid : 0;
+}
+
+void job_give_terminal(job *j) {
+    if (job_control && j->pgid > 0) {
+        tcsetpgrp(STDIN_FILENO, j->pgid);
+    }
+}
+
+int job_wait_foreground(job *j, int cont) {
+    sigset_t old;
+    block_sigchld(&old);
+    sigset_t wait_mask = old;
+    sigdelset(&wait_mask, SIGCHLD);
+
+    j->background = 0;
+    if (job_control && j->pgid > 0) {
+        tcsetpgrp(STDIN_FILENO, j->pgid);
+    }
+    if (cont && j->pgid > 0) {
+        for (size_t i = 0; i < j->num_procs; i++) {
+            if (j->procs[i].state == PROC_STOPPED) j->procs[i].state = PROC_RUNNING;
+        }
+        kill(job_control ? -j->pgid : j->pgid, SIGCONT);
+    }
+
+    for (;;) {
+        apply_reaped();
+        if (job_is_done(j)) break;
+        if (job_is_stopped(j)) {
+            /* A stage that touched the tty before it owned it gets SIGTTIN;
+             * it owns the terminal now, so let it carry on */
+            int tty_stop = 1;
+            for (size_t i = 0; i < j->num_procs; i++) {
+                if (j->procs[i].state == PROC_STOPPED) {
+                    int sig = WSTOPSIG(j->procs[i].status);
+                    if (sig != SIGTTIN && sig != SIGTTOU) tty_stop = 0;
+                }
+            }
+            if (!(job_control && tty_stop && j->pgid > 0)) break;
+            for (size_t i = 0; i < j->num_procs; i++) {
+                if (j->procs[i].state == PROC_STOPPED) j->procs[i].state = PROC_RUNNING;
+            }
+            kill(-j->pgid, SIGCONT);
+            continue;
+        }
+        sigsuspend(&wait_mask);
+    }
+
+    if (job_control) {
+        tcsetpgrp(STDIN_FILENO, shell_pgid);
+        tcsetattr(STDIN_FILENO, TCSADRAIN, &shell_tmodes);
+    }
+    sigprocmask(SIG_SETMASK, &old, NULL);
+
+    int status = job_status(j);
+    if (job_is_stopped(j)) {
+        j->seq = ++job_seq;
+        j->notified = 1;
+        printf("\n");
+        print_job(j, 0);
+    } else {
+        if (WIFSIGNALED(j->procs[j->num_procs - 1].status)) {
+            int sig = WTERMSIG(j->procs[j->num_procs - 1].status);
+            if (sig == SIGINT) {
+                printf("\n");  /* Move past the ^C echo */
+            } else if (sig != SIGPIPE) {
+                fprintf(stderr, "ghost-shell: terminated by signal %d\n", sig);
+            }
+        }
+        if (!j->keep) remove_job(j);
+    }
+    return status;
+}
+
+void job_put_background(job *j, int cont) {
+    j->background = 1;
+    j->seq = ++job_seq;
+    if (cont && j->pgid > 0) {
+        for (size_t i = 0; i < j->num_procs; i++) {
+            if (j->procs[i].state == PROC_STOPPED) j->procs[i].state = PROC_RUNNING;
+        }
+        kill(job_control ? -j->pgid : j->pgid, SIGCONT);
+        printf("[%d]%c %s &\n", j->id, job_marker(j), j->command);
+    } else if (j->num_procs > 0 && job_control) {
+        printf("[%d] %d\n", j->id, (int)j->procs[j->num_procs - 1].pid);
+    }
+}
+
+job *jobs_wait_any(job *const *set, size_t n, volatile sig_atomic_t *stop) {
+    sigset_t old;
+    block_sigchld(&old);
+    sigset_t wait_mask = old;
+    sigdelset(&wait_mask, SIGCHLD);
+
+    job *done = NULL;
+    while (!done && !(stop && *stop)) {
+        apply_reaped();
+        for (size_t i = 0; i < n && !done; i++) {
+            if (set[i] && job_is_done(set[i])) done = set[i];
+        }
+        if (!done && !(stop && *stop)) sigsuspend(&wait_mask);
+    }
+
+    sigprocmask(SIG_SETMASK, &old, NULL);
+    return done;
+}
+
+int job_exit_status(job *j) {
+    return job_status(j);
+}
+
+void job_signal(job *j, int sig) {
+    if (job_control && j->pgid > 0) {
+        kill(-j->pgid, sig);
+        return;
+    }
+    for (size_t i = 0; i < j->num_procs; i++) {
+        if (j->procs[i].state != PROC_DONE) kill(j->procs[i].pid, sig);
+    }
+}
+
+int job_finished(job *j) {
+    return job_is_done(j);
+}
+
+void job_discard(job *j) {
+    remove_job(j);
+}
+
+void jobs_notify(void) {
+    update_jobs();
+
+    job *j = job_list;
+    while (j) {
+        job *next = j->next;
+        if (job_is_done(j)) {
+            if (j->background) print_job(j, 0);
+            remove_job(j);
+        } else if (job_is_stopped(j) && !j->notified) {
+            print_job(j, 0);
+            j->notified = 1;
+        }
+        j = next;
+    }
+    fflush(stdout);
+}
+
+void jobs_prune(void) {
+    update_jobs();
+
+    job *j = job_list;
+    while (j) {
+        job *next = j->next;
+        if (j->background && !j->keep && job_is_done(j)) remove_job(j);
+        j = next;
+    }
+}
+
+/* Resolve a job spec: %n, %%, %+, %-, %prefix (or no argument for %+) */
+static job *find_job(const char *spec, const char *builtin) {
+    update_jobs();
+
+    job *j = NULL;
+    if (!spec || strcmp(spec, "%%") == 0 || strcmp(spec, "%+") == 0 || strcmp(spec, "%") == 0) {
+        j = current_job(0);
+    } else if (strcmp(spec, "%-") == 0) {
+        j = current_job(1);
+    } else {
+        const char *s = spec[0] == '%' ? spec + 1 : spec;
+        char *end;
+        long id = strtol(s, &end, 10);
+        for (j = job_list; j; j = j->next) {
+            if (!job_visible(j)) continue;
+            if (*s && *end == '\0' ? j->id == id : strncmp(j->command, s, strlen(s)) == 0) break;
+        }
+    }
+
+    if (!j) {
+        char error_msg[256];
+        snprintf(error_msg, sizeof(error_msg), "%s: %s: no such job", builtin, spec ? spec : "current");
+        print_error(error_msg);
+    }
+    return j;
+}
+
+int builtin_jobs(ghost_command *cmd, shell_context *ctx) {
+    (void)ctx;  /* Unused parameter */
+
+    int with_pids = cmd->arg_count > 1 && strcmp(cmd->args[1], "-l") == 0;
+    update_jobs();
+
+    job *j = job_list;
+    while (j) {
+        job *next = j->next;
+        if (!job_visible(j)) {
+            j = next;
+            continue;
+        }
+        print_job(j, with_pids);
+        if (job_is_done(j)) {
+            remove_job(j);
+        } else if (job_is_stopped(j)) {
+            j->notified = 1;
+        }
+        j = next;
+    }
+    return 0;
+}
+
+int builtin_fg(ghost_command *cmd, shell_context *ctx) {
+    (void)ctx;  /* Unused parameter */
+
+    job *j = find_job(cmd->arg_count > 1 ? cmd->args[1] : NULL, "fg");
+    if (!j) return 1;
+
+    printf("%s\n", j->command);
+    fflush(stdout);
+    return job_wait_foreground(j, 1);
+}
+
+int builtin_bg(ghost_command *cmd, shell_context *ctx) {
+    (void)ctx;  /* Unused parameter */
+
+    int status = 0;
+    size_t i = 1;
+    do {
+        job *j = find_job(cmd->arg_count > i ? cmd->args[i] : NULL, "bg");
+        if (!j) {
+            status = 1;
+        } else if (job_is_done(j)) {
+            print_error("bg: job has terminated");
+            status = 1;
+        } else {
+            job_put_background(j, 1);
+        }
+        i++;
+    } while (i < cmd->arg_count);
+    return status;
+}
+
+/* Block until the given job finishes. Ctrl-C interrupts the wait. */
+static int wait_for_job(job *j) {
+    sigset_t old;
+    block_sigchld(&old);
+    sigset_t wait_mask = old;
+    sigdelset(&wait_mask, SIGCHLD);
+
+    while (!wait_interrupted) {
+        apply_reaped();
+        if (job_is_done(j) || job_is_stopped(j)) break;
+        sigsuspend(&wait_mask);
+    }
+    sigprocmask(SIG_SETMASK, &old, NULL);
+
+    if (wait_interrupted) return 128 + SIGINT;
+    int status = job_status(j);
+    if (job_is_done(j)) remove_job(j);
+    return status;
+}
+
+int builtin_wait(ghost_command *cmd, shell_context *ctx) {
+    (void)ctx;  /* Unused parameter */
+
+    /* Let SIGINT end the wait instead of being ignored */
+    struct sigaction sa, old_sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sigint_wait_handler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, &old_sa);
+    wait_interrupted = 0;
+
+    int status = 0;
+    if (cmd->arg_count < 2) {
+        /* Wait for every running job */
+        job *j;
+        while (!wait_interrupted && (j = job_list) != NULL) {
+            while (j && job_is_stopped(j)) j = j->next;
+            if (!j) break;
+            status = wait_for_job(j);
+        }
+        if (!wait_interrupted) status = 0;
+    } else {
+        for (size_t i = 1; i < cmd->arg_count && !wait_interrupted; i++) {
+            job *j = NULL;
+            if (cmd->args[i][0] == '%') {
+                j = find_job(cmd->args[i], "wait");
+            } else {
+                pid_t pid = (pid_t)strtol(cmd->args[i], NULL, 10);
+                update_jobs();
+                if (pid <= 0 || !find_process(pid, &j)) {
+                    char error_msg[256];
+                    snprintf(error_msg, sizeof(error_msg),
+                             "wait: pid %s is not a child of this shell", cmd->args[i]);
+                    print_error(error_msg);
+                    j = NULL;
+                }
+            }
+            status = j ? wait_for_job(j) : 127;
+        }
+    }
+
+    sigaction(SIGINT, &old_sa, NULL);
+    if (wait_interrupted) printf("\n");
+    return status;
+}
+
+/* Signal names accepted by kill, with or without the SIG prefix */
+static const struct {
+    const char *name;
+    int number;
+} signal_names[] = {
+    {"HUP", SIGHUP}, {"INT", SIGINT}, {"QUIT", SIGQUIT}, {"KILL", SIGKILL},
+    {"TERM", SIGTERM}, {"STOP", SIGSTOP}, {"CONT", SIGCONT}, {"TSTP", SIGTSTP},
+    {"TTIN", SIGTTIN}, {"TTOU", SIGTTOU}, {"USR1", SIGUSR1}, {"USR2", SIGUSR2},
+    {"ALRM", SIGALRM}, {"PIPE", SIGPIPE}, {"CHLD", SIGCHLD}, {"WINCH", SIGWINCH}
+};
+
+static int parse_signal(const char *s) {
+    char *end;
+    long n = strtol(s, &end, 10);
+    if (*s && *end == '\0') {
+        return (n >= 0 && n < NSIG) ? (int)n : -1;
+    }
+    if (strncmp(s, "SIG", 3) == 0) s += 3;
+    for (size_t i = 0; i < sizeof(signal_names) / sizeof(signal_names[0]); i++) {
+        if (strcasecmp(s, signal_names[i].name) == 0) return signal_names[i].number;
+    }
+    return -1;
+}
+
+int builtin_kill(ghost_command *cmd, shell_context *ctx) {
+    (void)ctx;  /* Unused parameter */
+
+    if (cmd->arg_count < 2) {
+        print_error("kill: usage: kill [-s sigspec | -sigspec] %job | pid ...");
+        return 1;
+    }
+
+    int sig = SIGTERM;
+    size_t i = 1;
+    if (strcmp(cmd->args[1], "-l") == 0) {
+        for (size_t k = 0; k < sizeof(signal_names) / sizeof(signal_names[0]); k++) {
+            printf("%2d) SIG%s\n", signal_names[k].number, signal_names[k].name);
+        }
+        return 0;
+    }
+    if (strcmp(cmd->args[1], "-s") == 0 && cmd->arg_count > 2) {
+        sig = parse_signal(cmd->args[2]);
+        i = 3;
+    } else if (cmd->args[1][0] == '-') {
+        sig = parse_signal(cmd->args[1] + 1);
+        i = 2;
+    }
+    if (sig < 0) {
+        print_error("kill: invalid signal specification");
+        return 1;
+    }
+
+    int status = 0;
+    for (; i < cmd->arg_count; i++) {
+        const char *target = cmd->args[i];
+        int rc;
+        if (target[0] == '%') {
+            job *j = find_job(target, "kill");
+            if (!j) {
+                status = 1;
+                continue;
+            }
+            pid_t dest = job_control && j->pgid > 0 ? -j->pgid : j->procs[0].pid;
+            rc = kill(dest, sig);
+            /* A stopped job only acts on the signal once it runs again */
+            if (rc == 0 && job_is_stopped(j) && sig != SIGKILL && sig != SIGCONT) {
+                kill(dest, SIGCONT);
+            }
+        } else {
+            char *end;
+            long pid = strtol(target, &end, 10);
+            if (!*target || *end != '\0') {
+                char error_msg[256];
+                snprintf(error_msg, sizeof(error_msg),
+                         "kill: %s: arguments must be process or job IDs", target);
+                print_error(error_msg);
+                status = 1;
+                continue;
+            }
+            rc = kill((pid_t)pid, sig);
+        }
+        if (rc < 0) {
+            char error_msg[256];
+            snprintf(error_msg, sizeof(error_msg), "kill: %s: %s", target, strerror(errno));
+            print_error(error_msg);
+            status = 1;
+        }
+    }
+    return status;
+}
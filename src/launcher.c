@@ -0,0 +1,457 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE  /* memfd_create */
+#endif
+#include "launcher.h"
+#include "path_cache.h"
+#include "correction.h"
+#include "jobs.h"
+#include <spawn.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+#ifdef __APPLE__
+#include <mach-o/dyld.h>
+#endif
+
+extern char **environ;
+
+int anon_file_create(const char *name) {
+    int fd = -1;
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+    fd = memfd_create(name, MFD_CLOEXEC);
+    if (fd >= 0) return fd;
+#else
+    (void)name;
+#endif
+
+    /* No memfd: an unlinked temporary file behaves the same */
+    const char *tmpdir = getenv("TMPDIR");
+    char template[PATH_MAX];
+    snprintf(template, sizeof(template), "%s/ghsh.XXXXXX",
+             tmpdir && tmpdir[0] ? tmpdir : "/tmp");
+    fd = mkstemp(template);
+    if (fd < 0) return -1;
+    unlink(template);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+}
+
+int anon_file_write(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+launch_backend launcher_backend(void) {
+    const char *mode = getenv("GHSH_SPAWN");
+    if (mode && strcmp(mode, "fork") == 0) {
+        return LAUNCH_FORK;
+    }
+    return LAUNCH_SPAWN;
+}
+
+/* Helper function to open a redirection target in the parent */
+static int open_redirect(const char *path, int flags) {
+    int fd = open(path, flags | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "ghost-shell: cannot open %s: %s\n", path, strerror(errno));
+    }
+    return fd;
+}
+
+/* Bytes an argument vector occupies in the new process image */
+static size_t argv_bytes(char *const *args, size_t count) {
+    size_t bytes = sizeof(char *);  /* NULL terminator */
+    for (size_t i = 0; i < count; i++) {
+        bytes += strlen(args[i]) + 1 + sizeof(char *);
+    }
+    return bytes;
+}
+
+size_t launcher_arg_limit(void) {
+    long arg_max = sysconf(_SC_ARG_MAX);
+    size_t limit = arg_max > 0 ? (size_t)arg_max : GHOST_ARG_MAX_FALLBACK;
+
+    /* The environment shares the same space */
+    size_t env_bytes = 0;
+    for (char **e = environ; *e; e++) {
+        env_bytes += strlen(*e) + 1 + sizeof(char *);
+    }
+    env_bytes += GHOST_ARG_HEADROOM;
+    return limit > env_bytes ? limit - env_bytes : 0;
+}
+
+/* Helper function for forked children to report an error: only write(2),
+ * since another thread may have held a stdio or malloc lock at fork time */
+static void child_error(const char *name, const char *what) {
+    const char *parts[] = {"ghost-shell: ", name, ": ", what, "\n"};
+    for (size_t i = 0; i < sizeof(parts) / sizeof(parts[0]); i++) {
+        if (write(STDERR_FILENO, parts[i], strlen(parts[i])) < 0) return;
+    }
+}
+
+/* Helper function to split the command into batches of its glob-expanded
+ * arguments, keeping every other word in place in every batch (cmd *.c -v
+ * *.h runs cmd some.c -v some.h), like xargs. Done before forking. The
+ * batches' argv vectors follow each other, each ended by NULL, with one
+ * more NULL after the last. Returns NULL if out of memory. */
+static char **plan_batches(ghost_command *cmd, size_t limit) {
+    size_t fixed = sizeof(char *);  /* The words in every batch, and NULL */
+    size_t num_globbed = 0;
+    for (size_t i = 0; i < cmd->arg_count; i++) {
+        if (command_arg_globbed(cmd, cmd->args[i])) {
+            num_globbed++;
+        } else {
+            fixed += strlen(cmd->args[i]) + 1 + sizeof(char *);
+        }
+    }
+
+    char **plan = NULL;
+    size_t len = 0, cap = 0;
+    size_t next = 0;  /* First glob match not planned yet, counting matches only */
+    while (next < num_globbed) {
+        if (cap - len < cmd->arg_count + 2) {
+            size_t new_cap = cap ? cap * 2 : (cmd->arg_count + 2) * 2;
+            char **new_plan = realloc(plan, new_cap * sizeof(char *));
+            if (!new_plan) {
+                free(plan);
+                return NULL;
+            }
+            plan = new_plan;
+            cap = new_cap;
+        }
+
+        /* Matches next..end go in this batch, as many as fit */
+        size_t bytes = fixed;
+        size_t end = next;
+        size_t match = 0;
+        for (size_t i = 0; i < cmd->arg_count; i++) {
+            if (!command_arg_globbed(cmd, cmd->args[i])) {
+                plan[len++] = cmd->args[i];
+                continue;
+            }
+            if (match++ != end) continue;
+            size_t item = strlen(cmd->args[i]) + 1 + sizeof(char *);
+            if (end > next && bytes + item > limit) continue;
+            bytes += item;
+            plan[len++] = cmd->args[i];
+            end++;
+        }
+        plan[len++] = NULL;
+        next = end;
+    }
+    if (!plan) plan = malloc(sizeof(char *));
+    if (plan) plan[len] = NULL;
+    return plan;
+}
+
+/* Run the planned batches one after another. Runs in a forked child, so it
+ * only spawns and waits; returns 0, or 123 if any batch failed as xargs
+ * does. */
+static int run_batches(const char *name, const char *path, char **plan) {
+    int result = 0;
+    for (char **argv = plan; *argv; ) {
+        pid_t pid;
+        int err = posix_spawn(&pid, path, NULL, NULL, argv, environ);
+        if (err != 0) {
+            child_error(name, strerror(err));
+            return err == ENOENT ? 127 : 126;
+        }
+        while (*argv) argv++;
+        argv++;
+
+        int wstatus = 0;
+        pid_t waited;
+        while ((waited = waitpid(pid, &wstatus, 0)) < 0 && errno == EINTR) {
+        }
+        if (waited < 0) {
+            /* Its status is lost: count the batch as failed */
+            child_error(name, "waitpid failed");
+            result = 123;
+            continue;
+        }
+        if (WIFSIGNALED(wstatus)) return 128 + WTERMSIG(wstatus);
+        if (WEXITSTATUS(wstatus) != 0) result = 123;
+    }
+    return result;
+}
+
+/* Classic fork + execvp path, used when GHSH_SPAWN=fork and to run an
+ * oversized argument list in the batches of plan. The child only does
+ * async-signal-safe work before exec: the shell has other threads. */
+static pid_t fork_stage(ghost_command *cmd, const char *path, int in_fd, int out_fd,
+                        pid_t pgid, int *status, char **plan) {
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("ghost-shell: fork failed");
+        *status = 1;
+        return -1;
+    }
+    if (pid > 0) return pid;
+
+    /* Child process */
+    jobs_child_setup(pgid);
+    
+    if (in_fd >= 0 && in_fd != STDIN_FILENO) {
+        dup2(in_fd, STDIN_FILENO);
+    }
+    if (out_fd >= 0 && out_fd != STDOUT_FILENO) {
+        dup2(out_fd, STDOUT_FILENO);
+    }
+
+    /* Handle input redirection or here-document */
+    if (cmd->here_doc_fd >= 0) {
+        dup2(cmd->here_doc_fd, STDIN_FILENO);
+    } else if (cmd->input_file) {
+        int fd = open(cmd->input_file, O_RDONLY);
+        if (fd < 0) {
+            child_error(cmd->input_file, strerror(errno));
+            _exit(1);
+        }
+        dup2(fd, STDIN_FILENO);
+        close(fd);
+    }
+
+    /* Handle output redirection */
+    if (cmd->output_file) {
+        int flags = O_WRONLY | O_CREAT;
+        flags |= cmd->append_output ? O_APPEND : O_TRUNC;
+
+        int fd = open(cmd->output_file, flags, 0644);
+        if (fd < 0) {
+            child_error(cmd->output_file, strerror(errno));
+            _exit(1);
+        }
+        dup2(fd, STDOUT_FILENO);
+        close(fd);
+    }
+
+    if (plan) {
+        _exit(run_batches(cmd->name, path, plan));
+    }
+
+    /* path contains a slash, so execvp only adds the /bin/sh fallback */
+    execvp(path, cmd->args);
+    int err = errno;
+    child_error(cmd->name, strerror(err));
+    _exit(err == ENOENT ? 127 : 126);
+}
+
+/* Helper function to run a script without a #! line through /bin/sh, as
+ * execvp would: sh gets the script's path and its arguments */
+static int spawn_script(pid_t *pid, const char *path, char *const *argv,
+                        const posix_spawn_file_actions_t *actions, const posix_spawnattr_t *attr) {
+    size_t argc = 0;
+    while (argv[argc]) argc++;
+    char **sh_argv = malloc((argc + 2) * sizeof(char *));
+    if (!sh_argv) return ENOMEM;
+    sh_argv[0] = "sh";
+    sh_argv[1] = (char *)path;
+    for (size_t i = 1; i <= argc; i++) sh_argv[i + 1] = argv[i];
+    int err = posix_spawn(pid, "/bin/sh", actions, attr, sh_argv, environ);
+    free(sh_argv);
+    return err;
+}
+
+/* posix_spawn path: pipe wiring and redirections become dup2 file actions
+ * on descriptors prepared by the parent, so the child never runs shell code.
+ * argv is cmd's own (path found by name) or another program's; cmd may be
+ * NULL when there are no redirections. */
+static pid_t spawn_stage(ghost_command *cmd, const char *path, char *const *argv,
+                         int in_fd, int out_fd, pid_t pgid, int *status) {
+    int file_in = -1, file_out = -1;
+    pid_t pid = -1;
+
+    if (cmd && cmd->here_doc_fd >= 0) {
+        in_fd = cmd->here_doc_fd;
+    } else if (cmd && cmd->input_file) {
+        file_in = open_redirect(cmd->input_file, O_RDONLY);
+        if (file_in < 0) {
+            *status = 1;
+            return -1;
+        }
+        in_fd = file_in;
+    }
+
+    if (cmd && cmd->output_file) {
+        int flags = O_WRONLY | O_CREAT;
+        flags |= cmd->append_output ? O_APPEND : O_TRUNC;
+        file_out = open_redirect(cmd->output_file, flags);
+        if (file_out < 0) {
+            if (file_in >= 0) close(file_in);
+            *status = 1;
+            return -1;
+        }
+        out_fd = file_out;
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    if (in_fd >= 0 && in_fd != STDIN_FILENO) {
+        posix_spawn_file_actions_adddup2(&actions, in_fd, STDIN_FILENO);
+    }
+    if (out_fd >= 0 && out_fd != STDOUT_FILENO) {
+        posix_spawn_file_actions_adddup2(&actions, out_fd, STDOUT_FILENO);
+    }
+
+    /* Job control signals back to default, empty mask, own process group */
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    short flags = POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK;
+    sigset_t sigs;
+    jobs_child_signals(&sigs);
+    posix_spawnattr_setsigdefault(&attr, &sigs);
+    sigemptyset(&sigs);
+    posix_spawnattr_setsigmask(&attr, &sigs);
+    if (pgid >= 0) {
+        flags |= POSIX_SPAWN_SETPGROUP;
+        posix_spawnattr_setpgroup(&attr, pgid);
+    }
+    posix_spawnattr_setflags(&attr, flags);
+
+    int own = cmd && argv == cmd->args;
+    int err = posix_spawn(&pid, path, &actions, &attr, argv, environ);
+    if (err == ENOENT && own && path != cmd->name) {
+        /* Cached location went away; search PATH once more */
+        path_cache_forget(cmd->name);
+        path = path_cache_lookup(cmd->name);
+        if (path) {
+            err = posix_spawn(&pid, path, &actions, &attr, argv, environ);
+        }
+    }
+    if (err == ENOEXEC && own) {
+        /* execvp falls back to /bin/sh for scripts without #!, spawn does not */
+        err = spawn_script(&pid, path, argv, &actions, &attr);
+    }
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+
+    if (file_in >= 0) close(file_in);
+    if (file_out >= 0) close(file_out);
+
+    if (err != 0) {
+        if (err == ENOENT && own) {
+            fprintf(stderr, "ghost-shell: %s: command not found\n", cmd->name);
+            *status = 127;
+        } else {
+            fprintf(stderr, "ghost-shell: %s: %s\n", own ? cmd->name : argv[0], strerror(err));
+            *status = 126;
+        }
+        return -1;
+    }
+    return pid;
+}
+
+pid_t launch_command(ghost_command *cmd, int in_fd, int out_fd, pid_t pgid, int *status) {
+    /* Unknown commands fail here, before any process is created */
+    const char *path = path_cache_lookup(cmd->name);
+    if (!path) {
+        fprintf(stderr, "ghost-shell: %s: command not found\n", cmd->name);
+        correction_report(cmd->name);
+        *status = 127;
+        return -1;
+    }
+
+    /* Every run of the command reads its here-document from the start */
+    if (cmd->here_doc_fd >= 0) {
+        lseek(cmd->here_doc_fd, 0, SEEK_SET);
+    }
+
+    /* An argument list execve would reject with E2BIG */
+    size_t limit = launcher_arg_limit();
+    if (argv_bytes(cmd->args, cmd->arg_count) > limit) {
+        const char *autobatch = getenv("GHSH_AUTOBATCH");
+        if (cmd->glob_end > cmd->glob_start && autobatch && strcmp(autobatch, "1") == 0) {
+            char **plan = plan_batches(cmd, limit);
+            if (!plan) {
+                perror("ghost-shell: malloc failed");
+                *status = 1;
+                return -1;
+            }
+            pid_t pid = fork_stage(cmd, path, in_fd, out_fd, pgid, status, plan);
+            free(plan);
+            return pid;
+        }
+        fprintf(stderr, "ghost-shell: %s: argument list too long (%zu arguments, %zu bytes, limit %zu)\n",
+                cmd->name, cmd->arg_count, argv_bytes(cmd->args, cmd->arg_count), limit);
+        if (cmd->glob_end > cmd->glob_start) {
+            fprintf(stderr, "ghost-shell: set GHSH_AUTOBATCH=1 to run it in batches\n");
+        }
+        *status = 126;
+        return -1;
+    }
+
+    if (launcher_backend() == LAUNCH_FORK) {
+        return fork_stage(cmd, path, in_fd, out_fd, pgid, status, NULL);
+    }
+    return spawn_stage(cmd, path, cmd->args, in_fd, out_fd, pgid, status);
+}
+
+/* Helper function to find this shell's own executable */
+static const char *self_path(void) {
+#ifdef __APPLE__
+    static char path[PATH_MAX];
+    if (!path[0]) {
+        uint32_t size = sizeof(path);
+        if (_NSGetExecutablePath(path, &size) != 0) path[0] = '\0';
+    }
+    return path[0] ? path : NULL;
+#else
+    return "/proc/self/exe";
+#endif
+}
+
+pid_t launch_shell(ghost_command *cmd, const char *line, int in_fd, int out_fd, pid_t pgid, int *status) {
+    const char *path = self_path();
+    if (!path) {
+        fprintf(stderr, "ghost-shell: cannot find the shell's own executable\n");
+        *status = 126;
+        return -1;
+    }
+    if (cmd && cmd->here_doc_fd >= 0) {
+        lseek(cmd->here_doc_fd, 0, SEEK_SET);
+    }
+    char *argv[] = {"ghost-shell", "-c", (char *)line, NULL};
+    return spawn_stage(cmd, path, argv, in_fd, out_fd, pgid, status);
+}
+
+char *launcher_quote_words(char *const *words, size_t count) {
+    size_t size = 1;
+    for (size_t i = 0; i < count; i++) {
+        size += 3;  /* Quotes and a space */
+        for (const char *c = words[i]; *c; c++) size += *c == '\'' ? 4 : 1;
+    }
+    char *line = malloc(size);
+    if (!line) return NULL;
+
+    size_t pos = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (i > 0) line[pos++] = ' ';
+        line[pos++] = '\'';
+        for (const char *c = words[i]; *c; c++) {
+            if (*c == '\'') {
+                memcpy(line + pos, "'\\''", 4);
+                pos += 4;
+            } else {
+                line[pos++] = *c;
+            }
+        }
+        line[pos++] = '\'';
+    }
+    line[pos] = '\0';
+    return line;
+}
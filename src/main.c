@@ -4,8 +4,9 @@
 #include "logger.h"
 #include <limits.h>
 
-/* Check if we're a login shell based on various criteria */
-static int is_login_shell(const char *argv0, int argc, char *argv[]) {
+/* Check if we're a login shell based on various criteria. Only an
+ * interactive shell treats being a session leader as a login. */
+static int is_login_shell(const char *argv0, int argc, char *argv[], int interactive) {
     /* Check if first char of argv[0] is '-' */
     if (argv0[0] == '-') return 1;
     
@@ -16,6 +17,8 @@ static int is_login_shell(const char *argv0, int argc, char *argv[]) {
         }
     }
     
+    if (!interactive) return 0;
+    
     /* Check if we're the session leader (initial login shell) */
     pid_t pid = getpid();
     pid_t sid = getsid(0);
@@ -24,7 +27,70 @@ static int is_login_shell(const char *argv0, int argc, char *argv[]) {
     return 0;
 }
 
+/* Run a -c string, a script file or non-terminal stdin without the line
+ * editor, history, completion index, banner or logger */
+static int run_noninteractive(const char *command_string, const char *script,
+                              int argc, char *argv[]) {
+    shell_context ctx;
+    int status;
+    
+    shell_init_noninteractive(&ctx);
+    
+    if (is_login_shell(argv[0], argc, argv, 0)) {
+        ghost_command *profile_cmd = parse_command(". ~/.ghsh_profile");
+        if (profile_cmd) {
+            execute_command(profile_cmd, &ctx);
+            free_command(profile_cmd);
+        }
+    }
+    
+    if (ctx.exit_flag) {
+        status = ctx.last_status;
+    } else if (command_string) {
+        status = shell_run_script(NULL, command_string, "-c", 0, &ctx);
+    } else if (script) {
+        FILE *file = fopen(script, "r");
+        if (!file) {
+            fprintf(stderr, "ghost-shell: %s: %s\n", script, strerror(errno));
+            shell_cleanup(&ctx);
+            return 127;
+        }
+        status = shell_run_script(file, NULL, script, 0, &ctx);
+        fclose(file);
+    } else {
+        status = shell_run_script(stdin, NULL, "stdin", 0, &ctx);
+    }
+    
+    shell_cleanup(&ctx);
+    return status;
+}
+
 int main(int argc, char *argv[]) {
+    /* ghost-shell [-l] -c 'command' | ghost-shell [-l] script [args...] */
+    const char *command_string = NULL;
+    const char *script = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-c") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "ghost-shell: -c: option requires an argument\n");
+                return 2;
+            }
+            command_string = argv[i + 1];
+            break;
+        } else if (strcmp(argv[i], "-l") == 0 || strcmp(argv[i], "--login") == 0) {
+            continue;
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "ghost-shell: %s: invalid option\n", argv[i]);
+            return 2;
+        }
+        script = argv[i];
+        break;
+    }
+    
+    if (command_string || script || !isatty(STDIN_FILENO)) {
+        return run_noninteractive(command_string, script, argc, argv);
+    }
+    
     // Initialize logger first
     if (logger_init() != 0) {
         fprintf(stderr, "Failed to initialize logger\n");
@@ -34,7 +100,7 @@ int main(int argc, char *argv[]) {
     shell_context ctx;
     
     /* Determine shell type */
-    int is_login = is_login_shell(argv[0], argc, argv);
+    int is_login = is_login_shell(argv[0], argc, argv, 1);
     
     /* Initialize the shell */
     shell_init(&ctx);
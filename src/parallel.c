@@ -0,0 +1,403 @@
+#include "parallel.h"
+#include "jobs.h"
+#include "launcher.h"
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <time.h>
+
+/* One run of the template */
+typedef struct parallel_task {
+    job *j;          /* Running job, NULL once finished (or never started) */
+    int out_fd;      /* Captured stdout and stderr, -1 if none */
+    int status;      /* Exit status once finished */
+    int finished;    /* Done and waiting for its turn to be printed */
+} parallel_task;
+
+/* Source of items: the words after ::: or the lines of stdin */
+typedef struct item_source {
+    char **args;         /* Items from the command line */
+    size_t num_args;
+    size_t next_arg;
+    int from_stdin;      /* Read items line by line from fd 0 */
+    char *buf;           /* Unconsumed stdin data */
+    size_t len;
+    size_t cap;
+    int eof;
+} item_source;
+
+static volatile sig_atomic_t parallel_interrupted = 0;
+
+static void sigint_parallel_handler(int sig) {
+    (void)sig;
+    parallel_interrupted = 1;
+}
+
+/* Helper function to fetch the next item. Returns a malloc'd string or NULL
+ * once the items are exhausted. */
+static char *next_item(item_source *src) {
+    if (!src->from_stdin) {
+        if (src->next_arg >= src->num_args) return NULL;
+        return strdup(src->args[src->next_arg++]);
+    }
+
+    for (;;) {
+        char *newline = src->len ? memchr(src->buf, '\n', src->len) : NULL;
+        if (newline || (src->eof && src->len > 0)) {
+            size_t item_len = newline ? (size_t)(newline - src->buf) : src->len;
+            size_t consumed = newline ? item_len + 1 : item_len;
+            char *item = malloc(item_len + 1);
+            if (!item) return NULL;
+            memcpy(item, src->buf, item_len);
+            item[item_len] = '\0';
+            if (item_len > 0 && item[item_len - 1] == '\r') item[item_len - 1] = '\0';
+            memmove(src->buf, src->buf + consumed, src->len - consumed);
+            src->len -= consumed;
+            if (item[0] == '\0') {  /* Skip blank lines */
+                free(item);
+                continue;
+            }
+            return item;
+        }
+        if (src->eof) return NULL;
+
+        if (src->cap - src->len < 4096) {
+            size_t new_cap = src->cap ? src->cap * 2 : 8192;
+            char *new_buf = realloc(src->buf, new_cap);
+            if (!new_buf) return NULL;
+            src->buf = new_buf;
+            src->cap = new_cap;
+        }
+        ssize_t n = read(STDIN_FILENO, src->buf + src->len, src->cap - src->len);
+        if (n < 0 && errno == EINTR) {
+            if (parallel_interrupted) return NULL;
+            continue;
+        }
+        if (n <= 0) {
+            src->eof = 1;
+        } else {
+            src->len += (size_t)n;
+        }
+    }
+}
+
+/* Helper function to append len bytes of text to line, single-quoted so
+ * the parser takes them literally. Returns -1 if they do not fit. */
+static int append_quoted(char *line, size_t *pos, const char *text, size_t len) {
+    if (*pos + 2 >= GHOST_MAX_INPUT_SIZE) return -1;
+    line[(*pos)++] = '\'';
+    for (size_t i = 0; i < len; i++) {
+        if (text[i] == '\'') {
+            if (*pos + 4 >= GHOST_MAX_INPUT_SIZE) return -1;
+            memcpy(line + *pos, "'\\''", 4);
+            *pos += 4;
+        } else {
+            if (*pos + 1 >= GHOST_MAX_INPUT_SIZE) return -1;
+            line[(*pos)++] = text[i];
+        }
+    }
+    if (*pos + 1 >= GHOST_MAX_INPUT_SIZE) return -1;
+    line[(*pos)++] = '\'';
+    return 0;
+}
+
+/* Helper function to build the command line for one item: every {} in the
+ * template becomes the item, or the item is appended as a word when the
+ * template has no {}. The template words were already parsed (quotes
+ * removed, variables expanded), so each is quoted as a whole to reach the
+ * command as the same single word. */
+static char *build_line(char **words, size_t num_words, const char *item) {
+    char *line = malloc(GHOST_MAX_INPUT_SIZE);
+    if (!line) return NULL;
+    size_t pos = 0;
+    size_t item_len = strlen(item);
+    int substituted = 0;
+    int overflow = 0;
+
+    for (size_t i = 0; i < num_words && !overflow; i++) {
+        const char *w = words[i];
+        if (i > 0) {
+            if (pos + 1 >= GHOST_MAX_INPUT_SIZE) overflow = 1;
+            else line[pos++] = ' ';
+        }
+
+        /* Literal runs and items, quoted piece by piece ('a''item''b') */
+        const char *run = w;
+        for (;;) {
+            const char *brace = strstr(run, "{}");
+            size_t run_len = brace ? (size_t)(brace - run) : strlen(run);
+            if ((run_len > 0 || (!brace && run == w)) && append_quoted(line, &pos, run, run_len) != 0) {
+                overflow = 1;
+                break;
+            }
+            if (!brace) break;
+            if (append_quoted(line, &pos, item, item_len) != 0) {
+                overflow = 1;
+                break;
+            }
+            substituted = 1;
+            run = brace + 2;
+        }
+    }
+    if (!substituted && !overflow) {
+        if (pos + 1 >= GHOST_MAX_INPUT_SIZE) {
+            overflow = 1;
+        } else {
+            line[pos++] = ' ';
+            if (append_quoted(line, &pos, item, item_len) != 0) overflow = 1;
+        }
+    }
+
+    if (overflow) {
+        free(line);
+        return NULL;
+    }
+    line[pos] = '\0';
+    return line;
+}
+
+/* Helper function to start one task with its output captured. Sets
+ * task->j, or marks the task finished if nothing could be started. */
+static void start_task(parallel_task *task, char *line, int null_fd, int saved_stderr) {
+    task->j = NULL;
+    task->out_fd = anon_file_create("ghost-parallel");
+    task->status = 0;
+    task->finished = 0;
+
+    /* The shell's own errors (e.g. command not found) belong to the task too */
+    if (task->out_fd >= 0) dup2(task->out_fd, STDERR_FILENO);
+
+    ghost_command *cmd = parse_command(line);
+    if (!cmd) {
+        task->status = 2;
+    } else if (task->out_fd < 0) {
+        perror("ghost-shell: parallel: cannot capture output");
+        task->status = 1;
+    } else {
+        task->j = launch_pipeline(cmd, line, null_fd, task->out_fd, &task->status);
+    }
+    free_command(cmd);
+
+    dup2(saved_stderr, STDERR_FILENO);
+    if (!task->j) task->finished = 1;
+}
+
+/* Helper function to copy a finished task's output to stdout */
+static void print_task(parallel_task *task) {
+    if (task->out_fd < 0) return;
+
+    char buf[8192];
+    ssize_t n;
+    lseek(task->out_fd, 0, SEEK_SET);
+    while ((n = read(task->out_fd, buf, sizeof(buf))) > 0) {
+        if (anon_file_write(STDOUT_FILENO, buf, (size_t)n) != 0) break;
+    }
+    close(task->out_fd);
+    task->out_fd = -1;
+}
+
+/* Helper function to record a finished job's status and drop it from the
+ * running set */
+static void collect_task(job *done, job **running, size_t *running_task,
+                         size_t *num_running, parallel_task *tasks) {
+    for (size_t i = 0; i < *num_running; i++) {
+        if (running[i] != done) continue;
+        parallel_task *task = &tasks[running_task[i]];
+        task->status = job_exit_status(done);
+        task->finished = 1;
+        task->j = NULL;
+        job_discard(done);
+        running[i] = running[*num_running - 1];
+        running_task[i] = running_task[*num_running - 1];
+        (*num_running)--;
+        return;
+    }
+}
+
+int builtin_parallel(ghost_command *cmd, shell_context *ctx) {
+    (void)ctx;  /* Unused parameter */
+    long max_jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    int silent = 0;
+    size_t first = 1;
+
+    /* Options */
+    while (first < cmd->arg_count && cmd->args[first][0] == '-') {
+        const char *opt = cmd->args[first];
+        if (strcmp(opt, "-s") == 0) {
+            silent = 1;
+        } else if (strncmp(opt, "-j", 2) == 0) {
+            const char *value = opt[2] ? opt + 2 : (first + 1 < cmd->arg_count ? cmd->args[++first] : NULL);
+            char *end = NULL;
+            errno = 0;
+            max_jobs = value ? strtol(value, &end, 10) : 0;
+            if (!value || end == value || *end != '\0' || max_jobs <= 0 ||
+                (errno == ERANGE && max_jobs != LONG_MAX)) {
+                print_error("parallel: -j needs a positive number");
+                return 2;
+            }
+        } else if (strcmp(opt, "--") == 0) {
+            first++;
+            break;
+        } else {
+            char error_msg[256];
+            snprintf(error_msg, sizeof(error_msg), "parallel: %s: invalid option", opt);
+            print_error(error_msg);
+            return 2;
+        }
+        first++;
+    }
+    if (max_jobs <= 0) max_jobs = 1;
+    if (max_jobs > GHOST_PARALLEL_MAX_JOBS) max_jobs = GHOST_PARALLEL_MAX_JOBS;
+
+    /* Template words end at ::: */
+    size_t template_end = first;
+    while (template_end < cmd->arg_count && strcmp(cmd->args[template_end], GHOST_PARALLEL_ITEMS) != 0) {
+        template_end++;
+    }
+    if (template_end == first) {
+        print_error("parallel: usage: parallel [-j N] [-s] command [args...] [::: item...]");
+        return 2;
+    }
+
+    item_source src;
+    memset(&src, 0, sizeof(src));
+    if (template_end < cmd->arg_count) {
+        src.args = cmd->args + template_end + 1;
+        src.num_args = cmd->arg_count - template_end - 1;
+        /* No more slots than items */
+        if ((size_t)max_jobs > src.num_args) max_jobs = src.num_args ? (long)src.num_args : 1;
+    } else {
+        src.from_stdin = 1;
+    }
+
+    int null_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    int saved_stderr = fcntl(STDERR_FILENO, F_DUPFD_CLOEXEC, 0);
+    job **running = calloc((size_t)max_jobs, sizeof(job *));
+    size_t *running_task = calloc((size_t)max_jobs, sizeof(size_t));
+    if (null_fd < 0 || saved_stderr < 0 || !running || !running_task) {
+        perror("ghost-shell: parallel");
+        if (null_fd >= 0) close(null_fd);
+        if (saved_stderr >= 0) close(saved_stderr);
+        free(running);
+        free(running_task);
+        return 1;
+    }
+
+    /* Let SIGINT stop the run instead of being ignored */
+    struct sigaction sa, old_sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sigint_parallel_handler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, &old_sa);
+    parallel_interrupted = 0;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    fflush(stdout);
+
+    parallel_task *tasks = NULL;
+    size_t num_tasks = 0, tasks_cap = 0;
+    size_t next_print = 0;
+    size_t num_running = 0;
+    size_t failed = 0;
+    int items_left = 1;
+
+    for (;;) {
+        /* Fill free slots */
+        while (items_left && !parallel_interrupted && num_running < (size_t)max_jobs) {
+            char *item = next_item(&src);
+            if (!item) {
+                items_left = 0;
+                break;
+            }
+            if (num_tasks == tasks_cap) {
+                size_t new_cap = tasks_cap ? tasks_cap * 2 : 64;
+                parallel_task *new_tasks = realloc(tasks, new_cap * sizeof(parallel_task));
+                if (!new_tasks) {
+                    free(item);
+                    items_left = 0;
+                    break;
+                }
+                tasks = new_tasks;
+                tasks_cap = new_cap;
+            }
+
+            parallel_task *task = &tasks[num_tasks];
+            char *line = build_line(cmd->args + first, template_end - first, item);
+            if (!line) {
+                char error_msg[256];
+                snprintf(error_msg, sizeof(error_msg), "parallel: command line too long for item '%.64s'", item);
+                print_error(error_msg);
+                task->j = NULL;
+                task->out_fd = -1;
+                task->status = 1;
+                task->finished = 1;
+            } else {
+                start_task(task, line, null_fd, saved_stderr);
+                free(line);
+            }
+            free(item);
+
+            if (task->j) {
+                running[num_running] = task->j;
+                running_task[num_running] = num_tasks;
+                num_running++;
+            }
+            num_tasks++;
+        }
+
+        if (num_running == 0) {
+            if (!items_left || parallel_interrupted) break;
+            continue;
+        }
+
+        job *done = jobs_wait_any(running, num_running, &parallel_interrupted);
+        if (done) {
+            collect_task(done, running, running_task, &num_running, tasks);
+        } else {
+            /* Interrupted: pass it on and collect what is still running */
+            for (size_t i = 0; i < num_running; i++) {
+                job_signal(running[i], SIGINT);
+            }
+            while (num_running > 0) {
+                done = jobs_wait_any(running, num_running, NULL);
+                collect_task(done, running, running_task, &num_running, tasks);
+            }
+        }
+
+        /* Output appears in item order */
+        while (next_print < num_tasks && tasks[next_print].finished) {
+            if (tasks[next_print].status != 0) failed++;
+            print_task(&tasks[next_print]);
+            next_print++;
+        }
+    }
+
+    while (next_print < num_tasks) {
+        if (tasks[next_print].status != 0) failed++;
+        print_task(&tasks[next_print]);
+        next_print++;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    sigaction(SIGINT, &old_sa, NULL);
+
+    if (!silent) {
+        double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        fprintf(stderr, "parallel: %zu job%s, %zu failed, %.3fs (%.1f jobs/s, -j %ld)\n",
+                num_tasks, num_tasks == 1 ? "" : "s", failed, elapsed,
+                elapsed > 0 ? num_tasks / elapsed : 0.0, max_jobs);
+    }
+
+    int interrupted = parallel_interrupted;
+    free(tasks);
+    free(src.buf);
+    free(running);
+    free(running_task);
+    close(null_fd);
+    close(saved_stderr);
+
+    if (interrupted) return 130;
+    return failed > GHOST_PARALLEL_MAX_FAILED ? GHOST_PARALLEL_MAX_FAILED : (int)failed;
+}
@@ -0,0 +1,204 @@
+#include "path_cache.h"
+#include <sys/stat.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Cached location of a single command name */
+typedef struct path_entry {
+    char *name;               /* Command name as typed */
+    char *path;               /* Absolute path, or NULL if not found */
+    unsigned long hits;       /* Number of lookups served */
+    time_t checked;           /* When a negative entry was recorded */
+    struct path_entry *next;  /* Next entry in the bucket chain */
+} path_entry;
+
+/* Cache state */
+static path_entry **buckets = NULL;
+static size_t num_buckets = 0;
+static size_t num_entries = 0;
+
+/* FNV-1a string hash */
+static size_t hash_name(const char *name) {
+    size_t h = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)name; *p; p++) {
+        h ^= *p;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* Helper function to double the bucket array once the load factor hits 3/4 */
+static int grow_buckets(void) {
+    size_t new_size = num_buckets ? num_buckets * 2 : 64;
+    path_entry **new_buckets = calloc(new_size, sizeof(path_entry *));
+    if (!new_buckets) return -1;
+
+    for (size_t i = 0; i < num_buckets; i++) {
+        path_entry *e = buckets[i];
+        while (e) {
+            path_entry *next = e->next;
+            size_t slot = hash_name(e->name) & (new_size - 1);
+            e->next = new_buckets[slot];
+            new_buckets[slot] = e;
+            e = next;
+        }
+    }
+
+    free(buckets);
+    buckets = new_buckets;
+    num_buckets = new_size;
+    return 0;
+}
+
+static path_entry *find_entry(const char *name) {
+    if (!buckets) return NULL;
+    path_entry *e = buckets[hash_name(name) & (num_buckets - 1)];
+    while (e && strcmp(e->name, name) != 0) {
+        e = e->next;
+    }
+    return e;
+}
+
+/* Helper function to walk PATH the way execvp would */
+static char *search_path(const char *name) {
+    const char *path = getenv("PATH");
+    if (!path) path = "/usr/bin:/bin";
+
+    char full_path[PATH_MAX];
+    const char *dir = path;
+    while (1) {
+        const char *end = strchr(dir, ':');
+        size_t dir_len = end ? (size_t)(end - dir) : strlen(dir);
+
+        /* An empty PATH element means the current directory */
+        int n;
+        if (dir_len == 0) {
+            n = snprintf(full_path, sizeof(full_path), "./%s", name);
+        } else {
+            n = snprintf(full_path, sizeof(full_path), "%.*s/%s", (int)dir_len, dir, name);
+        }
+
+        struct stat st;
+        if (n > 0 && (size_t)n < sizeof(full_path) &&
+            stat(full_path, &st) == 0 && S_ISREG(st.st_mode) &&
+            access(full_path, X_OK) == 0) {
+            return strdup(full_path);
+        }
+
+        if (!end) break;
+        dir = end + 1;
+    }
+    return NULL;
+}
+
+/* Helper function to store a lookup result, replacing any previous entry */
+static path_entry *store_entry(const char *name, char *path) {
+    path_entry *e = find_entry(name);
+    if (e) {
+        free(e->path);
+    } else {
+        if (num_entries + 1 > num_buckets / 4 * 3 && grow_buckets() != 0) {
+            free(path);
+            return NULL;
+        }
+        e = calloc(1, sizeof(path_entry));
+        if (!e) {
+            free(path);
+            return NULL;
+        }
+        e->name = strdup(name);
+        if (!e->name) {
+            free(e);
+            free(path);
+            return NULL;
+        }
+        size_t slot = hash_name(name) & (num_buckets - 1);
+        e->next = buckets[slot];
+        buckets[slot] = e;
+        num_entries++;
+    }
+    e->path = path;
+    e->hits = 0;
+    e->checked = time(NULL);
+    return e;
+}
+
+const char *path_cache_lookup(const char *name) {
+    if (!name || !*name) return NULL;
+    if (strchr(name, '/')) return name;
+
+    path_entry *e = find_entry(name);
+    if (e && !e->path && time(NULL) - e->checked >= GHOST_PATH_NEGATIVE_TTL) {
+        e = NULL;  /* Negative entry expired, search again */
+    }
+    if (!e) {
+        e = store_entry(name, search_path(name));
+        if (!e) return NULL;
+    }
+
+    e->hits++;
+    return e->path;
+}
+
+const char *path_cache_add(const char *name) {
+    if (!name || !*name || strchr(name, '/')) return name;
+    path_entry *e = store_entry(name, search_path(name));
+    return e ? e->path : NULL;
+}
+
+void path_cache_forget(const char *name) {
+    if (!buckets || !name) return;
+    path_entry **link = &buckets[hash_name(name) & (num_buckets - 1)];
+    while (*link) {
+        path_entry *e = *link;
+        if (strcmp(e->name, name) == 0) {
+            *link = e->next;
+            free(e->name);
+            free(e->path);
+            free(e);
+            num_entries--;
+            return;
+        }
+        link = &e->next;
+    }
+}
+
+void path_cache_reset(void) {
+    for (size_t i = 0; i < num_buckets; i++) {
+        path_entry *e = buckets[i];
+        while (e) {
+            path_entry *next = e->next;
+            free(e->name);
+            free(e->path);
+            free(e);
+            e = next;
+        }
+        buckets[i] = NULL;
+    }
+    num_entries = 0;
+}
+
+void path_cache_print(void) {
+    int printed = 0;
+    for (size_t i = 0; i < num_buckets; i++) {
+        for (path_entry *e = buckets[i]; e; e = e->next) {
+            if (!e->path) continue;  /* Negative entries are an internal detail */
+            if (!printed++) printf("hits\tcommand\n");
+            printf("%4lu\t%s\n", e->hits, e->path);
+        }
+    }
+    if (!printed) {
+        printf("hash: hash table empty\n");
+    }
+}
+
+void path_cache_cleanup(void) {
+    path_cache_reset();
+    free(buckets);
+    buckets = NULL;
+    num_buckets = 0;
+}
@@ -3,6 +3,9 @@
 #include <unistd.h>
 #include <libgen.h>
 
+/* The rendered prompt is up to date */
+static int prompt_current = 0;
+
 /* Helper function to format shell prompts */
 void format_shell_prompt(char *buffer, size_t size, const char *username, const char *path) {
     if (!buffer || !username || !path) return;
@@ -14,13 +17,19 @@ char *get_formatted_path(void) {
     char *cwd = getcwd(NULL, 0);
     if (!cwd) return strdup("???");
 
+    char *result = format_prompt_path(cwd);
+    free(cwd);
+    return result;
+}
+
+/* Helper function to shorten a directory for the prompt */
+char *format_prompt_path(const char *cwd) {
     const char *home = getenv("HOME");
     char *result = NULL;
     
     /* Case 1: home directory itself */
     if (home && strcmp(cwd, home) == 0) {
         result = strdup("~");
-        free(cwd);
         return result;
     }
     
@@ -28,7 +37,6 @@ char *get_formatted_path(void) {
     char *dir_copy = strdup(cwd);
     char *base_copy = strdup(cwd);
     if (!dir_copy || !base_copy) {
-        free(cwd);
         free(dir_copy);
         free(base_copy);
         return strdup("???");
@@ -48,6 +56,17 @@ char *get_formatted_path(void) {
     
     free(dir_copy);
     free(base_copy);
-    free(cwd);
     return result ? result : strdup("???");
-} 
+}
+
+void prompt_invalidate(void) {
+    prompt_current = 0;
+}
+
+int prompt_is_current(void) {
+    return prompt_current;
+}
+
+void prompt_mark_current(void) {
+    prompt_current = 1;
+}
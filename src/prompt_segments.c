@@ -0,0 +1,428 @@
+#include "prompt_segments.h"
+#include "prompt.h"
+#include "autosuggest.h"
+#include "fs_worker.h"
+#include "jobs.h"
+#include "path_cache.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+extern char **environ;
+
+/* Segments worked out on a worker, in the order they are shown */
+typedef enum { SEGMENT_GIT, SEGMENT_KUBE, NUM_SEGMENTS } segment_kind;
+
+/* One run of a segment: what it works from and what it came to */
+typedef struct segment_task {
+    segment_kind kind;
+    char *cwd;       /* Directory it is for */
+    char *source;    /* Kubernetes config file, or the git executable */
+    char **env;      /* Environment for git, taken on the main thread */
+    char text[GHOST_PROMPT_SEGMENT_MAX];
+} segment_task;
+
+typedef struct segment {
+    char text[GHOST_PROMPT_SEGMENT_MAX];  /* As shown */
+    fs_task *task;                        /* Run still going, if any */
+    segment_task *arg;
+    struct timespec deadline;
+    int expired;                          /* Past the deadline; no longer waited for */
+} segment;
+
+static int enabled = 0;
+static int wake_fds[2] = {-1, -1};  /* Written to as a run finishes */
+static segment segments[NUM_SEGMENTS];
+static char duration[32];
+static char *segments_cwd = NULL;
+
+/* Helper function to free an environment copied by copy_environment */
+static void free_environment(char **env) {
+    if (!env) return;
+    for (size_t i = 0; env[i]; i++) free(env[i]);
+    free(env);
+}
+
+static void free_segment_task(void *arg) {
+    segment_task *t = arg;
+    free(t->cwd);
+    free(t->source);
+    free_environment(t->env);
+    free(t);
+}
+
+/* Helper function to get the monotonic time ms milliseconds from now */
+static void time_after(struct timespec *when, long ms) {
+    clock_gettime(CLOCK_MONOTONIC, when);
+    when->tv_sec += ms / 1000;
+    when->tv_nsec += (ms % 1000) * 1000000L;
+    if (when->tv_nsec >= 1000000000L) {
+        when->tv_sec++;
+        when->tv_nsec -= 1000000000L;
+    }
+}
+
+/* Helper function to get the milliseconds from now until when */
+static long ms_until(const struct timespec *when) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (when->tv_sec - now.tv_sec) * 1000 + (when->tv_nsec - now.tv_nsec) / 1000000;
+}
+
+/* Helper function to read the branch and whether anything changed from
+ * git status --porcelain=v2 --branch output */
+static void parse_git_status(const char *out, char *text, size_t size) {
+    char head[GHOST_PROMPT_SEGMENT_MAX] = "";
+    int dirty = 0;
+
+    for (const char *line = out; *line; ) {
+        const char *end = strchr(line, '\n');
+        size_t len = end ? (size_t)(end - line) : strlen(line);
+        if (len > 14 && strncmp(line, "# branch.head ", 14) == 0 &&
+            strncmp(line + 14, "(detached)", len - 14) != 0) {
+            snprintf(head, sizeof(head), "%.*s", (int)(len - 14), line + 14);
+        } else if (len > 13 && strncmp(line, "# branch.oid ", 13) == 0 && !head[0]) {
+            /* Detached: the commit, shortened */
+            snprintf(head, sizeof(head), "%.*s", len - 13 < 7 ? (int)(len - 13) : 7, line + 13);
+        } else if (len > 0 && line[0] != '#') {
+            dirty = 1;
+        }
+        if (!end) break;
+        line = end + 1;
+    }
+
+    if (head[0]) snprintf(text, size, "(%s%s)", head, dirty ? "*" : "");
+}
+
+/* Helper function to run git status in the segment's directory and read
+ * its output within the timeout. git runs in its own process group, away
+ * from terminal signals and stopped as a whole if it takes too long, and
+ * is not waited for: the shell's SIGCHLD reaper collects it. */
+static void git_segment(segment_task *t) {
+    int fds[2];
+    if (pipe(fds) != 0) return;
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+    /* Workers block every signal; git gets an empty mask and the defaults */
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t sigs;
+    jobs_child_signals(&sigs);
+    posix_spawnattr_setsigdefault(&attr, &sigs);
+    sigemptyset(&sigs);
+    posix_spawnattr_setsigmask(&attr, &sigs);
+    posix_spawnattr_setpgroup(&attr, 0);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETPGROUP);
+
+    /* Not posix_spawnp: searching PATH here would race with export */
+    char *argv[] = {"git", "-C", t->cwd, "--no-optional-locks", "status", "--porcelain=v2",
+                    "--branch", "--untracked-files=no", NULL};
+    pid_t pid;
+    int err = posix_spawn(&pid, t->source, &actions, &attr, argv, t->env);
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    close(fds[1]);
+    if (err != 0) {
+        close(fds[0]);
+        return;
+    }
+
+    /* The header and the first changed file are all that is needed */
+    char out[4096];
+    size_t len = 0;
+    struct timespec deadline;
+    time_after(&deadline, GHOST_PROMPT_SEGMENT_TIMEOUT_MS);
+    int finished = 0;
+    while (len < sizeof(out) - 1) {
+        long left = ms_until(&deadline);
+        if (left <= 0) break;
+        struct pollfd pfd = {fds[0], POLLIN, 0};
+        int r = poll(&pfd, 1, (int)left);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        ssize_t n = read(fds[0], out + len, sizeof(out) - 1 - len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            finished = n == 0;
+            break;
+        }
+        len += (size_t)n;
+    }
+    close(fds[0]);
+    out[len] = '\0';
+
+    if (finished || len == sizeof(out) - 1) {
+        parse_git_status(out, t->text, sizeof(t->text));
+    }
+    if (!finished) kill(-pid, SIGKILL);
+}
+
+/* Helper function to find current-context in a kubeconfig file */
+static void kube_segment(segment_task *t) {
+    FILE *file = fopen(t->source, "r");
+    if (!file) return;
+
+    char line[512];
+    while (fgets(line, sizeof(line), file)) {
+        if (strncmp(line, "current-context:", 16) != 0) continue;
+        char *value = line + 16;
+        while (*value == ' ' || *value == '\t') value++;
+        size_t len = strcspn(value, "\r\n");
+        while (len > 0 && (value[len - 1] == ' ' || value[len - 1] == '\t')) len--;
+        if (len >= 2 && (value[0] == '"' || value[0] == '\'') && value[len - 1] == value[0]) {
+            value++;
+            len -= 2;
+        }
+        if (len > 0) snprintf(t->text, sizeof(t->text), "[%.*s]", (int)len, value);
+        break;
+    }
+    fclose(file);
+}
+
+static void run_segment(void *arg) {
+    segment_task *t = arg;
+    if (t->kind == SEGMENT_GIT) {
+        git_segment(t);
+    } else {
+        kube_segment(t);
+    }
+
+    /* Wake the reader; if the pipe is full it is awake already */
+    ssize_t n = write(wake_fds[1], "", 1);
+    (void)n;
+}
+
+/* Helper function to take in the result of a run that has finished. A
+ * result for a directory the shell has since left is dropped. Returns 1 if
+ * the segment changed. */
+static int collect(segment *s, long wait_ms) {
+    if (!s->task || !fs_task_wait(s->task, wait_ms)) return 0;
+
+    int changed = 0;
+    if (segments_cwd && strcmp(s->arg->cwd, segments_cwd) == 0 && strcmp(s->text, s->arg->text) != 0) {
+        memcpy(s->text, s->arg->text, sizeof(s->text));
+        changed = 1;
+    }
+    fs_task_release(s->task);
+    s->task = NULL;
+    s->arg = NULL;
+    return changed;
+}
+
+/* Helper function to get the Kubernetes config file: the first one in
+ * KUBECONFIG, or ~/.kube/config */
+static char *kube_config_path(void) {
+    const char *list = getenv("KUBECONFIG");
+    if (list && *list) {
+        size_t len = strcspn(list, ":");
+        char *path = malloc(len + 1);
+        if (path) {
+            memcpy(path, list, len);
+            path[len] = '\0';
+        }
+        return path;
+    }
+    const char *home = getenv("HOME");
+    if (!home) return NULL;
+    char *path = malloc(strlen(home) + sizeof("/.kube/config"));
+    if (path) sprintf(path, "%s/.kube/config", home);
+    return path;
+}
+
+/* Helper function to copy the environment for a run. Each string is
+ * duplicated: setenv may free or reuse its own strings (BSD libc does), and
+ * the shell calls it after every pipeline while the worker still runs. */
+static char **copy_environment(void) {
+    size_t n = 0;
+    while (environ && environ[n]) n++;
+    char **env = calloc(n + 1, sizeof(char *));
+    if (!env) return NULL;
+    for (size_t i = 0; i < n; i++) {
+        env[i] = strdup(environ[i]);
+        if (!env[i]) {
+            free_environment(env);
+            return NULL;
+        }
+    }
+    return env;
+}
+
+/* Helper function to format how long the last command took */
+static void format_duration(long ms, char *buf, size_t size) {
+    long s = ms / 1000;
+    if (s < 60) {
+        snprintf(buf, size, "%lds", s);
+    } else if (s < 3600) {
+        snprintf(buf, size, "%ldm%02lds", s / 60, s % 60);
+    } else {
+        snprintf(buf, size, "%ldh%02ldm", s / 3600, s / 60 % 60);
+    }
+}
+
+/* Character reader hook: wait for the next key, or for a segment that
+ * changes the prompt. Returns 1 when the prompt should be drawn again. */
+static int wait_for_segments(void) {
+    for (;;) {
+        int timeout = -1;
+        for (int i = 0; i < NUM_SEGMENTS; i++) {
+            segment *s = &segments[i];
+            if (!s->task || s->expired) continue;
+            long left = ms_until(&s->deadline);
+            if (left < 0) left = 0;
+            if (timeout < 0 || left < timeout) timeout = (int)left;
+        }
+        if (timeout < 0) return 0;
+
+        struct pollfd fds[2] = {{STDIN_FILENO, POLLIN, 0}, {wake_fds[0], POLLIN, 0}};
+        int r = poll(fds, 2, timeout);
+        if (r < 0 && errno != EINTR) return 0;
+        if (r > 0 && fds[0].revents) return 0;  /* A key comes first */
+
+        char drain[64];
+        while (read(wake_fds[0], drain, sizeof(drain)) > 0) {
+        }
+
+        /* A run wakes the reader just before its task counts as finished */
+        int changed = 0;
+        for (int i = 0; i < NUM_SEGMENTS; i++) {
+            segment *s = &segments[i];
+            if (!s->task || s->expired) continue;
+            changed |= collect(s, 1);
+            if (s->task && ms_until(&s->deadline) <= 0) {
+                s->expired = 1;
+                if (s->text[0]) {
+                    s->text[0] = '\0';
+                    changed = 1;
+                }
+            }
+        }
+        if (changed) {
+            prompt_invalidate();
+            return 1;
+        }
+    }
+}
+
+int prompt_segments_init(EditLine *el) {
+    const char *value = getenv("GHSH_PROMPT_SEGMENTS");
+    if (!el || !value || strcmp(value, "1") != 0) return 0;
+
+    if (pipe(wake_fds) != 0) return 0;
+    for (int i = 0; i < 2; i++) {
+        fcntl(wake_fds[i], F_SETFD, FD_CLOEXEC);
+        fcntl(wake_fds[i], F_SETFL, O_NONBLOCK);
+    }
+    autosuggest_set_input_wait(el, wait_for_segments);
+    enabled = 1;
+    return 1;
+}
+
+void prompt_segments_start(const char *cwd, long duration_ms) {
+    if (!enabled || !cwd) return;
+
+    char took[sizeof(duration)] = "";
+    if (duration_ms >= GHOST_PROMPT_DURATION_MIN_MS) format_duration(duration_ms, took, sizeof(took));
+    int changed = strcmp(took, duration) != 0;
+    memcpy(duration, took, sizeof(duration));
+
+    /* Another directory's segments would mislead; they are left out until
+     * the new ones come in */
+    if (!segments_cwd || strcmp(segments_cwd, cwd) != 0) {
+        free(segments_cwd);
+        segments_cwd = strdup(cwd);
+        for (int i = 0; i < NUM_SEGMENTS; i++) {
+            changed |= segments[i].text[0] != '\0';
+            segments[i].text[0] = '\0';
+        }
+    }
+    if (!segments_cwd) return;
+
+    struct timespec deadline;
+    time_after(&deadline, GHOST_PROMPT_SEGMENT_TIMEOUT_MS);
+
+    for (int i = 0; i < NUM_SEGMENTS; i++) {
+        segment *s = &segments[i];
+        changed |= collect(s, 1);
+
+        /* One stuck on the filesystem is not started again until it is done */
+        if (s->task) continue;
+
+        segment_task *t = calloc(1, sizeof(segment_task));
+        if (!t) continue;
+        t->kind = (segment_kind)i;
+        t->cwd = strdup(segments_cwd);
+        if (i == SEGMENT_GIT) {
+            const char *git = path_cache_lookup("git");
+            t->source = git ? strdup(git) : NULL;
+            t->env = copy_environment();
+        } else {
+            t->source = kube_config_path();
+        }
+        if (!t->cwd || !t->source || (i == SEGMENT_GIT && !t->env)) {
+            free_segment_task(t);
+            if (s->text[0]) changed = 1;
+            s->text[0] = '\0';
+            continue;
+        }
+
+        s->arg = t;
+        s->task = fs_task_start(run_segment, t, free_segment_task);
+        if (!s->task) {
+            /* No worker: do it here */
+            run_segment(t);
+            changed |= strcmp(s->text, t->text) != 0;
+            memcpy(s->text, t->text, sizeof(s->text));
+            free_segment_task(t);
+            s->arg = NULL;
+            continue;
+        }
+        s->deadline = deadline;
+        s->expired = 0;
+    }
+
+    /* Give the quick ones a moment, so the prompt is drawn with them */
+    struct timespec until;
+    time_after(&until, GHOST_PROMPT_SEGMENT_WAIT_MS);
+    for (int i = 0; i < NUM_SEGMENTS; i++) {
+        long left = ms_until(&until);
+        changed |= collect(&segments[i], left > 0 ? left : 1);
+    }
+
+    if (changed) prompt_invalidate();
+}
+
+void prompt_segments_format(char *buf, size_t size) {
+    size_t len = 0;
+    buf[0] = '\0';
+    for (int i = 0; i < NUM_SEGMENTS && len < size; i++) {
+        if (!segments[i].text[0]) continue;
+        int n = snprintf(buf + len, size - len, " %s", segments[i].text);
+        if (n > 0) len += (size_t)n;
+    }
+    if (duration[0] && len < size) snprintf(buf + len, size - len, " %s", duration);
+}
+
+void prompt_segments_cleanup(void) {
+    for (int i = 0; i < NUM_SEGMENTS; i++) {
+        if (segments[i].task) fs_task_release(segments[i].task);
+        segments[i].task = NULL;
+        segments[i].arg = NULL;
+    }
+    free(segments_cwd);
+    segments_cwd = NULL;
+    enabled = 0;
+}
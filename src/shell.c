@@ -1,30 +1,170 @@
 #include "ghost_shell.h"
 #include "completions.h"
+#include "path_cache.h"
+#include "dir_listing.h"
+#include "completion_spec.h"
+#include "git_refs.h"
+#include "frecency.h"
+#include "fs_worker.h"
+#include "jobs.h"
+#include "history_index.h"
+#include "autosuggest.h"
+#include "correction.h"
+#include "history_journal.h"
+#include "history_store.h"
+#include "history_search.h"
+#include "dir_jump.h"
+#include "prompt_segments.h"
 #include <histedit.h>
 #include <sys/stat.h>
 #include <limits.h>
 #include <libgen.h>
 #include <sys/ioctl.h>
+#include <time.h>
 
 /* Global state */
 static EditLine *el = NULL;
 History *hist = NULL;
 HistEvent ev;
+static int suggest = 0;  /* Autosuggestions are on */
 
-/* Prompt function for libedit */
+/* Working directory of the prompt. getcwd runs on a filesystem worker, so
+ * a hung mount under the current directory cannot freeze the prompt. */
+typedef struct cwd_task {
+    char *cwd;
+} cwd_task;
+
+static char *prompt_cwd = NULL;       /* Last directory resolved */
+static fs_task *pending_cwd = NULL;   /* Lookup that missed its deadline */
+static cwd_task *pending_cwd_arg = NULL;
+
+static void resolve_cwd(void *arg) {
+    ((cwd_task *)arg)->cwd = getcwd(NULL, 0);
+}
+
+static void free_cwd_task(void *arg) {
+    free(((cwd_task *)arg)->cwd);
+    free(arg);
+}
+
+/* Helper function to get the prompt's directory within the deadline.
+ * Sets *stale when the last known directory has to do. */
+static char *prompt_path(int *stale) {
+    *stale = 0;
+    for (;;) {
+        int fresh = !pending_cwd;
+        if (fresh) {
+            pending_cwd_arg = calloc(1, sizeof(cwd_task));
+            if (!pending_cwd_arg) break;
+            pending_cwd = fs_task_start(resolve_cwd, pending_cwd_arg, free_cwd_task);
+            if (!pending_cwd) {
+                resolve_cwd(pending_cwd_arg);  /* No worker: do it here */
+            }
+        }
+        /* One that already missed a deadline only gets a quick look */
+        if (pending_cwd && !fs_task_wait(pending_cwd, fresh ? fs_deadline_ms() : 1)) {
+            *stale = 1;
+            break;
+        }
+
+        if (pending_cwd_arg->cwd) {
+            free(prompt_cwd);
+            prompt_cwd = pending_cwd_arg->cwd;
+            pending_cwd_arg->cwd = NULL;
+        }
+        if (pending_cwd) {
+            fs_task_release(pending_cwd);
+        } else {
+            free_cwd_task(pending_cwd_arg);
+        }
+        pending_cwd = NULL;
+        pending_cwd_arg = NULL;
+
+        /* A lookup left over from an earlier prompt may predate a cd */
+        if (fresh) break;
+    }
+    return prompt_cwd ? format_prompt_path(prompt_cwd) : strdup("???");
+}
+
+/* Prompt function for libedit. libedit asks for the prompt on every
+ * redraw; it is rendered again only once something in it has changed, and
+ * not kept while the directory is stale so the lookup is retried. */
 static char *get_prompt(EditLine *edit_line) {
     (void)edit_line;
     static char prompt[1024];
+    if (prompt_is_current()) return prompt;
+
     const char *username = getenv("USER");
     if (!username) username = "user";
 
-    char *path = get_formatted_path();
-    format_shell_prompt(prompt, sizeof(prompt), username, path);
+    int stale;
+    char *path = prompt_path(&stale);
+    char segments[GHOST_PROMPT_SEGMENT_MAX * 4];
+    prompt_segments_format(segments, sizeof(segments));
+    char shown[PATH_MAX + sizeof(segments)];
+    snprintf(shown, sizeof(shown), "%s%s%s", path ? path : "???", stale && path ? GHOST_STALE_MARKER : "",
+             segments);
+    format_shell_prompt(prompt, sizeof(prompt), username, shown);
     free(path);
-    return strdup(prompt);
+
+    if (!stale) prompt_mark_current();
+    autosuggest_set_prompt(prompt);
+    return prompt;
+}
+
+/* Helper function to index the history list for autosuggestions, oldest
+ * first so that the newest line wins */
+static void rebuild_history_index(void) {
+    history_index_clear();
+    if (!hist) return;
+
+    HistEvent e;
+    for (int r = history(hist, &e, H_LAST); r != -1; r = history(hist, &e, H_PREV)) {
+        history_index_add(e.str);
+    }
+}
+
+/* Helper function to take in an entry another shell added to the shared
+ * history (GHSH_SHARE_HISTORY=1) */
+static void add_shared_entry(const char *line, void *arg) {
+    (void)arg;
+    history(hist, &ev, H_ENTER, line);
+    if (suggest) history_index_add(line);
+}
+
+/* When shell_init started, for the GHSH_STARTUP_TIMING readout */
+static struct timespec startup_began;
+
+/* Print how long startup took and how far the PATH index has got. Called
+ * before each prompt; reports the index once more when it completes. */
+static void report_startup_timing(void) {
+    static int reported_start = 0;
+    static int reported_index = 0;
+
+    if (reported_index || !getenv("GHSH_STARTUP_TIMING")) return;
+
+    size_t dirs_done, dirs_total, dirs_cached, num_found;
+    double index_ms;
+    completions_index_status(&dirs_done, &dirs_total, &dirs_cached, &num_found, &index_ms);
+
+    if (!reported_start) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double startup_ms = (now.tv_sec - startup_began.tv_sec) * 1e3 +
+                            (now.tv_nsec - startup_began.tv_nsec) / 1e6;
+        fprintf(stderr, "ghost-shell: startup %.1f ms to first prompt (PATH index: %zu/%zu dirs)\n",
+                startup_ms, dirs_done, dirs_total);
+        reported_start = 1;
+    }
+    if (index_ms >= 0) {
+        fprintf(stderr, "ghost-shell: PATH index ready: %zu commands from %zu dirs (%zu cached) in %.1f ms (background)\n",
+                num_found, dirs_total, dirs_cached, index_ms);
+        reported_index = 1;
+    }
 }
 
 void shell_init(shell_context *ctx) {
+    clock_gettime(CLOCK_MONOTONIC, &startup_began);
     ctx->current_dir = getcwd(NULL, 0);
     ctx->exit_flag = 0;
     ctx->last_status = 0;
@@ -36,10 +176,13 @@ void shell_init(shell_context *ctx) {
         exit(1);
     }
 
+    /* Reap children asynchronously and take control of the terminal */
+    jobs_init(1);
+
     /* Initialize history */
     hist = history_init();
     if (hist) {
-        history(hist, &ev, H_SETSIZE, 100);
+        history(hist, &ev, H_SETSIZE, GHOST_HISTORY_SIZE);
         
         /* Load history file */
         const char *home = getenv("HOME");
@@ -48,11 +191,26 @@ void shell_init(shell_context *ctx) {
             if (ctx->history_file) {
                 sprintf(ctx->history_file, "%s/.ghsh_history", home);
                 history(hist, &ev, H_LOAD, ctx->history_file);
+                const char *share = getenv("GHSH_SHARE_HISTORY");
+                history_journal_open(ctx->history_file, GHOST_HISTORY_SIZE, share && strcmp(share, "1") == 0);
+            }
+        }
+
+        /* Keep every command in the history store, starting it off with
+         * the history list */
+        if (history_store_open() == 1) {
+            HistEvent e;
+            for (int r = history(hist, &e, H_LAST); r != -1; r = history(hist, &e, H_PREV)) {
+                history_store_add(e.str, "", 0, -1);
             }
         }
+
+        /* Rank the directories cd and z go to, and the commands run */
+        dir_jump_open();
+        frecency_load();
     }
 
-    /* Initialize completion system */
+    /* Initialize completion system (PATH is indexed in the background) */
     completions_init();
 
     /* Initialize EditLine */
@@ -62,21 +220,151 @@ void shell_init(shell_context *ctx) {
         el_set(el, EL_EDITOR, "emacs");
         el_set(el, EL_HIST, history, hist);
         
+        /* Search the history store with Ctrl-R */
+        history_search_init(el);
+        
         /* Set up completion */
         el_set(el, EL_ADDFN, "complete", "Complete command", ghost_complete);
         el_set(el, EL_BIND, "^I", "complete", NULL);
         
+        /* Suggest lines from history as you type */
+        suggest = autosuggest_init(el);
+        if (suggest) rebuild_history_index();
+        
+        /* Git, Kubernetes and timing segments, filled in as they come */
+        prompt_segments_init(el);
+        
         /* Load other default bindings */
         el_source(el, NULL);
     }
 }
 
+/* Script being run by shell_run_script; here-documents read their body
+ * from it instead of the terminal */
+typedef struct script_source {
+    FILE *file;           /* Script file, or NULL when running a string */
+    const char *text;     /* -c command string */
+    size_t pos;           /* Read position in text */
+    char *line;           /* Last line read, without its newline */
+    size_t line_cap;
+    int line_num;         /* Number of the last line read */
+} script_source;
+
+static script_source *current_script = NULL;
+
+/* Helper function to read the next line of a script. The returned buffer
+ * is reused by the next call. */
+static char *script_next_line(script_source *src) {
+    size_t len;
+    if (src->file) {
+        ssize_t n = getline(&src->line, &src->line_cap, src->file);
+        if (n < 0) return NULL;
+        len = (size_t)n;
+        if (len > 0 && src->line[len - 1] == '\n') src->line[--len] = '\0';
+    } else {
+        if (!src->text[src->pos]) return NULL;
+        const char *start = src->text + src->pos;
+        const char *end = strchr(start, '\n');
+        len = end ? (size_t)(end - start) : strlen(start);
+        if (len + 1 > src->line_cap) {
+            char *new_line = realloc(src->line, len + 1);
+            if (!new_line) return NULL;
+            src->line = new_line;
+            src->line_cap = len + 1;
+        }
+        memcpy(src->line, start, len);
+        src->line[len] = '\0';
+        src->pos += len + (end ? 1 : 0);
+    }
+    if (len > 0 && src->line[len - 1] == '\r') src->line[len - 1] = '\0';
+    src->line_num++;
+    return src->line;
+}
+
+int shell_script_active(void) {
+    return current_script != NULL;
+}
+
+char *shell_script_line(void) {
+    if (!current_script) return NULL;
+    char *line = script_next_line(current_script);
+    return line ? strdup(line) : NULL;
+}
+
+int shell_run_script(FILE *file, const char *text, const char *name, int sourced, shell_context *ctx) {
+    script_source src = {file, text, 0, NULL, 0, 0};
+    script_source *outer = current_script;
+    int status = 0;
+    char *line;
+
+    current_script = &src;
+    while (!ctx->exit_flag && (line = script_next_line(&src)) != NULL) {
+        /* Skip empty lines and comments (including a #! line) */
+        while (isspace((unsigned char)*line)) line++;
+        if (*line == '\0' || *line == '#') continue;
+
+        ghost_command *cmd = parse_command(line);
+        if (!cmd) {
+            /* The parser has already explained why */
+            if (sourced) continue;
+            fprintf(stderr, "ghost-shell: %s: line %d\n", name, src.line_num);
+            status = 2;
+            continue;
+        }
+        int cmd_status = execute_command(cmd, ctx);
+        ctx->last_status = cmd_status;
+        free_command(cmd);
+        
+        if (!sourced) {
+            status = cmd_status;
+        } else if (cmd_status != 0) {
+            char error_msg[256];
+            snprintf(error_msg, sizeof(error_msg), "source: error in %s line %d", name, src.line_num);
+            print_error(error_msg);
+            status = cmd_status;
+        }
+        
+        /* Without a prompt nothing else removes finished background jobs */
+        if (!jobs_control_enabled()) jobs_prune();
+    }
+    current_script = outer;
+
+    free(src.line);
+    return status;
+}
+
+void shell_init_noninteractive(shell_context *ctx) {
+    ctx->current_dir = getcwd(NULL, 0);
+    ctx->exit_flag = 0;
+    ctx->last_status = 0;
+    ctx->history_file = NULL;
+    ctx->ai_ctx = NULL;
+    ctx->last_prompt = NULL;
+
+    if (!ctx->current_dir) {
+        print_error("Failed to get current working directory");
+        exit(1);
+    }
+
+    /* Reap children, but leave the terminal and process groups alone */
+    jobs_init(0);
+}
+
 void shell_loop(shell_context *ctx) {
     const char *line;
     int count;
     ghost_command *cmd;
+    long took_ms = -1;  /* How long the last command ran */
 
     while (!ctx->exit_flag) {
+        /* Report background jobs that finished or stopped */
+        jobs_notify();
+        dir_listing_expire();
+        report_startup_timing();
+        history_journal_pull(add_shared_entry, NULL);
+        prompt_segments_start(ctx->current_dir, took_ms);
+        took_ms = -1;
+
         /* Read line */
         line = el_gets(el, &count);
         if (!line || count <= 0) {
@@ -91,20 +379,43 @@ void shell_loop(shell_context *ctx) {
         char *input = strdup(line);
         input[strlen(input) - 1] = '\0';
 
+        /* Offer to fix a mistyped command name (GHSH_CORRECT=1) */
+        char *corrected = correction_offer(input);
+        if (corrected) {
+            free(input);
+            input = corrected;
+        }
+
         /* Add to history */
         if (hist && input[0] != '\0') {
             history(hist, &ev, H_ENTER, input);
-            if (ctx->history_file) {
-                history(hist, &ev, H_SAVE, ctx->history_file);
+            history_journal_append(input);
+            
+            /* Keep the suggestion index in step, starting over from the
+             * history list once it holds many more lines than that */
+            if (suggest) {
+                history_index_add(input);
+                if (history_index_count() > GHOST_HISTORY_INDEX_MAX_LINES) rebuild_history_index();
             }
         }
 
-        /* Parse and execute */
+        /* Parse and execute, then record where, when and how it ran */
+        time_t started = time(NULL);
+        char *cwd = ctx->current_dir ? strdup(ctx->current_dir) : NULL;
+        dir_jump_add(cwd);
         cmd = parse_command(input);
         if (cmd) {
-            ctx->last_status = execute_command(cmd, ctx);
+            struct timespec began, ended;
+            clock_gettime(CLOCK_MONOTONIC, &began);
+            int status = execute_command(cmd, ctx);
+            clock_gettime(CLOCK_MONOTONIC, &ended);
+            took_ms = (ended.tv_sec - began.tv_sec) * 1000 + (ended.tv_nsec - began.tv_nsec) / 1000000;
+            if (status != ctx->last_status) prompt_invalidate();
+            ctx->last_status = status;
             free_command(cmd);
+            history_store_add(input, cwd, started, ctx->last_status);
         }
+        free(cwd);
 
         free(input);
     }
@@ -115,11 +426,13 @@ void shell_cleanup(shell_context *ctx) {
         el_end(el);
         el = NULL;
     }
+    prompt_segments_cleanup();
 
     if (hist) {
-        if (ctx->history_file) {
-            history(hist, &ev, H_SAVE, ctx->history_file);
-        }
+        history_journal_close();
+        history_store_close();
+        dir_jump_close();
+        frecency_save();
         history_end(hist);
         hist = NULL;
     }
@@ -141,6 +454,13 @@ void shell_cleanup(shell_context *ctx) {
 
     /* Clean up completion system */
     completions_cleanup();
+    dir_listing_cleanup();
+    completion_spec_cleanup();
+    git_refs_cleanup();
+    history_index_clear();
+    frecency_cleanup();
+    path_cache_cleanup();
+    jobs_cleanup();
 }
 
 void print_error(const char *message) {
@@ -0,0 +1,36 @@
+#!/bin/sh
+# Command lines: redirections the parser does not know go through /bin/sh.
+# Usage: tests/command_test.sh [path/to/ghost-shell]
+GHSH=${1:-bin/ghost-shell}
+failures=0
+
+check() {
+    if [ "$2" = "$3" ]; then
+        echo "ok   $1"
+    else
+        echo "FAIL $1: expected [$3], got [$2]"
+        failures=$((failures + 1))
+    fi
+}
+
+# The & of 2>&1 does not background anything
+out=$("$GHSH" -c 'echo hi 2>&1' 2>&1)
+check "2>&1 output" "$out" "hi"
+"$GHSH" -c 'echo hi 2>&1' >/dev/null 2>&1
+check "2>&1 status" "$?" "0"
+
+out=$("$GHSH" -c 'sh -c "echo out; echo err >&2" 2>&1 | tr a-z A-Z')
+check "2>&1 into a pipe" "$out" "OUT
+ERR"
+
+out=$("$GHSH" -c 'ls /nonexistent-ghsh-test 2>/dev/null || echo failed' 2>&1)
+check "2>/dev/null" "$out" "failed"
+
+out=$("$GHSH" -c 'GHSH_TEST_VAR=set sh -c "echo \$GHSH_TEST_VAR"; echo $(echo sub)')
+check "VAR=x prefix and \$(...)" "$out" "set
+sub"
+
+out=$("$GHSH" -c "echo 'a 2>&1' \"b>c\"")
+check "quoted > and & stay literal" "$out" "a 2>&1 b>c"
+
+exit $failures
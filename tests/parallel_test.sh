@@ -0,0 +1,37 @@
+#!/bin/sh
+# parallel builtin: template words keep their quoting.
+# Usage: tests/parallel_test.sh [path/to/ghost-shell]
+GHSH=${1:-bin/ghost-shell}
+failures=0
+
+check() {
+    if [ "$2" = "$3" ]; then
+        echo "ok   $1"
+    else
+        echo "FAIL $1: expected [$3], got [$2]"
+        failures=$((failures + 1))
+    fi
+}
+
+# A quoted, multi-word argument reaches the command as one word
+out=$("$GHSH" -c 'parallel -s sh -c "echo [\$0]" {} ::: "a b"')
+check "multi-word template argument" "$out" "[a b]"
+
+"$GHSH" -c 'parallel -s sh -c "exit 3" ::: x'
+check "status of a quoted sh -c" "$?" "1"
+
+out=$("$GHSH" -c "parallel -s echo 'x  y' pre{}post ::: \"it's\"")
+check "quoted spaces and {} inside a word" "$out" "x  y preit'spost"
+
+out=$("$GHSH" -c 'parallel -s -j 1 echo ::: 1 2')
+check "item appended without {}" "$out" "1
+2"
+
+out=$("$GHSH" -c 'parallel -s -j 99999999999 echo ::: 1 2')
+check "huge -j is clamped" "$out" "1
+2"
+
+"$GHSH" -c 'parallel -s -j 2x echo ::: 1' 2>/dev/null
+check "-j that does not parse" "$?" "2"
+
+exit $failures
@@ -0,0 +1,27 @@
+#!/bin/sh
+# source builtin: failing lines are reported and decide its status.
+# Usage: tests/source_test.sh [path/to/ghost-shell]
+GHSH=${1:-bin/ghost-shell}
+failures=0
+
+check() {
+    if [ "$2" = "$3" ]; then
+        echo "ok   $1"
+    else
+        echo "FAIL $1: expected [$3], got [$2]"
+        failures=$((failures + 1))
+    fi
+}
+
+file=$(mktemp)
+trap 'rm -f "$file"' EXIT
+printf 'echo one\nsh -c "exit 3"\ntrue\n' > "$file"
+
+out=$("$GHSH" -c ". $file" 2>&1)
+check "failing line reported" "$out" "one
+Error: source: error in $file line 2"
+
+"$GHSH" -c ". $file" >/dev/null 2>&1
+check "last non-zero status" "$?" "3"
+
+exit $failures